@@ -0,0 +1,1452 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../../utils.h"
+
+
+/* Print a benchmark result, with throughput when `bytes` is non-zero */
+void report(const char* desc, double secs, size_t bytes) {
+    printf("|     |--- BENCH: %-48s %10.3f ms", desc, secs * 1e3);
+    if (bytes > 0) {
+        printf("  %8.2f GB/s", (double)bytes / secs / 1e9);
+    }
+    printf("\n");
+}
+
+double now_secs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Keep the optimizer from discarding benchmarked results */
+volatile uint64_t sink;
+
+
+/* --------------------------------------- */
+/* ----------- UTF-8 Benches ------------- */
+/* --------------------------------------- */
+/* Byte at a time validator, the kind of check `str_validate_utf8` replaces */
+uint8_t naive_validate_utf8(const unsigned char* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        unsigned char b = data[i];
+        size_t n;
+        if (b < 0x80) n = 1;
+        else if (b >= 0xC2 && b < 0xE0) n = 2;
+        else if (b >= 0xE0 && b < 0xF0) n = 3;
+        else if (b >= 0xF0 && b < 0xF5) n = 4;
+        else return 0;
+        if (i + n > len)
+            return 0;
+        for (size_t k = 1; k < n; k++) {
+            if ((data[i + k] & 0xC0) != 0x80)
+                return 0;
+        }
+        if ((b == 0xE0 && data[i + 1] < 0xA0) || (b == 0xED && data[i + 1] > 0x9F)
+                || (b == 0xF0 && data[i + 1] < 0x90) || (b == 0xF4 && data[i + 1] > 0x8F))
+            return 0;
+        i += n;
+    }
+    return 1;
+}
+
+/* Fill a `String` of `len` bytes, where roughly `multibyte_pct` percent
+ * of the characters are 2, 3 or 4 byte sequences.
+ */
+String utf8_corpus(size_t len, int multibyte_pct) {
+    const char* multibyte[] = {"\xc3\xa9", "\xe2\x82\xac", "\xe4\xb8\xad", "\xf0\x9f\x98\x80"};
+    String s = string_new();
+    string_resize(&s, len + 4);
+    srand(42);
+    while (string_len(&s) < len) {
+        if (rand() % 100 < multibyte_pct) {
+            string_push_cstr(&s, multibyte[rand() % 4]);
+        } else {
+            string_push_char(&s, 'a' + rand() % 26);
+        }
+    }
+    return s;
+}
+
+void bench_utf8() {
+    printf("\nUTF-8 benches:\n");
+    const size_t len = 64 * 1024 * 1024;
+    int pcts[] = {0, 1, 10, 50, 100};
+    char desc[128];
+    for (size_t p = 0; p < 5; p++) {
+        printf("| --- %d%% multibyte corpus (%lu MiB):\n", pcts[p], len >> 20);
+        String corpus = utf8_corpus(len, pcts[p]);
+        Str str = string_as_str(&corpus);
+
+        double start = now_secs();
+        sink = str_validate_utf8(&str);
+        report("str_validate_utf8", now_secs() - start, str_len(&str));
+
+        start = now_secs();
+        sink = naive_validate_utf8((const unsigned char*)str_as_ptr(&str), str_len(&str));
+        report("naive byte at a time validate", now_secs() - start, str_len(&str));
+
+        start = now_secs();
+        sink = str_char_count(&str);
+        snprintf(desc, sizeof(desc), "str_char_count (%lu chars)", (size_t)sink);
+        report(desc, now_secs() - start, str_len(&str));
+        string_drop(&corpus);
+    }
+}
+
+
+/* --------------------------------------- */
+/* ----------- Parse Benches ------------- */
+/* --------------------------------------- */
+/* Newline separated numbers, formatted with `fmt` from random values */
+String number_corpus(size_t count, uint8_t floats) {
+    String s = string_new();
+    char buf[64];
+    srand(42);
+    for (size_t i = 0; i < count; i++) {
+        if (floats) {
+            double v = (double)rand() / RAND_MAX * 1e6 * (rand() % 2 ? 1 : -1);
+            snprintf(buf, sizeof(buf), i % 4 == 0 ? "%.17g" : "%.3f", v);
+        } else {
+            long long v = ((long long)rand() << 20) ^ rand();
+            snprintf(buf, sizeof(buf), "%lld", i % 2 ? v : -v);
+        }
+        string_push_cstr(&s, buf);
+        string_push_char(&s, '\n');
+    }
+    return s;
+}
+
+void bench_parse() {
+    printf("\nParse benches:\n");
+    const size_t count = 5000000;
+    for (uint8_t floats = 0; floats < 2; floats++) {
+        printf("| --- %lu %s fields:\n", count, floats ? "float" : "integer");
+        String corpus = number_corpus(count, floats);
+        Vec lines = string_split_lines(&corpus);
+        vec_remove(&lines, vec_len(&lines) - 1);
+        size_t len = vec_len(&lines);
+
+        double start = now_secs();
+        double fsum = 0;
+        int64_t isum = 0;
+        for (size_t i = 0; i < len; i++) {
+            String owned = str_to_owned_string(vec_index_ref_unchecked(&lines, i));
+            if (floats)
+                fsum += strtod(string_as_cstr(&owned), NULL);
+            else
+                isum += strtoll(string_as_cstr(&owned), NULL, 10);
+            string_drop(&owned);
+        }
+        report(floats ? "str_to_owned_string + strtod" : "str_to_owned_string + strtoll",
+               now_secs() - start, string_len(&corpus));
+
+        start = now_secs();
+        for (size_t i = 0; i < len; i++) {
+            Str* field = vec_index_ref_unchecked(&lines, i);
+            char buf[64];
+            memcpy(buf, str_as_ptr(field), str_len(field));
+            buf[str_len(field)] = '\0';
+            if (floats)
+                fsum += strtod(buf, NULL);
+            else
+                isum += strtoll(buf, NULL, 10);
+        }
+        report(floats ? "stack copy + strtod" : "stack copy + strtoll", now_secs() - start, string_len(&corpus));
+
+        start = now_secs();
+        for (size_t i = 0; i < len; i++) {
+            Str* field = vec_index_ref_unchecked(&lines, i);
+            if (floats) {
+                double v = 0;
+                str_parse_f64(field, &v);
+                fsum += v;
+            } else {
+                int64_t v = 0;
+                str_parse_i64(field, &v);
+                isum += v;
+            }
+        }
+        report(floats ? "str_parse_f64" : "str_parse_i64", now_secs() - start, string_len(&corpus));
+        sink = (uint64_t)isum + (uint64_t)fsum;
+        vec_drop(&lines);
+        string_drop(&corpus);
+    }
+}
+
+
+/* --------------------------------------- */
+/* ----------- Format Benches ------------ */
+/* --------------------------------------- */
+void bench_format() {
+    printf("\nFormat benches:\n");
+    const size_t rows = 2000000;
+    printf("| --- %lu `u64,i64,f64` csv rows:\n", rows);
+    srand(42);
+    uint64_t* ids = malloc(rows * sizeof(uint64_t));
+    int64_t* deltas = malloc(rows * sizeof(int64_t));
+    double* prices = malloc(rows * sizeof(double));
+    for (size_t i = 0; i < rows; i++) {
+        ids[i] = ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+        deltas[i] = (int64_t)(rand() % 2000000) - 1000000;
+        prices[i] = (double)rand() / (double)(rand() % 1000 + 1);
+    }
+
+    double start = now_secs();
+    String out = string_new();
+    for (size_t i = 0; i < rows; i++) {
+        char buf[96];
+        int n = snprintf(buf, sizeof(buf), "%lu,%ld,%.17g\n", ids[i], deltas[i], prices[i]);
+        string_push_cstr_bound(&out, buf, (size_t)n);
+    }
+    report("snprintf + string_push_cstr_bound", now_secs() - start, string_len(&out));
+    string_drop(&out);
+
+    start = now_secs();
+    out = string_new();
+    for (size_t i = 0; i < rows; i++)
+        string_push_fmt(&out, "%lu,%ld,%.17g\n", ids[i], deltas[i], prices[i]);
+    report("string_push_fmt", now_secs() - start, string_len(&out));
+    string_drop(&out);
+
+    start = now_secs();
+    out = string_new();
+    for (size_t i = 0; i < rows; i++) {
+        string_push_u64(&out, ids[i]);
+        string_push_char(&out, ',');
+        string_push_i64(&out, deltas[i]);
+        string_push_char(&out, ',');
+        string_push_f64(&out, prices[i]);
+        string_push_char(&out, '\n');
+    }
+    report("string_push_u64/i64/f64 (shortest)", now_secs() - start, string_len(&out));
+    sink = string_len(&out);
+    string_drop(&out);
+    free(ids);
+    free(deltas);
+    free(prices);
+}
+
+
+/* --------------------------------------- */
+/* ----------- CSV Benches --------------- */
+/* --------------------------------------- */
+/* Build `rows` csv rows of numbers and words, with every `quote_every`th row
+ * carrying a quoted field holding a delimiter and an escaped quote.
+ */
+String csv_corpus(size_t rows, size_t quote_every) {
+    const char* words[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot"};
+    String s = string_new();
+    srand(42);
+    for (size_t i = 0; i < rows; i++) {
+        string_push_u64(&s, i);
+        string_push_char(&s, ',');
+        string_push_cstr(&s, words[rand() % 6]);
+        string_push_char(&s, ',');
+        string_push_f64(&s, (double)rand() / 1000.0);
+        string_push_char(&s, ',');
+        if (quote_every > 0 && i % quote_every == 0)
+            string_push_cstr(&s, "\"says \"\"hi\"\", twice\"");
+        else
+            string_push_cstr(&s, words[rand() % 6]);
+        string_push_cstr(&s, ",2024-01-01T00:00:00Z\n");
+    }
+    return s;
+}
+
+void bench_csv() {
+    printf("\nCSV benches:\n");
+    const size_t rows = 2000000;
+    size_t quote_every[] = {0, 10};
+    for (size_t q = 0; q < 2; q++) {
+        String corpus = csv_corpus(rows, quote_every[q]);
+        printf("| --- %lu rows, %.1f MB, %s:\n", rows, (double)string_len(&corpus) / 1e6,
+               quote_every[q] ? "10% quoted" : "unquoted");
+
+        double start = now_secs();
+        size_t fields = 0;
+        Vec lines = string_split_lines(&corpus);
+        for (size_t i = 0; i < vec_len(&lines); i++) {
+            Vec row = str_split_by_cstr(vec_index_ref_unchecked(&lines, i), ",");
+            fields += vec_len(&row);
+            vec_drop(&row);
+        }
+        vec_drop(&lines);
+        report("str_split_lines + str_split_by_cstr (no quoting)", now_secs() - start, string_len(&corpus));
+
+        start = now_secs();
+        Str input = string_as_str(&corpus);
+        CsvReader r = csv_reader_new(&input, ',');
+        while (!csv_reader_done(&r)) {
+            Slice row = csv_reader_next_row(&r);
+            fields += row.__len;
+        }
+        csv_reader_drop(&r);
+        report("csv_reader_next_row", now_secs() - start, string_len(&corpus));
+        sink = fields;
+        string_drop(&corpus);
+    }
+}
+
+
+/* --------------------------------------- */
+/* ----------- Search Benches ------------ */
+/* --------------------------------------- */
+/* Fill `buf` with a random lowercase word of 4 to 11 letters */
+void random_word(char* buf) {
+    size_t len = 4 + rand() % 8;
+    for (size_t i = 0; i < len; i++)
+        buf[i] = 'a' + rand() % 26;
+    buf[len] = '\0';
+}
+
+void bench_search() {
+    printf("\nSearch benches:\n");
+    const size_t num_keywords = 2000;
+    const size_t num_lines = 20000;
+    srand(42);
+    char (*keywords)[16] = malloc(num_keywords * sizeof(*keywords));
+    Vec patterns = vec_new(sizeof(Str));
+    for (size_t i = 0; i < num_keywords; i++) {
+        random_word(keywords[i]);
+        Str w = str_from_cstr(keywords[i]);
+        vec_push(&patterns, &w);
+    }
+    String log = string_new();
+    for (size_t i = 0; i < num_lines; i++) {
+        string_push_cstr(&log, "2024-01-01T00:00:00Z INFO request served path=/api/v1/items/");
+        string_push_u64(&log, i);
+        string_push_cstr(&log, " status=200 user=");
+        char word[16];
+        random_word(word);
+        string_push_cstr(&log, i % 100 == 0 ? keywords[i % num_keywords] : word);
+        string_push_char(&log, '\n');
+    }
+    Vec lines = string_split_lines(&log);
+    printf("| --- %lu keywords, %lu log lines:\n", num_keywords, vec_len(&lines));
+
+    double start = now_secs();
+    MultiPattern mp = multi_pattern_new(&patterns);
+    report("multi_pattern_new", now_secs() - start, 0);
+    printf("|     |--- automaton: %lu states, %lu byte classes, %.2f MB\n", mp.__num_states, mp.__num_classes,
+           (double)multi_pattern_memory_usage(&mp) / 1e6);
+
+    /* the per-keyword scan is slow, so only time a tenth of the lines and scale */
+    start = now_secs();
+    size_t matched = 0;
+    for (size_t i = 0; i < vec_len(&lines); i += 10) {
+        Str* line = vec_index_ref_unchecked(&lines, i);
+        for (size_t k = 0; k < num_keywords; k++) {
+            Vec parts = str_split_by_cstr(line, keywords[k]);
+            matched += vec_len(&parts) > 1;
+            vec_drop(&parts);
+        }
+    }
+    report("str_split_by_cstr per keyword (x10 estimate)", (now_secs() - start) * 10, string_len(&log));
+
+    start = now_secs();
+    for (size_t i = 0; i < vec_len(&lines); i++)
+        matched += multi_pattern_is_match(&mp, vec_index_ref_unchecked(&lines, i));
+    report("multi_pattern_is_match", now_secs() - start, string_len(&log));
+
+    start = now_secs();
+    for (size_t i = 0; i < vec_len(&lines); i++) {
+        Vec all = multi_pattern_find_all(&mp, vec_index_ref_unchecked(&lines, i));
+        matched += vec_len(&all);
+        vec_drop(&all);
+    }
+    report("multi_pattern_find_all", now_secs() - start, string_len(&log));
+    sink = matched;
+
+    multi_pattern_drop(&mp);
+    vec_drop(&lines);
+    vec_drop(&patterns);
+    string_drop(&log);
+    free(keywords);
+}
+
+
+/* --------------------------------------- */
+/* ----------- File Benches -------------- */
+/* --------------------------------------- */
+/* Write the csv corpus to a temporary file, returning its path (freed by the caller) */
+char* write_temp_corpus(size_t rows) {
+    char* path = malloc(64);
+    strcpy(path, "/tmp/cutils_bench_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Error creating temp file");
+        abort();
+    }
+    String corpus = csv_corpus(rows, 0);
+    StringBuilder sb = string_builder_new();
+    string_builder_push_string(&sb, &corpus);
+    if (string_builder_write_fd(&sb, fd) != 0) {
+        perror("Error writing temp file");
+        abort();
+    }
+    close(fd);
+    string_builder_drop(&sb);
+    string_drop(&corpus);
+    return path;
+}
+
+void count_fields(Str* line, void* ctx) {
+    const char* ptr = str_as_ptr(line);
+    size_t fields = 1;
+    for (size_t i = 0; i < str_len(line); i++)
+        fields += ptr[i] == ',';
+    *(size_t*)ctx += fields;
+}
+
+void merge_counts(void* dst, void* src) {
+    *(size_t*)dst += *(size_t*)src;
+}
+
+void bench_file() {
+    printf("\nFile benches:\n");
+    char* path = write_temp_corpus(4000000);
+
+    double start = now_secs();
+    String s = read_file(path);
+    Vec lines = string_split_lines(&s);
+    size_t len = string_len(&s);
+    report("read_file + string_split_lines", now_secs() - start, len);
+    vec_drop(&lines);
+    string_drop(&s);
+
+    start = now_secs();
+    MappedFile mf = map_file(path);
+    Str mapped = mapped_file_as_str(&mf);
+    lines = str_split_lines(&mapped);
+    report("map_file + str_split_lines", now_secs() - start, len);
+    vec_drop(&lines);
+    mapped_file_drop(&mf);
+
+    start = now_secs();
+    mf = map_file_with_flags(path, MAP_FILE_POPULATE);
+    mapped = mapped_file_as_str(&mf);
+    lines = str_split_lines(&mapped);
+    report("map_file (populate) + str_split_lines", now_secs() - start, len);
+    sink = vec_len(&lines);
+    vec_drop(&lines);
+    mapped_file_drop(&mf);
+
+    for (size_t k = 0; k < 2; k++) {
+        size_t block_size = k == 0 ? 64 * 1024 : LINE_READER_BLOCK_SIZE;
+        int fd = open(path, O_RDONLY);
+        start = now_secs();
+        LineReader lr = line_reader_with_block_size(fd, block_size);
+        size_t count = 0;
+        while (!line_reader_done(&lr)) {
+            Str line = line_reader_next(&lr);
+            count += str_len(&line) > 0;
+        }
+        char desc[64];
+        snprintf(desc, sizeof(desc), "line_reader_next (%lu KB blocks)", block_size / 1024);
+        report(desc, now_secs() - start, len);
+        sink = count;
+        line_reader_drop(&lr);
+        close(fd);
+    }
+
+    /* count fields per line on a growing number of threads */
+    size_t max_threads = utils_num_cpus() > 1 ? utils_num_cpus() : 2;
+    for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        size_t* counts = calloc(nthreads, sizeof(size_t));
+        start = now_secs();
+        parallel_for_lines_in_file(path, nthreads, count_fields, counts, sizeof(size_t), merge_counts);
+        char desc[64];
+        snprintf(desc, sizeof(desc), "parallel_for_lines_in_file (%lu threads)", nthreads);
+        report(desc, now_secs() - start, len);
+        sink = counts[0];
+        free(counts);
+    }
+
+    unlink(path);
+    free(path);
+}
+
+
+/* --------------------------------------- */
+/* ----------- Write Benches ------------- */
+/* --------------------------------------- */
+void bench_write() {
+    printf("\nWrite benches:\n");
+    String corpus = csv_corpus(2000000, 0);
+    Vec lines = string_split_lines(&corpus);
+    vec_remove(&lines, vec_len(&lines) - 1);
+    size_t len = vec_len(&lines);
+    size_t bytes = string_len(&corpus);
+    printf("| --- %lu lines to /dev/null:\n", len);
+    int fd = open("/dev/null", O_WRONLY);
+    FILE* f = fdopen(dup(fd), "w");
+
+    double start = now_secs();
+    for (size_t i = 0; i < len; i++) {
+        Str* line = vec_index_ref_unchecked(&lines, i);
+        fprintf(f, "%.*s\n", (int)str_len(line), str_as_ptr(line));
+    }
+    fflush(f);
+    report("fprintf(\"%.*s\\n\")", now_secs() - start, bytes);
+
+    start = now_secs();
+    for (size_t i = 0; i < len; i++) {
+        Str* line = vec_index_ref_unchecked(&lines, i);
+        fwrite(str_as_ptr(line), 1, str_len(line), f);
+        fputc('\n', f);
+    }
+    fflush(f);
+    report("fwrite + fputc", now_secs() - start, bytes);
+    fclose(f);
+
+    start = now_secs();
+    BufWriter w = buf_writer_new(fd);
+    for (size_t i = 0; i < len; i++) {
+        buf_writer_write_str(&w, vec_index_ref_unchecked(&lines, i));
+        buf_writer_write_char(&w, '\n');
+    }
+    buf_writer_flush(&w);
+    report("buf_writer_write_str + write_char", now_secs() - start, bytes);
+    printf("|     |--- %lu writes -> %lu syscalls\n", 2 * len, buf_writer_syscalls(&w));
+    buf_writer_drop(&w);
+
+    printf("| --- %lu numeric rows to /dev/null:\n", len);
+    start = now_secs();
+    w = buf_writer_new(fd);
+    for (size_t i = 0; i < len; i++) {
+        buf_writer_write_u64(&w, i);
+        buf_writer_write_char(&w, ',');
+        buf_writer_write_i64(&w, -(int64_t)i);
+        buf_writer_write_char(&w, ',');
+        buf_writer_write_f64(&w, (double)i / 7);
+        buf_writer_write_char(&w, '\n');
+    }
+    buf_writer_flush(&w);
+    report("buf_writer_write_u64/i64/f64", now_secs() - start, 0);
+    printf("|     |--- %lu writes -> %lu syscalls\n", 6 * len, buf_writer_syscalls(&w));
+    buf_writer_drop(&w);
+
+    close(fd);
+    vec_drop(&lines);
+    string_drop(&corpus);
+}
+
+
+/* --------------------------------------- */
+/* ----------- Batch Read Benches -------- */
+/* --------------------------------------- */
+/* Drop the page cache of each file, so the next read has to go to disk.
+ * Dirty pages aren't dropped, so everything is synced first.
+ */
+void evict_files(const char** paths, size_t n) {
+    sync();
+    for (size_t i = 0; i < n; i++) {
+        int fd = open(paths[i], O_RDONLY);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+void bench_batch_read() {
+    printf("\nBatch read benches:\n");
+    const size_t n = 5000;
+    char dir[] = "/tmp/cutils_bench_batch_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("Error creating temp dir");
+        abort();
+    }
+    char (*paths)[64] = malloc(n * sizeof(*paths));
+    const char** path_ptrs = malloc(n * sizeof(char*));
+    String content = string_new();
+    for (size_t k = 0; k < 4096; k++)
+        string_push_char(&content, (char)('a' + k % 26));
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/shard_%lu.conf", dir, i);
+        path_ptrs[i] = paths[i];
+        int fd = open(paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        size_t len = 512 + (i * 131) % 3584;
+        bytes += len;
+        if (write(fd, string_as_cstr(&content), len) != (ssize_t)len) {
+            perror("Error writing temp file");
+            abort();
+        }
+        close(fd);
+    }
+    String* out = malloc(n * sizeof(String));
+
+    for (uint8_t cold = 0; cold < 2; cold++) {
+        printf("| --- %lu files, %s cache:\n", n, cold ? "cold" : "warm");
+        if (cold)
+            evict_files(path_ptrs, n);
+        double start = now_secs();
+        for (size_t i = 0; i < n; i++)
+            out[i] = read_file(path_ptrs[i]);
+        report("read_file loop", now_secs() - start, bytes);
+        for (size_t i = 0; i < n; i++)
+            string_drop(&out[i]);
+
+        if (cold)
+            evict_files(path_ptrs, n);
+        start = now_secs();
+        sink = read_files_batch(path_ptrs, n, out, NULL);
+        report("read_files_batch", now_secs() - start, bytes);
+        for (size_t i = 0; i < n; i++)
+            string_drop(&out[i]);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        unlink(path_ptrs[i]);
+    rmdir(dir);
+    free(out);
+    free(paths);
+    free(path_ptrs);
+    string_drop(&content);
+}
+
+
+/* --------------------------------------- */
+/* ----------- Vec Benches --------------- */
+/* --------------------------------------- */
+void bench_vec() {
+    printf("\nVec benches:\n");
+    const size_t n = 20000000;
+    printf("| --- %lu uint64_t/double elements:\n", n);
+
+    /* fill each vec once first, so only the pushes are timed, not page faults */
+    Vec generic = vec_with_capacity(sizeof(uint64_t), n);
+    Vec_u64 typed = vec_u64_with_capacity(n);
+    memset(generic.__data, 0, n * sizeof(uint64_t));
+    memset(vec_u64_data(&typed), 0, n * sizeof(uint64_t));
+
+    double start = now_secs();
+    for (uint64_t i = 0; i < n; i++)
+        vec_push(&generic, &i);
+    report("vec_push", now_secs() - start, n * sizeof(uint64_t));
+
+    start = now_secs();
+    for (uint64_t i = 0; i < n; i++)
+        vec_u64_push(&typed, i);
+    report("vec_u64_push", now_secs() - start, n * sizeof(uint64_t));
+
+    start = now_secs();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += *(uint64_t*)vec_index_ref(&generic, i);
+    report("sum over vec_index_ref", now_secs() - start, n * sizeof(uint64_t));
+
+    start = now_secs();
+    for (size_t i = 0; i < n; i++)
+        sum += vec_u64_get(&typed, i);
+    report("sum over vec_u64_get", now_secs() - start, n * sizeof(uint64_t));
+
+    start = now_secs();
+    const uint64_t* data = vec_u64_data(&typed);
+    for (size_t i = 0; i < n; i++)
+        sum += data[i];
+    report("sum over vec_u64_data (vectorized)", now_secs() - start, n * sizeof(uint64_t));
+    sink = sum;
+
+    Vec_f64 xs = vec_f64_with_capacity(n);
+    Vec generic_xs = vec_with_capacity(sizeof(double), n);
+    for (size_t i = 0; i < n; i++) {
+        double x = (double)i * 0.5;
+        vec_f64_push(&xs, x);
+        vec_push(&generic_xs, &x);
+    }
+    start = now_secs();
+    for (size_t i = 0; i < n; i++) {
+        double* x = vec_index_ref(&generic_xs, i);
+        *x = *x * 1.5 + 2.0;
+    }
+    report("axpy over vec_index_ref", now_secs() - start, n * sizeof(double));
+
+    start = now_secs();
+    double* xs_data = vec_f64_data(&xs);
+    for (size_t i = 0; i < n; i++)
+        xs_data[i] = xs_data[i] * 1.5 + 2.0;
+    report("axpy over vec_f64_data (vectorized)", now_secs() - start, n * sizeof(double));
+    sink = (uint64_t)(xs_data[n - 1] + *(double*)vec_index_ref(&generic_xs, n - 1));
+
+    vec_f64_drop(&xs);
+    vec_drop(&generic_xs);
+    vec_u64_drop(&typed);
+    vec_drop(&generic);
+}
+
+
+/* Seed and step of the xorshift64 generator used for every bench's random input */
+static const uint64_t BENCH_SEED = 88172645463325252ULL;
+
+uint64_t bench_rand(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Build and shrink `Vec`s in bulk rather than an element at a time */
+void bench_vec_bulk() {
+    printf("\nVec bulk benches:\n");
+    const size_t n = 10000000;
+    const size_t chunk = 1000;
+    uint64_t* src = malloc(chunk * sizeof(uint64_t));
+    for (size_t i = 0; i < chunk; i++)
+        src[i] = i;
+    printf("| --- building %lu uint64_t elements:\n", n);
+
+    /* the growth `__inc_cap` used to apply past 8192 elements */
+    double start = now_secs();
+    Vec v = vec_new(sizeof(uint64_t));
+    for (uint64_t i = 0; i < n; i++) {
+        if (vec_len(&v) == vec_cap(&v))
+            vec_resize(&v, vec_cap(&v) > 8192 ? vec_cap(&v) + 8192 : vec_cap(&v) * 2);
+        vec_push(&v, &i);
+    }
+    report("vec_push, linear growth", now_secs() - start, n * sizeof(uint64_t));
+    vec_drop(&v);
+
+    start = now_secs();
+    v = vec_new(sizeof(uint64_t));
+    for (uint64_t i = 0; i < n; i++)
+        vec_push(&v, &i);
+    report("vec_push, geometric growth", now_secs() - start, n * sizeof(uint64_t));
+    vec_drop(&v);
+
+    start = now_secs();
+    v = vec_new(sizeof(uint64_t));
+    vec_reserve(&v, n);
+    for (uint64_t i = 0; i < n; i++)
+        vec_push(&v, &i);
+    report("vec_reserve + vec_push", now_secs() - start, n * sizeof(uint64_t));
+    vec_drop(&v);
+
+    start = now_secs();
+    v = vec_new(sizeof(uint64_t));
+    Slice sl = slice_from_ptr_len(sizeof(uint64_t), src, chunk);
+    for (size_t i = 0; i < n / chunk; i++)
+        vec_extend_from_slice(&v, &sl);
+    report("vec_extend_from_slice, 1000 at a time", now_secs() - start, n * sizeof(uint64_t));
+    vec_drop(&v);
+
+    const size_t len = 1000000;
+    const size_t removals = 20000;
+    printf("| --- %lu removals at random indices of %lu uint64_t:\n", removals, len);
+    Vec base = vec_with_capacity(sizeof(uint64_t), len);
+    for (uint64_t i = 0; i < len; i++)
+        vec_push(&base, &i);
+    size_t* indices = malloc(removals * sizeof(size_t));
+    uint64_t state = BENCH_SEED;
+    for (size_t i = 0; i < removals; i++) {
+        indices[i] = bench_rand(&state) % (len - i);
+    }
+
+    v = vec_copy(&base);
+    start = now_secs();
+    for (size_t i = 0; i < removals; i++)
+        vec_remove(&v, indices[i]);
+    report("vec_remove", now_secs() - start, 0);
+    vec_drop(&v);
+
+    v = vec_copy(&base);
+    start = now_secs();
+    for (size_t i = 0; i < removals; i++)
+        vec_swap_remove(&v, indices[i]);
+    report("vec_swap_remove", now_secs() - start, 0);
+    vec_drop(&v);
+
+    vec_drop(&base);
+    free(indices);
+    free(src);
+}
+
+/* Growth and scans of buffers large enough to be mapped, against plain realloc */
+void bench_vec_large() {
+    printf("\nVec large buffer benches:\n");
+    const size_t n = 64 << 20;
+    const size_t gathers = 20000000;
+    size_t bytes = n * sizeof(uint64_t);
+    printf("| --- growing to %lu uint64_t (%lu MiB), %lu random reads:\n", n, bytes >> 20, gathers);
+
+    /* the first round includes the kernel assembling huge pages */
+    uint64_t* plain = NULL;
+    Vec_u64 v = vec_u64_new();
+    char name[64];
+    for (int round = 1; round <= 2; round++) {
+        free(plain);
+        vec_u64_drop(&v);
+
+        /* same growth policy as `Vec`, over a realloc'd array */
+        double start = now_secs();
+        size_t cap = 16;
+        plain = malloc(cap * sizeof(uint64_t));
+        for (uint64_t i = 0; i < n; i++) {
+            if (i == cap) {
+                cap = cap > 8192 ? cap + cap / 2 : cap * 2;
+                plain = realloc(plain, cap * sizeof(uint64_t));
+            }
+            plain[i] = i;
+        }
+        snprintf(name, sizeof(name), "grow with realloc, round %d", round);
+        report(name, now_secs() - start, bytes);
+
+        start = now_secs();
+        v = vec_u64_new();
+        for (uint64_t i = 0; i < n; i++)
+            vec_u64_push(&v, i);
+        snprintf(name, sizeof(name), "grow vec_u64_push (mremap), round %d", round);
+        report(name, now_secs() - start, bytes);
+    }
+    const uint64_t* data = vec_u64_data(&v);
+
+    double start = now_secs();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += plain[i];
+    report("sequential sum, realloc'd", now_secs() - start, bytes);
+
+    start = now_secs();
+    for (size_t i = 0; i < n; i++)
+        sum += data[i];
+    report("sequential sum, mapped + huge pages", now_secs() - start, bytes);
+
+    uint64_t state = BENCH_SEED;
+    start = now_secs();
+    for (size_t i = 0; i < gathers; i++) {
+        sum += plain[bench_rand(&state) % n];
+    }
+    report("random reads, realloc'd", now_secs() - start, 0);
+
+    state = BENCH_SEED;
+    start = now_secs();
+    for (size_t i = 0; i < gathers; i++) {
+        sum += data[bench_rand(&state) % n];
+    }
+    report("random reads, mapped + huge pages", now_secs() - start, 0);
+    sink = sum;
+
+    vec_u64_drop(&v);
+    free(plain);
+}
+
+/* FIFO throughput at a steady queue depth: one push and one pop per operation */
+void bench_queue() {
+    printf("\nQueue benches:\n");
+    const size_t ops = 1000000;
+    size_t depths[] = { 16, 1000, 100000 };
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        size_t depth = depths[d];
+        printf("| --- %lu push/pop pairs at depth %lu (uint64_t):\n", ops, depth);
+        uint64_t sum = 0;
+
+        Vec v = vec_new(sizeof(uint64_t));
+        for (uint64_t i = 0; i < depth; i++)
+            vec_push(&v, &i);
+        /* the old pattern is quadratic, time fewer operations at depth */
+        size_t vec_ops = depth > 1000 ? ops / 100 : ops;
+        double start = now_secs();
+        for (uint64_t i = 0; i < vec_ops; i++) {
+            vec_push(&v, &i);
+            sum += *(uint64_t*)vec_index_ref(&v, 0);
+            vec_remove(&v, 0);
+        }
+        double secs = (now_secs() - start) * (double)(ops / vec_ops);
+        report(vec_ops < ops ? "vec_push + vec_remove(0) (extrapolated)" : "vec_push + vec_remove(0)", secs, 0);
+        vec_drop(&v);
+
+        VecDeque dq = vec_deque_new(sizeof(uint64_t));
+        for (uint64_t i = 0; i < depth; i++)
+            vec_deque_push_back(&dq, &i);
+        start = now_secs();
+        for (uint64_t i = 0; i < ops; i++) {
+            uint64_t out;
+            vec_deque_push_back(&dq, &i);
+            vec_deque_pop_front(&dq, &out);
+            sum += out;
+        }
+        report("vec_deque_push_back + vec_deque_pop_front", now_secs() - start, 0);
+        vec_deque_drop(&dq);
+        sink = sum;
+    }
+}
+
+/* 1B bit vectors against the byte-per-flag `Vec` they replace */
+void bench_bit_vec() {
+    printf("\nBitVec benches:\n");
+    const size_t n = 1000000000;
+    const size_t queries = 10000000;
+    printf("| --- %lu bits (%lu MiB packed, %lu MiB as uint8_t flags):\n", n, n / 8 >> 20, n >> 20);
+
+    BitVec a = bit_vec_zeros(n);
+    BitVec b = bit_vec_zeros(n);
+    uint8_t* flags_a = calloc(n, 1);
+    uint8_t* flags_b = calloc(n, 1);
+    uint64_t state = BENCH_SEED;
+    for (size_t i = 0; i < n / 4; i++) {
+        size_t ind = bench_rand(&state) % n;
+        bit_vec_set(&a, ind);
+        flags_a[ind] = 1;
+        ind = (state >> 20) % n;
+        bit_vec_set(&b, ind);
+        flags_b[ind] = 1;
+    }
+
+    double start = now_secs();
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        count += flags_a[i];
+    report("count uint8_t flags", now_secs() - start, n);
+
+    start = now_secs();
+    count += bit_vec_count_ones(&a);
+    report("bit_vec_count_ones", now_secs() - start, n / 8);
+
+    start = now_secs();
+    for (size_t i = 0; i < n; i++)
+        flags_a[i] &= flags_b[i];
+    report("and uint8_t flags", now_secs() - start, 2 * n);
+
+    start = now_secs();
+    bit_vec_and(&a, &b);
+    report("bit_vec_and", now_secs() - start, 2 * (n / 8));
+
+    start = now_secs();
+    bit_vec_or(&a, &b);
+    report("bit_vec_or", now_secs() - start, 2 * (n / 8));
+
+    start = now_secs();
+    size_t visited = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (flags_b[i])
+            visited += i;
+    }
+    report("visit set uint8_t flags", now_secs() - start, n);
+
+    start = now_secs();
+    BitVecIter iter = bit_vec_iter(&b);
+    while (!bit_vec_iter_done(&iter))
+        visited += bit_vec_iter_next(&iter);
+    report("visit set bits with bit_vec_iter", now_secs() - start, n / 8);
+
+    start = now_secs();
+    RankSelect rs = rank_select_new(&b);
+    report("rank_select_new", now_secs() - start, n / 8);
+    uint64_t ones = rank_select_count_ones(&rs);
+
+    start = now_secs();
+    for (size_t i = 0; i < queries; i++) {
+        count += rank_select_rank(&rs, bench_rand(&state) % n);
+    }
+    report("10M random rank_select_rank", now_secs() - start, 0);
+
+    start = now_secs();
+    for (size_t i = 0; i < queries; i++) {
+        count += rank_select_select(&rs, bench_rand(&state) % ones);
+    }
+    report("10M random rank_select_select", now_secs() - start, 0);
+    sink = count + visited;
+
+    rank_select_drop(&rs);
+    bit_vec_drop(&a);
+    bit_vec_drop(&b);
+    free(flags_a);
+    free(flags_b);
+}
+
+/* --------------------------------------- */
+/* ------------ Sort Benches ------------- */
+/* --------------------------------------- */
+int qsort_u64_cmp(const void* a_, const void* b_) {
+    uint64_t a = *(const uint64_t*)a_;
+    uint64_t b = *(const uint64_t*)b_;
+    return (a > b) - (a < b);
+}
+
+CmpOrdering u64_cmp(void* a_, void* b_) {
+    uint64_t a = *(uint64_t*)a_;
+    uint64_t b = *(uint64_t*)b_;
+    if (a < b) return CMP_LESS;
+    if (a > b) return CMP_GREATER;
+    return CMP_EQUAL;
+}
+
+uint64_t u64_key(void* a) {
+    return *(uint64_t*)a;
+}
+
+/* Time each sort on its own copy of `input` */
+void bench_sorts(Vec* input) {
+    size_t n = vec_len(input);
+    size_t bytes = n * sizeof(uint64_t);
+
+    Vec v = vec_copy(input);
+    double start = now_secs();
+    qsort(v.__data, n, sizeof(uint64_t), qsort_u64_cmp);
+    report("qsort", now_secs() - start, bytes);
+    vec_drop(&v);
+
+    v = vec_copy(input);
+    start = now_secs();
+    vec_sort_by(&v, u64_cmp);
+    report("vec_sort_by", now_secs() - start, bytes);
+    vec_drop(&v);
+
+    v = vec_copy(input);
+    start = now_secs();
+    vec_sort_stable_by(&v, u64_cmp);
+    report("vec_sort_stable_by", now_secs() - start, bytes);
+    vec_drop(&v);
+
+    v = vec_copy(input);
+    start = now_secs();
+    vec_radix_sort_by_u64(&v, u64_key);
+    report("vec_radix_sort_by_u64", now_secs() - start, bytes);
+    sink = *(uint64_t*)vec_index_ref(&v, n / 2);
+    vec_drop(&v);
+}
+
+void bench_sort(size_t n) {
+    printf("\nSort benches:\n");
+    uint64_t state = BENCH_SEED;
+    Vec input = vec_with_capacity(sizeof(uint64_t), n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t val = bench_rand(&state);
+        vec_push(&input, &val);
+    }
+    printf("| --- %lu random uint64_t:\n", n);
+    bench_sorts(&input);
+
+    /* ascending with 1% of the elements swapped at random */
+    uint64_t* data = input.__data;
+    for (size_t i = 0; i < n; i++)
+        data[i] = i;
+    for (size_t i = 0; i < n / 100; i++) {
+        size_t a = bench_rand(&state) % n;
+        size_t b = (state >> 32) % n;
+        uint64_t tmp = data[a];
+        data[a] = data[b];
+        data[b] = tmp;
+    }
+    printf("| --- %lu nearly sorted uint64_t:\n", n);
+    bench_sorts(&input);
+    vec_drop(&input);
+}
+
+/* Scaling of `vec_par_sort_by` with the thread count, past the available cpus */
+void bench_par_sort(size_t n) {
+    printf("\nParallel sort benches:\n");
+    uint64_t state = BENCH_SEED;
+    Vec input = vec_with_capacity(sizeof(uint64_t), n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t val = bench_rand(&state);
+        vec_push(&input, &val);
+    }
+    printf("| --- %lu random uint64_t, %lu cpus:\n", n, utils_num_cpus());
+    char name[64];
+    for (size_t nthreads = 1; nthreads <= 64; nthreads *= 2) {
+        Vec v = vec_copy(&input);
+        double start = now_secs();
+        vec_par_sort_by(&v, u64_cmp, nthreads);
+        snprintf(name, sizeof(name), "vec_par_sort_by, %lu threads", nthreads);
+        report(name, now_secs() - start, n * sizeof(uint64_t));
+        sink = *(uint64_t*)vec_index_ref(&v, n / 2);
+        vec_drop(&v);
+    }
+    vec_drop(&input);
+}
+
+
+
+/* --------------------------------------- */
+/* ----------- Search Benches ------------ */
+/* --------------------------------------- */
+/* The hand-written binary search `vec_lower_bound_by` replaces */
+size_t naive_lower_bound(Vec* v, uint64_t key) {
+    size_t lo = 0;
+    size_t hi = vec_len(v);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (*(uint64_t*)vec_index_ref(v, mid) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void bench_sorted_search() {
+    printf("\nSorted search benches:\n");
+    const size_t lookups = 2000000;
+    /* 8 KiB (L1) up to 256 MiB (well past L3) of uint64_t */
+    size_t sizes[] = { 1 << 10, 1 << 15, 1 << 20, 1 << 25 };
+    uint64_t* keys = malloc(lookups * sizeof(uint64_t));
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        Vec v = vec_with_capacity(sizeof(uint64_t), n);
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t val = i * 2;
+            vec_push(&v, &val);
+        }
+        uint64_t state = BENCH_SEED;
+        for (size_t i = 0; i < lookups; i++) {
+            keys[i] = bench_rand(&state) % (2 * n);
+        }
+        Slice sl = vec_as_slice(&v);
+        EytzingerIndex ei = eytzinger_index_new(&sl);
+        printf("| --- %lu lookups in %lu uint64_t (%lu KiB):\n", lookups, n, n * sizeof(uint64_t) / 1024);
+
+        double start = now_secs();
+        uint64_t sum = 0;
+        for (size_t i = 0; i < lookups; i++)
+            sum += naive_lower_bound(&v, keys[i]);
+        report("binary search over vec_index_ref", now_secs() - start, 0);
+
+        start = now_secs();
+        for (size_t i = 0; i < lookups; i++)
+            sum += vec_lower_bound_by(&v, &keys[i], u64_cmp);
+        report("vec_lower_bound_by", now_secs() - start, 0);
+
+        start = now_secs();
+        for (size_t i = 0; i < lookups; i++) {
+            uint64_t* found = eytzinger_index_lower_bound(&ei, &keys[i], u64_cmp);
+            sum += found == NULL ? n : *found / 2;
+        }
+        report("eytzinger_index_lower_bound", now_secs() - start, 0);
+        sink = sum;
+
+        eytzinger_index_drop(&ei);
+        vec_drop(&v);
+    }
+    free(keys);
+}
+
+/* Pops the greatest of `Vec` kept ascending with `vec_insert` */
+uint64_t sorted_vec_push_pop(Vec* v, uint64_t val) {
+    vec_insert(v, &val, vec_lower_bound_by(v, &val, u64_cmp));
+    uint64_t top = *(uint64_t*)vec_index_ref(v, vec_len(v) - 1);
+    vec_truncate(v, vec_len(v) - 1);
+    return top;
+}
+
+void bench_priority_queue() {
+    printf("\nPriorityQueue benches:\n");
+    const size_t ops = 1000000;
+    size_t depths[] = { 1000, 100000 };
+    uint64_t state = BENCH_SEED;
+    uint64_t sum = 0;
+    char desc[64];
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        size_t depth = depths[d];
+        printf("| --- %lu random push/pop pairs at depth %lu (uint64_t):\n", ops, depth);
+
+        Vec v = vec_new(sizeof(uint64_t));
+        for (size_t i = 0; i < depth; i++) {
+            uint64_t val = bench_rand(&state);
+            vec_insert(&v, &val, vec_lower_bound_by(&v, &val, u64_cmp));
+        }
+        double start = now_secs();
+        for (size_t i = 0; i < ops; i++)
+            sum += sorted_vec_push_pop(&v, bench_rand(&state) >> 1);
+        report("sorted vec_insert + vec_truncate", now_secs() - start, 0);
+        vec_drop(&v);
+
+        size_t arities[] = { 2, 4, 8 };
+        for (size_t a = 0; a < sizeof(arities) / sizeof(arities[0]); a++) {
+            PriorityQueue pq = priority_queue_with_arity(sizeof(uint64_t), u64_cmp, arities[a]);
+            for (size_t i = 0; i < depth; i++) {
+                uint64_t val = bench_rand(&state);
+                priority_queue_push(&pq, &val);
+            }
+            start = now_secs();
+            for (size_t i = 0; i < ops; i++) {
+                uint64_t val = bench_rand(&state) >> 1;
+                uint64_t out;
+                priority_queue_push(&pq, &val);
+                priority_queue_pop(&pq, &out);
+                sum += out;
+            }
+            snprintf(desc, sizeof(desc), "%lu-ary priority_queue_push + pop", arities[a]);
+            report(desc, now_secs() - start, 0);
+            priority_queue_drop(&pq);
+        }
+    }
+
+    const size_t n = 10000000;
+    printf("| --- building from %lu random uint64_t:\n", n);
+    Vec input = vec_with_capacity(sizeof(uint64_t), n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t val = bench_rand(&state);
+        vec_push(&input, &val);
+    }
+    PriorityQueue pq = priority_queue_new(sizeof(uint64_t), u64_cmp);
+    double start = now_secs();
+    for (size_t i = 0; i < n; i++)
+        priority_queue_push(&pq, vec_index_ref_unchecked(&input, i));
+    report("priority_queue_push each", now_secs() - start, n * sizeof(uint64_t));
+    priority_queue_drop(&pq);
+    Vec copy = vec_copy(&input);
+    start = now_secs();
+    pq = priority_queue_from_vec(&copy, u64_cmp, 4);
+    report("priority_queue_from_vec", now_secs() - start, n * sizeof(uint64_t));
+    sum += *(uint64_t*)priority_queue_peek(&pq);
+    priority_queue_drop(&pq);
+    vec_drop(&copy);
+
+    const size_t k = 100;
+    printf("| --- top %lu of %lu random uint64_t:\n", k, n);
+    Slice sl = vec_as_slice(&input);
+    start = now_secs();
+    Vec sorted = vec_with_capacity(sizeof(uint64_t), k + 1);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t* val = vec_index_ref_unchecked(&input, i);
+        if (vec_len(&sorted) < k) {
+            vec_insert(&sorted, val, vec_lower_bound_by(&sorted, val, u64_cmp));
+        } else if (*val > *(uint64_t*)vec_index_ref_unchecked(&sorted, 0)) {
+            vec_remove(&sorted, 0);
+            vec_insert(&sorted, val, vec_lower_bound_by(&sorted, val, u64_cmp));
+        }
+    }
+    report("sorted vec_insert of k", now_secs() - start, n * sizeof(uint64_t));
+    sum += *(uint64_t*)vec_index_ref(&sorted, k - 1);
+    vec_drop(&sorted);
+    copy = vec_copy(&input);
+    start = now_secs();
+    vec_sort_by(&copy, u64_cmp);
+    report("vec_sort_by whole input", now_secs() - start, n * sizeof(uint64_t));
+    sum += *(uint64_t*)vec_index_ref(&copy, n - 1);
+    vec_drop(&copy);
+    start = now_secs();
+    Vec top = slice_top_k(&sl, k, u64_cmp);
+    report("slice_top_k", now_secs() - start, n * sizeof(uint64_t));
+    sum += *(uint64_t*)vec_index_ref(&top, 0);
+    vec_drop(&top);
+    vec_drop(&input);
+    sink = sum;
+}
+
+/* A 64-byte record, of which scans typically read a single field */
+typedef struct {
+    uint64_t id, ts, price, qty, account, venue, flags, seq;
+} BenchRecord;
+
+void bench_soa_vec() {
+    printf("\nSoaVec benches:\n");
+    const size_t n = 4000000;
+    const size_t rounds = 10;
+    printf("| --- %lu rows of 8 uint64_t fields (%lu MiB), %lu scans:\n",
+           n, n * sizeof(BenchRecord) >> 20, rounds);
+    size_t sizes[8];
+    for (size_t col = 0; col < 8; col++)
+        sizes[col] = sizeof(uint64_t);
+
+    Vec rows = vec_new(sizeof(BenchRecord));
+    double start = now_secs();
+    for (uint64_t i = 0; i < n; i++) {
+        BenchRecord r = { i, i * 3, i * 7, i % 100, i % 1000, i % 16, i & 0xff, i };
+        vec_push(&rows, &r);
+    }
+    report("vec_push rows", now_secs() - start, n * sizeof(BenchRecord));
+
+    SoaVec sv = soa_vec_new(sizes, 8);
+    start = now_secs();
+    for (uint64_t i = 0; i < n; i++) {
+        BenchRecord r = { i, i * 3, i * 7, i % 100, i % 1000, i % 16, i & 0xff, i };
+        soa_vec_push_row(&sv, &r);
+    }
+    report("soa_vec_push_row", now_secs() - start, n * sizeof(BenchRecord));
+    SoaVec reserved = soa_vec_with_capacity(sizes, 8, n);
+    start = now_secs();
+    for (uint64_t i = 0; i < n; i++) {
+        BenchRecord r = { i, i * 3, i * 7, i % 100, i % 1000, i % 16, i & 0xff, i };
+        soa_vec_push_row(&reserved, &r);
+    }
+    report("soa_vec_push_row after soa_vec_with_capacity", now_secs() - start, n * sizeof(BenchRecord));
+    soa_vec_drop(&reserved);
+
+    uint64_t sum = 0;
+    start = now_secs();
+    for (size_t r = 0; r < rounds; r++) {
+        const BenchRecord* recs = vec_index_ref(&rows, 0);
+        for (size_t i = 0; i < n; i++)
+            sum += recs[i].price;
+    }
+    report("sum one field of Vec of structs", now_secs() - start, rounds * n * sizeof(uint64_t));
+
+    start = now_secs();
+    for (size_t r = 0; r < rounds; r++) {
+        Slice prices = soa_vec_column(&sv, 2);
+        const uint64_t* p = prices.__data;
+        for (size_t i = 0; i < prices.__len; i++)
+            sum += p[i];
+    }
+    report("sum one soa_vec_column", now_secs() - start, rounds * n * sizeof(uint64_t));
+
+    start = now_secs();
+    for (size_t r = 0; r < rounds; r++) {
+        const BenchRecord* recs = vec_index_ref(&rows, 0);
+        for (size_t i = 0; i < n; i++)
+            sum += recs[i].price * recs[i].qty;
+    }
+    report("price * qty over Vec of structs", now_secs() - start, rounds * n * 2 * sizeof(uint64_t));
+
+    start = now_secs();
+    for (size_t r = 0; r < rounds; r++) {
+        Slice prices = soa_vec_column(&sv, 2);
+        Slice qtys = soa_vec_column(&sv, 3);
+        const uint64_t* p = prices.__data;
+        const uint64_t* q = qtys.__data;
+        for (size_t i = 0; i < prices.__len; i++)
+            sum += p[i] * q[i];
+    }
+    report("price * qty over two soa_vec_columns", now_secs() - start, rounds * n * 2 * sizeof(uint64_t));
+
+    BenchRecord row;
+    start = now_secs();
+    for (size_t i = 0; i < n; i++) {
+        soa_vec_get_row(&sv, i, &row);
+        sum += row.seq;
+    }
+    report("soa_vec_get_row every row", now_secs() - start, n * sizeof(BenchRecord));
+
+    vec_drop(&rows);
+    soa_vec_drop(&sv);
+    sink = sum;
+}
+
+/* Strictly increasing uint32_t with an average gap of `universe / n` */
+Vec bench_posting_list(size_t n, uint32_t universe, uint64_t* state) {
+    Vec v = vec_with_capacity(sizeof(uint32_t), n);
+    uint32_t gap = (uint32_t)(2 * (universe / n)) - 1;
+    uint32_t x = 0;
+    for (size_t i = 0; i < n; i++) {
+        x += 1 + (uint32_t)(bench_rand(state) % gap);
+        vec_push(&v, &x);
+    }
+    return v;
+}
+
+/* The scalar merge over `vec_index_ref` these functions replace */
+void naive_intersect(Vec* a, Vec* b, Vec* out) {
+    size_t i = 0, j = 0;
+    while (i < vec_len(a) && j < vec_len(b)) {
+        uint32_t x = *(uint32_t*)vec_index_ref(a, i);
+        uint32_t y = *(uint32_t*)vec_index_ref(b, j);
+        if (x < y) {
+            i++;
+        } else if (y < x) {
+            j++;
+        } else {
+            vec_push(out, &x);
+            i++;
+            j++;
+        }
+    }
+}
+
+void bench_sorted_sets() {
+    printf("\nSorted set benches:\n");
+    const size_t n = 10000000;
+    const uint32_t universe = 100000000;
+    uint64_t state = BENCH_SEED;
+    Vec large = bench_posting_list(n, universe, &state);
+    Slice large_sl = vec_as_slice(&large);
+    Vec out = vec_with_capacity(sizeof(uint32_t), n);
+    char desc[64];
+    size_t ratios[] = { 1, 10, 100, 1000 };
+    for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+        size_t small_n = n / ratios[r];
+        printf("| --- %lu x %lu uint32_t ids below %u (1:%lu):\n", small_n, n, universe, ratios[r]);
+        Vec small = bench_posting_list(small_n, universe, &state);
+        Slice small_sl = vec_as_slice(&small);
+        size_t bytes = (small_n + n) * sizeof(uint32_t);
+
+        vec_truncate(&out, 0);
+        double start = now_secs();
+        naive_intersect(&small, &large, &out);
+        snprintf(desc, sizeof(desc), "merge over vec_index_ref (%lu found)", vec_len(&out));
+        report(desc, now_secs() - start, bytes);
+
+        vec_truncate(&out, 0);
+        start = now_secs();
+        slice_sorted_intersect_u32(&small_sl, &large_sl, &out);
+        report("slice_sorted_intersect_u32", now_secs() - start, bytes);
+
+        vec_truncate(&out, 0);
+        start = now_secs();
+        slice_sorted_intersect_gallop_u32(&small_sl, &large_sl, &out);
+        report("slice_sorted_intersect_gallop_u32", now_secs() - start, bytes);
+
+        vec_truncate(&out, 0);
+        start = now_secs();
+        slice_sorted_union_u32(&small_sl, &large_sl, &out);
+        report("slice_sorted_union_u32", now_secs() - start, bytes);
+
+        vec_truncate(&out, 0);
+        start = now_secs();
+        slice_sorted_difference_u32(&large_sl, &small_sl, &out);
+        report("slice_sorted_difference_u32 (large - small)", now_secs() - start, bytes);
+        sink = vec_len(&out);
+        vec_drop(&small);
+    }
+    vec_drop(&out);
+    vec_drop(&large);
+}
+
+/* Groups are matched by their whole name, as many names contain shorter ones */
+uint8_t selected(const char* filter, const char* group) {
+    return filter[0] == '\0' || strcmp(filter, group) == 0;
+}
+
+/* Run the benchmark group named by the first argument, or all of them.
+ * The second argument sets the element count of the sort and par_sort benches.
+ */
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    printf("c-utils benches...\n");
+    if (selected(filter, "utf8"))
+        bench_utf8();
+    if (selected(filter, "parse"))
+        bench_parse();
+    if (selected(filter, "format"))
+        bench_format();
+    if (selected(filter, "csv"))
+        bench_csv();
+    if (selected(filter, "search"))
+        bench_search();
+    if (selected(filter, "file"))
+        bench_file();
+    if (selected(filter, "write"))
+        bench_write();
+    if (selected(filter, "batch"))
+        bench_batch_read();
+    if (selected(filter, "vec"))
+        bench_vec();
+    if (selected(filter, "vec_bulk"))
+        bench_vec_bulk();
+    if (selected(filter, "vec_large"))
+        bench_vec_large();
+    if (selected(filter, "queue"))
+        bench_queue();
+    if (selected(filter, "bit_vec"))
+        bench_bit_vec();
+    if (selected(filter, "sort"))
+        bench_sort(argc > 2 ? strtoul(argv[2], NULL, 10) : 10000000);
+    if (selected(filter, "sorted_search"))
+        bench_sorted_search();
+    if (selected(filter, "par_sort"))
+        bench_par_sort(argc > 2 ? strtoul(argv[2], NULL, 10) : 10000000);
+    if (selected(filter, "priority_queue"))
+        bench_priority_queue();
+    if (selected(filter, "soa_vec"))
+        bench_soa_vec();
+    if (selected(filter, "sorted_sets"))
+        bench_sorted_sets();
+    return 0;
+}
@@ -1,8 +1,15 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <math.h>
+#include <locale.h>
 #include "../../utils.h"
 
 #define ASSERT(desc, ty, expr, op, expected, expln) \
@@ -72,6 +79,12 @@ void test_new_string_mutate() {
     ASSERT("content copy equal", uint8_t, string_eq(&s, &s2), ==, 0, "expected: %d, got: %d");
     ASSERT("content copy equal (str)", uint8_t, str_eq(&str1, &str2), ==, 0, "expected: %d, got: %d");
 
+    printf("| --- Push a str bounded by its buffer size:\n");
+    char buf[32] = "cd";
+    string_push_cstr_bound(&s, buf, sizeof(buf));
+    ASSERT("len",       size_t, string_len(&s), ==, 20, "expected: %lu, got: %lu");
+    ASSERT("last",      char, string_index(&s, 19), ==, 'd', "expected: %c, got: %c");
+
     string_drop(&s);
     string_drop(&s2);
 }
@@ -99,6 +112,281 @@ void test_string_from_file_str_trim() {
     string_drop(&s);
 }
 
+void test_map_file() {
+    printf("| --- Mapped file:\n");
+    String s = read_file("input.txt");
+    MappedFile mf = map_file_with_flags("input.txt", MAP_FILE_POPULATE | MAP_FILE_HUGE_PAGES);
+    Str mapped = mapped_file_as_str(&mf);
+    Str read = string_as_str(&s);
+    ASSERT("len", size_t, mapped_file_len(&mf), ==, string_len(&s), "expected: %lu, got: %lu");
+    ASSERT("content", uint8_t, str_eq(&mapped, &read), ==, 0, "expected: %d, got: %d");
+    mapped_file_drop(&mf);
+    string_drop(&s);
+
+    /* a file ending exactly on a page boundary, with no trailing newline or null byte */
+    char path[] = "/tmp/cutils_map_file_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT("temp file", uint8_t, fd >= 0, ==, 1, "expected: %d, got: %d");
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char* page_data = malloc(page);
+    memset(page_data, 'x', page);
+    page_data[page / 2] = '\n';
+    ASSERT("temp file written", size_t, (size_t)write(fd, page_data, page), ==, page, "expected: %lu, got: %lu");
+    close(fd);
+    mf = map_file(path);
+    Str whole = mapped_file_as_str(&mf);
+    Vec lines = str_split_lines(&whole);
+    ASSERT("page lines", size_t, vec_len(&lines), ==, 2, "expected: %lu, got: %lu");
+    ASSERT("last line len", size_t, str_len(vec_index_ref(&lines, 1)), ==, page - page / 2 - 1, "expected: %lu, got: %lu");
+    vec_drop(&lines);
+    mapped_file_drop(&mf);
+
+    fd = open(path, O_WRONLY | O_TRUNC);
+    close(fd);
+    mf = map_file(path);
+    Str empty = mapped_file_as_str(&mf);
+    ASSERT("empty file", size_t, str_len(&empty), ==, 0, "expected: %lu, got: %lu");
+    mapped_file_drop(&mf);
+    unlink(path);
+    free(page_data);
+}
+
+void test_line_reader() {
+    printf("| --- LineReader:\n");
+    String content = string_new();
+    for (size_t i = 0; i < 200; i++) {
+        /* lines of 0 to 49 bytes, with one much longer than the block size */
+        for (size_t k = 0; k < (i == 100 ? 1000 : i % 50); k++)
+            string_push_char(&content, (char)('a' + k % 26));
+        if (i < 199)
+            string_push_char(&content, '\n');
+    }
+    Str content_str = string_as_str(&content);
+    Vec expected = str_split_lines(&content_str);
+
+    char path[] = "/tmp/cutils_line_reader_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT("temp file", uint8_t, fd >= 0, ==, 1, "expected: %d, got: %d");
+    ASSERT("temp file written", size_t, (size_t)write(fd, string_as_cstr(&content), string_len(&content)), ==,
+           string_len(&content), "expected: %lu, got: %lu");
+    lseek(fd, 0, SEEK_SET);
+    LineReader lr = line_reader_with_block_size(fd, 64);
+    size_t count = 0;
+    uint8_t all_equal = 1;
+    while (!line_reader_done(&lr)) {
+        Str line = line_reader_next(&lr);
+        if (count >= vec_len(&expected) || str_eq(&line, vec_index_ref(&expected, count)) != 0)
+            all_equal = 0;
+        count++;
+    }
+    ASSERT("line count", size_t, count, ==, 200, "expected: %lu, got: %lu");
+    ASSERT("lines equal", uint8_t, all_equal, ==, 1, "expected: %d, got: %d");
+    ASSERT("no error", int, line_reader_error(&lr), ==, 0, "expected: %d, got: %d");
+    line_reader_drop(&lr);
+    close(fd);
+    unlink(path);
+
+    /* pipes can't be advised, but are read the same way; a trailing newline adds no empty line */
+    int fds[2];
+    ASSERT("pipe", int, pipe(fds), ==, 0, "expected: %d, got: %d");
+    ASSERT("pipe written", long, (long)write(fds[1], "one\n\ntwo\n", 9), ==, 9, "expected: %ld, got: %ld");
+    close(fds[1]);
+    LineReader piped = line_reader_new(fds[0]);
+    const char* piped_lines[] = {"one", "", "two"};
+    count = 0;
+    while (!line_reader_done(&piped)) {
+        Str line = line_reader_next(&piped);
+        Str exp = str_from_cstr(piped_lines[count < 3 ? count : 2]);
+        ASSERT("--- piped line", uint8_t, str_eq(&line, &exp), ==, 0, "expected: %d, got: %d");
+        count++;
+    }
+    ASSERT("piped line count", size_t, count, ==, 3, "expected: %lu, got: %lu");
+    line_reader_drop(&piped);
+    close(fds[0]);
+    vec_drop(&expected);
+    string_drop(&content);
+}
+
+typedef struct {
+    size_t lines, bytes;
+    uint64_t checksum;
+} LineStats;
+
+void count_line(Str* line, void* ctx) {
+    LineStats* stats = (LineStats*)ctx;
+    stats->lines++;
+    stats->bytes += str_len(line);
+    stats->checksum += str_hash(line);
+}
+
+void merge_line_stats(void* dst, void* src) {
+    LineStats* a = (LineStats*)dst;
+    LineStats* b = (LineStats*)src;
+    a->lines += b->lines;
+    a->bytes += b->bytes;
+    a->checksum += b->checksum;
+}
+
+void test_parallel_for_lines() {
+    printf("| --- Parallel for lines:\n");
+    ASSERT("num cpus", uint8_t, utils_num_cpus() >= 1, ==, 1, "expected: %d, got: %d");
+    String content = string_new();
+    for (size_t i = 0; i < 1000; i++) {
+        for (size_t k = 0; k < (i * 7) % 300; k++)
+            string_push_char(&content, (char)('a' + (i + k) % 26));
+        string_push_char(&content, '\n');
+    }
+    Str content_str = string_as_str(&content);
+    LineStats serial = {0, 0, 0};
+    Vec lines = str_split_lines(&content_str);
+    for (size_t i = 0; i + 1 < vec_len(&lines); i++)
+        count_line(vec_index_ref(&lines, i), &serial);
+    vec_drop(&lines);
+
+    size_t thread_counts[] = {1, 3, 8};
+    for (size_t t = 0; t < 3; t++) {
+        LineStats* ctxs = calloc(thread_counts[t], sizeof(LineStats));
+        parallel_for_lines(&content_str, thread_counts[t], count_line, ctxs, sizeof(LineStats), merge_line_stats);
+        ASSERT("--- lines", size_t, ctxs[0].lines, ==, serial.lines, "expected: %lu, got: %lu");
+        ASSERT("--- bytes", size_t, ctxs[0].bytes, ==, serial.bytes, "expected: %lu, got: %lu");
+        ASSERT("--- checksum", uint64_t, ctxs[0].checksum, ==, serial.checksum, "expected: %lu, got: %lu");
+        free(ctxs);
+    }
+
+    /* far more threads than lines: only the ranges holding a line get any work */
+    Str few_lines = str_from_cstr("one\ntwo\nthree\n");
+    LineStats* many_ctxs = calloc(2000, sizeof(LineStats));
+    parallel_for_lines(&few_lines, 2000, count_line, many_ctxs, sizeof(LineStats), NULL);
+    size_t busy = 0, total = 0;
+    for (size_t i = 0; i < 2000; i++) {
+        busy += many_ctxs[i].lines > 0;
+        total += many_ctxs[i].lines;
+    }
+    ASSERT("threads past line count, lines", size_t, total, ==, 3, "expected: %lu, got: %lu");
+    ASSERT("threads past line count, busy ranges", uint8_t, busy <= 3, ==, 1, "expected: %d, got: %d");
+    free(many_ctxs);
+
+    char path[] = "/tmp/cutils_parallel_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT("temp file written", size_t, (size_t)write(fd, string_as_cstr(&content), string_len(&content)), ==,
+           string_len(&content), "expected: %lu, got: %lu");
+    close(fd);
+    LineStats ctxs[4];
+    memset(ctxs, 0, sizeof(ctxs));
+    parallel_for_lines_in_file(path, 4, count_line, ctxs, sizeof(LineStats), merge_line_stats);
+    ASSERT("file lines", size_t, ctxs[0].lines, ==, serial.lines, "expected: %lu, got: %lu");
+    ASSERT("file checksum", uint64_t, ctxs[0].checksum, ==, serial.checksum, "expected: %lu, got: %lu");
+    unlink(path);
+    string_drop(&content);
+}
+
+void test_buf_writer() {
+    printf("| --- BufWriter:\n");
+    FILE* f = tmpfile();
+    BufWriter w = buf_writer_with_capacity(fileno(f), 64);
+    String expected = string_new();
+    for (size_t i = 0; i < 20; i++) {
+        buf_writer_write_u64(&w, i);
+        buf_writer_write_char(&w, ',');
+        buf_writer_write_i64(&w, -(int64_t)i);
+        buf_writer_write_cstr(&w, ",");
+        buf_writer_write_f64(&w, (double)i / 4);
+        buf_writer_write_char(&w, '\n');
+        string_push_u64(&expected, i);
+        string_push_char(&expected, ',');
+        string_push_i64(&expected, -(int64_t)i);
+        string_push_cstr(&expected, ",");
+        string_push_f64(&expected, (double)i / 4);
+        string_push_char(&expected, '\n');
+    }
+    ASSERT("buffered writes", uint8_t, buf_writer_syscalls(&w) < 20, ==, 1, "expected: %d, got: %d");
+    /* a large payload skips the buffer, going out with the buffered data in one call */
+    String large = string_new();
+    for (size_t i = 0; i < 500; i++)
+        string_push_char(&large, (char)('a' + i % 26));
+    buf_writer_write_string(&w, &large);
+    string_push_str(&expected, &(Str){ .__data=string_as_cstr(&large), .__len=string_len(&large) });
+    Str tail = str_from_cstr("tail");
+    buf_writer_write_str(&w, &tail);
+    string_push_cstr(&expected, "tail");
+    /* so does one of at least half the capacity that would still fit */
+    size_t calls = buf_writer_syscalls(&w);
+    const char* half = "0123456789012345678901234567890123456789";
+    buf_writer_write_cstr(&w, half);
+    string_push_cstr(&expected, half);
+    ASSERT("half capacity written through", size_t, buf_writer_syscalls(&w), ==, calls + 1, "expected: %lu, got: %lu");
+    ASSERT("flush", int, buf_writer_flush(&w), ==, 0, "expected: %d, got: %d");
+    ASSERT("no error", int, buf_writer_error(&w), ==, 0, "expected: %d, got: %d");
+
+    rewind(f);
+    char buf[2048];
+    size_t read = fread(buf, sizeof(char), sizeof(buf), f);
+    ASSERT("written len", size_t, read, ==, string_len(&expected), "expected: %lu, got: %lu");
+    ASSERT("written content", int, memcmp(buf, string_as_cstr(&expected), read), ==, 0, "expected: %d, got: %d");
+    buf_writer_drop(&w);
+    fclose(f);
+
+    /* errors stick, and later writes are discarded */
+    int fds[2];
+    ASSERT("pipe", int, pipe(fds), ==, 0, "expected: %d, got: %d");
+    close(fds[0]);
+    signal(SIGPIPE, SIG_IGN);
+    BufWriter broken = buf_writer_new(fds[1]);
+    buf_writer_write_cstr(&broken, "lost");
+    ASSERT("flush error", int, buf_writer_flush(&broken), ==, -1, "expected: %d, got: %d");
+    ASSERT("error code", int, buf_writer_error(&broken), ==, EPIPE, "expected: %d, got: %d");
+    buf_writer_write_cstr(&broken, "discarded");
+    ASSERT("still failing", int, buf_writer_flush(&broken), ==, -1, "expected: %d, got: %d");
+    ASSERT("single attempt", size_t, buf_writer_syscalls(&broken), ==, 1, "expected: %lu, got: %lu");
+    buf_writer_drop(&broken);
+    close(fds[1]);
+    string_drop(&large);
+    string_drop(&expected);
+}
+
+void test_read_files_batch() {
+    printf("| --- Read files batch:\n");
+    const size_t n = 300;
+    char (*paths)[40] = malloc((n + 1) * sizeof(*paths));
+    const char** path_ptrs = malloc((n + 1) * sizeof(char*));
+    String* contents = malloc(n * sizeof(String));
+    uint8_t written_all = 1;
+    for (size_t i = 0; i < n; i++) {
+        strcpy(paths[i], "/tmp/cutils_batch_XXXXXX");
+        int fd = mkstemp(paths[i]);
+        contents[i] = string_new();
+        /* sizes from empty up to a few hundred KB */
+        size_t len = (i * i * 37) % (i % 10 == 0 ? 300000 : 3000);
+        for (size_t k = 0; k < len; k++)
+            string_push_char(&contents[i], (char)('a' + (i + k) % 26));
+        written_all &= write(fd, contents[i].__data, string_len(&contents[i])) == (ssize_t)string_len(&contents[i]);
+        close(fd);
+        path_ptrs[i] = paths[i];
+    }
+    path_ptrs[n] = "/tmp/cutils_batch_missing/file";
+    ASSERT("temp files written", uint8_t, written_all, ==, 1, "expected: %d, got: %d");
+
+    String* out = malloc((n + 1) * sizeof(String));
+    int* errors = malloc((n + 1) * sizeof(int));
+    ASSERT("failures", size_t, read_files_batch(path_ptrs, n + 1, out, errors), ==, 1, "expected: %lu, got: %lu");
+    uint8_t all_equal = 1;
+    for (size_t i = 0; i < n; i++) {
+        all_equal &= errors[i] == 0 && string_eq(&out[i], &contents[i]) == 0;
+        unlink(paths[i]);
+        string_drop(&out[i]);
+        string_drop(&contents[i]);
+    }
+    ASSERT("contents", uint8_t, all_equal, ==, 1, "expected: %d, got: %d");
+    ASSERT("missing error", int, errors[n], ==, ENOENT, "expected: %d, got: %d");
+    ASSERT("missing empty", size_t, string_len(&out[n]), ==, 0, "expected: %lu, got: %lu");
+    ASSERT("no errors array", size_t, read_files_batch(path_ptrs + n, 1, out, NULL), ==, 1, "expected: %lu, got: %lu");
+    free(out);
+    free(errors);
+    free(contents);
+    free(path_ptrs);
+    free(paths);
+}
+
 void test_str_split_whitespace() {
     printf("| --- String split whitespace:\n");
     String s = string_copy_from_cstr("1  a\n bcdef   \tg \t 3");
@@ -182,15 +470,443 @@ void test_str_split_by_blank_match() {
     string_drop(&s);
 }
 
+void test_string_builder() {
+    printf("| --- StringBuilder push fragments:\n");
+    StringBuilder sb = string_builder_with_chunk_size(8);
+    String expected = string_new();
+    const char* fragments[] = {"abc", "defgh", "ijklmnopqrstuvwxyz", "", "0123"};
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 0; i < 5; i++) {
+            string_builder_push_cstr(&sb, fragments[i]);
+            string_push_cstr(&expected, fragments[i]);
+        }
+        string_builder_push_char(&sb, '!');
+        string_push_char(&expected, '!');
+    }
+    ASSERT("len", size_t, string_builder_len(&sb), ==, string_len(&expected), "expected: %lu, got: %lu");
+
+    printf("| --- StringBuilder write to fd:\n");
+    FILE* f = tmpfile();
+    ASSERT("write status", int, string_builder_write_fd(&sb, fileno(f)), ==, 0, "expected: %d, got: %d");
+    rewind(f);
+    char buf[256];
+    size_t read = fread(buf, sizeof(char), sizeof(buf), f);
+    fclose(f);
+    ASSERT("written len", size_t, read, ==, string_len(&expected), "expected: %lu, got: %lu");
+    ASSERT("written content", int, memcmp(buf, string_as_cstr(&expected), read), ==, 0, "expected: %d, got: %d");
+
+    printf("| --- StringBuilder into String:\n");
+    String s = string_builder_into_string(&sb);
+    ASSERT("builder emptied", size_t, string_builder_len(&sb), ==, 0, "expected: %lu, got: %lu");
+    ASSERT("content equal", uint8_t, string_eq(&s, &expected), ==, 0, "expected: %d, got: %d");
+    ASSERT("null terminated", char, string_as_cstr(&s)[string_len(&s)], ==, '\0', "expected: %d, got: %d");
+
+    string_builder_push_cstr(&sb, "single");
+    String single = string_builder_into_string(&sb);
+    ASSERT("single chunk content", int, strcmp(string_as_cstr(&single), "single"), ==, 0, "expected: %d, got: %d");
+
+    string_builder_drop(&sb);
+    string_drop(&single);
+    string_drop(&s);
+    string_drop(&expected);
+}
+
+void test_string_interner() {
+    printf("| --- StringInterner dedup:\n");
+    StringInterner si = string_interner_new();
+    Symbol host_a = string_interner_intern_cstr(&si, "example.com");
+    Symbol field = string_interner_intern_cstr(&si, "content-length");
+    String host_copy = string_copy_from_cstr("example.com");
+    Str host_str = string_as_str(&host_copy);
+    Symbol host_b = string_interner_intern(&si, &host_str);
+    ASSERT("same symbol", Symbol, host_a, ==, host_b, "expected: %u, got: %u");
+    ASSERT("distinct symbol", Symbol, host_a, !=, field, "expected: %u, got: %u");
+    ASSERT("len", size_t, string_interner_len(&si), ==, 2, "expected: %lu, got: %lu");
+
+    Str resolved = string_interner_resolve(&si, field);
+    Str expected = str_from_cstr("content-length");
+    ASSERT("resolve content", uint8_t, str_eq(&resolved, &expected), ==, 0, "expected: %d, got: %d");
+    ASSERT("resolve cstr", int, strcmp(str_as_ptr(&resolved), "content-length"), ==, 0, "expected: %d, got: %d");
+
+    Symbol found = 0;
+    Str missing = str_from_cstr("missing");
+    ASSERT("get present", uint8_t, string_interner_get(&si, &expected, &found), ==, 1, "expected: %d, got: %d");
+    ASSERT("get symbol", Symbol, found, ==, field, "expected: %u, got: %u");
+    ASSERT("get missing", uint8_t, string_interner_get(&si, &missing, &found), ==, 0, "expected: %d, got: %d");
+
+    printf("| --- StringInterner many symbols:\n");
+    char buf[32];
+    for (size_t i = 0; i < 5000; i++) {
+        sprintf(buf, "key-%lu", i);
+        string_interner_intern_cstr(&si, buf);
+    }
+    ASSERT("len", size_t, string_interner_len(&si), ==, 5002, "expected: %lu, got: %lu");
+    Symbol sym_42 = string_interner_intern_cstr(&si, "key-42");
+    Str resolved_42 = string_interner_resolve(&si, sym_42);
+    ASSERT("resolve after growth", int, strcmp(str_as_ptr(&resolved_42), "key-42"), ==, 0, "expected: %d, got: %d");
+
+    printf("| --- Symbol HashMap keys:\n");
+    HashMap map = hashmap_new(sizeof(Symbol), sizeof(size_t), symbol_hash, symbol_eq, utils_noop, utils_noop);
+    size_t host_count = 3;
+    size_t field_count = 7;
+    hashmap_insert(&map, &host_a, &host_count);
+    hashmap_insert(&map, &field, &field_count);
+    size_t* count_ref = hashmap_get_ref(&map, &host_b);
+    ASSERT("lookup by equal symbol", size_t, *count_ref, ==, 3, "expected: %lu, got: %lu");
+    hashmap_drop(&map);
+
+    string_drop(&host_copy);
+    string_interner_drop(&si);
+}
+
+void test_str_cmp() {
+    printf("| --- Str ordering:\n");
+    Str apple = str_from_cstr("apple");
+    Str apples = str_from_cstr("apples");
+    Str banana = str_from_cstr("banana");
+    Str high = str_from_cstr("\xff");
+    Str empty = str_from_cstr("");
+    ASSERT("equal", CmpOrdering, str_cmp(&apple, &apple), ==, CMP_EQUAL, "expected: %d, got: %d");
+    ASSERT("prefix is less", CmpOrdering, str_cmp(&apple, &apples), ==, CMP_LESS, "expected: %d, got: %d");
+    ASSERT("greater", CmpOrdering, str_cmp(&banana, &apples), ==, CMP_GREATER, "expected: %d, got: %d");
+    ASSERT("bytes unsigned", CmpOrdering, str_cmp(&high, &banana), ==, CMP_GREATER, "expected: %d, got: %d");
+    ASSERT("empty is least", CmpOrdering, str_cmp(&empty, &apple), ==, CMP_LESS, "expected: %d, got: %d");
+    ASSERT("unequal len", uint8_t, str_eq(&apple, &apples), !=, 0, "expected: %d, got: %d");
+
+    String s1 = string_copy_from_cstr("apple");
+    String s2 = string_copy_from_cstr("apricot");
+    ASSERT("string less", CmpOrdering, string_cmp(&s1, &s2), ==, CMP_LESS, "expected: %d, got: %d");
+    string_drop(&s1);
+    string_drop(&s2);
+}
+
+void test_hashed_str() {
+    printf("| --- HashedStr keys:\n");
+    Str host = str_from_cstr("example.com");
+    HashedStr key = hashed_str_new(&host);
+    ASSERT("hash matches str_hash", uint64_t, hashed_str_hash(&key), ==, str_hash(&host), "expected: %lu, got: %lu");
+
+    HashMap map = hashmap_new(sizeof(HashedStr), sizeof(size_t), hashed_str_hash, hashed_str_eq, utils_noop, utils_noop);
+    size_t value = 42;
+    hashmap_insert(&map, &key, &value);
+    HashedStr lookup = hashed_str_from_cstr("example.com");
+    HashedStr missing = hashed_str_from_cstr("example.org");
+    size_t* value_ref = hashmap_get_ref(&map, &lookup);
+    ASSERT("lookup by equal key", size_t, *value_ref, ==, 42, "expected: %lu, got: %lu");
+    ASSERT("lookup missing key", uintptr_t, (uintptr_t)hashmap_get_ref(&map, &missing), ==, 0, "expected: %lu, got: %lu");
+    Str back = hashed_str_as_str(&lookup);
+    ASSERT("as str", uint8_t, str_eq(&back, &host), ==, 0, "expected: %d, got: %d");
+    hashmap_drop(&map);
+}
+
+void test_str_validate_utf8() {
+    printf("| --- Str validate utf8:\n");
+    const char* valid[] = {
+        "",
+        "plain ascii that is longer than a single sixteen byte block",
+        "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 mixed text spanning blocks \xe4\xb8\xad\xe6\x96\x87",
+        "\xf4\x8f\xbf\xbf max codepoint",
+    };
+    for (size_t i = 0; i < 4; i++) {
+        Str str = str_from_cstr(valid[i]);
+        ASSERT("--- valid", uint8_t, str_validate_utf8(&str), ==, 1, "expected: %d, got: %d");
+    }
+    const char* invalid[] = {
+        "ascii prefix longer than one block then a lone continuation \x80",
+        "overlong encoding of slash \xc0\xaf in the middle of the text",
+        "surrogate half \xed\xa0\x80 in the middle of the text .......",
+        "above max codepoint \xf4\x90\x80\x80 in the middle of the text",
+        "truncated sequence right at the very end \xe2\x82",
+        "\xe2\x82 truncated at the start",
+    };
+    for (size_t i = 0; i < 6; i++) {
+        Str str = str_from_cstr(invalid[i]);
+        ASSERT("--- invalid", uint8_t, str_validate_utf8(&str), ==, 0, "expected: %d, got: %d");
+    }
+}
+
+void test_str_char_iter() {
+    printf("| --- Str char iter:\n");
+    Str str = str_from_cstr("a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\xff!");
+    uint32_t expected[] = {'a', 0xE9, 0x20AC, 0x1F600, UTF8_REPLACEMENT_CHAR, '!'};
+    size_t offsets[] = {0, 1, 3, 6, 10, 11};
+    StrCharIter iter = str_char_iter(&str);
+    size_t count = 0;
+    while (!str_char_iter_done(&iter)) {
+        ASSERT("--- offset", size_t, str_char_iter_offset(&iter), ==, offsets[count], "expected: %lu, got: %lu");
+        ASSERT("--- codepoint", uint32_t, str_char_iter_next(&iter), ==, expected[count], "expected: %u, got: %u");
+        count++;
+    }
+    ASSERT("num codepoints", size_t, count, ==, 6, "expected: %lu, got: %lu");
+
+    Str text = str_from_cstr("\xe4\xb8\xad\xe6\x96\x87 and some ascii after the multibyte text");
+    ASSERT("char count", size_t, str_char_count(&text), ==, 42, "expected: %lu, got: %lu");
+    ASSERT("char index", size_t, str_char_index(&text, 7), ==, 3, "expected: %lu, got: %lu");
+    ASSERT("char index at end", size_t, str_char_index(&text, str_len(&text)), ==, 42, "expected: %lu, got: %lu");
+}
+
+void test_str_parse_ints() {
+    printf("| --- Str parse integers:\n");
+    Str f[] = {
+        str_from_cstr("42"), str_from_cstr("-17"), str_from_cstr("+8"),
+        str_from_cstr("18446744073709551615"), str_from_cstr("18446744073709551616"),
+        str_from_cstr("-9223372036854775808"), str_from_cstr("9223372036854775808"),
+        str_from_cstr("12x"), str_from_cstr(""), str_from_cstr("-"), str_from_cstr("00001234567890123"),
+    };
+    uint64_t u = 0;
+    int64_t i = 0;
+    ASSERT("u64", ParseStatus, str_parse_u64(f, &u), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("u64 value", uint64_t, u, ==, 42, "expected: %lu, got: %lu");
+    ASSERT("i64 negative", ParseStatus, str_parse_i64(f + 1, &i), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("i64 negative value", int64_t, i, ==, -17, "expected: %ld, got: %ld");
+    ASSERT("u64 rejects minus", ParseStatus, str_parse_u64(f + 1, &u), ==, PARSE_INVALID, "expected: %d, got: %d");
+    ASSERT("i64 plus", ParseStatus, str_parse_i64(f + 2, &i), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("i64 plus value", int64_t, i, ==, 8, "expected: %ld, got: %ld");
+    ASSERT("u64 max", ParseStatus, str_parse_u64(f + 3, &u), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("u64 max value", uint64_t, u, ==, UINT64_MAX, "expected: %lu, got: %lu");
+    ASSERT("u64 overflow", ParseStatus, str_parse_u64(f + 4, &u), ==, PARSE_OVERFLOW, "expected: %d, got: %d");
+    ASSERT("i64 min", ParseStatus, str_parse_i64(f + 5, &i), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("i64 min value", int64_t, i, ==, INT64_MIN, "expected: %ld, got: %ld");
+    ASSERT("i64 overflow", ParseStatus, str_parse_i64(f + 6, &i), ==, PARSE_OVERFLOW, "expected: %d, got: %d");
+    ASSERT("trailing garbage", ParseStatus, str_parse_i64(f + 7, &i), ==, PARSE_INVALID, "expected: %d, got: %d");
+    ASSERT("empty", ParseStatus, str_parse_i64(f + 8, &i), ==, PARSE_EMPTY, "expected: %d, got: %d");
+    ASSERT("sign only", ParseStatus, str_parse_i64(f + 9, &i), ==, PARSE_INVALID, "expected: %d, got: %d");
+    ASSERT("leading zeros, 8 digit chunks", ParseStatus, str_parse_u64(f + 10, &u), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("leading zeros value", uint64_t, u, ==, 1234567890123, "expected: %lu, got: %lu");
+}
+
+void test_str_parse_f64() {
+    printf("| --- Str parse floats:\n");
+    const char* inputs[] = {
+        "3.14159", "-0.5", "1e10", "2.5E-3", ".25", "7.", "0.000000000000000000000001",
+        "12345678.87654321", "1.7976931348623157e308", "4.9406564584124654e-324",
+        "2.2250738585072011e-308", "9007199254740993", "123456789012345678901234567890",
+    };
+    for (size_t k = 0; k < 13; k++) {
+        Str str = str_from_cstr(inputs[k]);
+        double v = 0;
+        ASSERT("--- status", ParseStatus, str_parse_f64(&str, &v), ==, PARSE_OK, "expected: %d, got: %d");
+        ASSERT("--- matches strtod", double, v, ==, strtod(inputs[k], NULL), "expected: %.17g, got: %.17g");
+    }
+    double v = 0;
+    Str inf = str_from_cstr("-Infinity");
+    ASSERT("infinity", ParseStatus, str_parse_f64(&inf, &v), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("infinity value", double, v, <, -1.7976931348623157e308, "expected: %g, got: %g");
+    Str nan = str_from_cstr("nan");
+    ASSERT("nan", ParseStatus, str_parse_f64(&nan, &v), ==, PARSE_OK, "expected: %d, got: %d");
+    ASSERT("nan value", double, v, !=, v, "expected: %g, got: %g");
+    Str overflow = str_from_cstr("1e309");
+    ASSERT("overflow", ParseStatus, str_parse_f64(&overflow, &v), ==, PARSE_OVERFLOW, "expected: %d, got: %d");
+    const char* invalid[] = {".", "1e", "1.2.3", "--1", "1e+", "0x10", " 1"};
+    for (size_t k = 0; k < 7; k++) {
+        Str str = str_from_cstr(invalid[k]);
+        ASSERT("--- invalid", ParseStatus, str_parse_f64(&str, &v), ==, PARSE_INVALID, "expected: %d, got: %d");
+    }
+    /* the slow path must not follow a comma-decimal locale, when one is installed */
+    if (setlocale(LC_NUMERIC, "de_DE.UTF-8") != NULL || setlocale(LC_NUMERIC, "fr_FR.UTF-8") != NULL) {
+        Str long_digits = str_from_cstr("1.2345678901234567890123");
+        ASSERT("long digits in comma locale", ParseStatus, str_parse_f64(&long_digits, &v), ==, PARSE_OK, "expected: %d, got: %d");
+        ASSERT("long digits value", double, v, ==, 1.2345678901234567890123, "expected: %.17g, got: %.17g");
+        setlocale(LC_NUMERIC, "C");
+    }
+}
+
+void test_string_push_numbers() {
+    printf("| --- String push numbers:\n");
+    String s = string_new();
+    string_push_u64(&s, 0);
+    string_push_char(&s, ',');
+    string_push_u64(&s, UINT64_MAX);
+    string_push_char(&s, ',');
+    string_push_i64(&s, INT64_MIN);
+    string_push_char(&s, ',');
+    string_push_i64(&s, -42);
+    ASSERT("integers", int, strcmp(string_as_cstr(&s), "0,18446744073709551615,-9223372036854775808,-42"), ==, 0, "expected: %d, got: %d");
+    string_drop(&s);
+
+    const double values[] = {0.1, -42, 1e21, 1e20, 1.5e-7, 0.000001, 123456.789, 5e-324, -0.0, 1.0 / 0.0};
+    const char* expected[] = {"0.1", "-42", "1e21", "100000000000000000000", "1.5e-7", "0.000001", "123456.789", "5e-324", "-0", "inf"};
+    for (size_t k = 0; k < 10; k++) {
+        String f = string_new();
+        string_push_f64(&f, values[k]);
+        ASSERT("--- float", int, strcmp(string_as_cstr(&f), expected[k]), ==, 0, "expected: %d, got: %d");
+        string_drop(&f);
+    }
+    const double round_trip[] = {1.7976931348623157e308, 2.2250738585072014e-308, 0.3, 2.0 / 3.0, 9007199254740993.0, 1e-300};
+    for (size_t k = 0; k < 6; k++) {
+        String f = string_new();
+        string_push_f64(&f, round_trip[k]);
+        ASSERT("--- float round trip", double, strtod(string_as_cstr(&f), NULL), ==, round_trip[k], "expected: %.17g, got: %.17g");
+        string_drop(&f);
+    }
+
+    String fmt = string_copy_from_cstr("row:");
+    string_push_fmt(&fmt, " %d %s", 7, "seven");
+    for (size_t k = 0; k < 100; k++)
+        string_push_fmt(&fmt, "%03lu", k % 10);
+    ASSERT("fmt len", size_t, string_len(&fmt), ==, 312, "expected: %lu, got: %lu");
+    ASSERT("fmt prefix", int, strncmp(string_as_cstr(&fmt), "row: 7 seven000001", 18), ==, 0, "expected: %d, got: %d");
+    ASSERT("fmt null terminated", char, string_as_cstr(&fmt)[string_len(&fmt)], ==, '\0', "expected: %d, got: %d");
+    string_drop(&fmt);
+}
+
+/* Assert that a csv row holds exactly the `expected` fields */
+void assert_csv_row(Slice* row, const char** expected, size_t len) {
+    ASSERT("--- row len", size_t, row->__len, ==, len, "expected: %lu, got: %lu");
+    for (size_t i = 0; i < len; i++) {
+        Str field = *(Str*)slice_index_ref(row, i);
+        Str exp = str_from_cstr(expected[i]);
+        ASSERT("--- field", uint8_t, str_eq(&field, &exp), ==, 0, "expected: %d, got: %d");
+    }
+}
+
+void test_csv_reader() {
+    printf("| --- CsvReader:\n");
+    Str input = str_from_cstr(
+        "id,name,note\r\n"
+        "1,plain,\"quoted, with comma\"\n"
+        "2,\"multi\nline\",\"say \"\"hi\"\"\"\n"
+        "3,,\"\"\n"
+        "4,last,\"\"\"\"");
+    CsvReader r = csv_reader_new(&input, ',');
+    const char* rows[5][3] = {
+        {"id", "name", "note"},
+        {"1", "plain", "quoted, with comma"},
+        {"2", "multi\nline", "say \"hi\""},
+        {"3", "", ""},
+        {"4", "last", "\""},
+    };
+    for (size_t k = 0; k < 5; k++) {
+        ASSERT("--- not done", uint8_t, csv_reader_done(&r), ==, 0, "expected: %d, got: %d");
+        Slice row = csv_reader_next_row(&r);
+        assert_csv_row(&row, rows[k], 3);
+    }
+    ASSERT("done", uint8_t, csv_reader_done(&r), ==, 1, "expected: %d, got: %d");
+    csv_reader_drop(&r);
+
+    /* long rows span several 64 byte blocks, with a quoted field crossing block boundaries */
+    String long_input = string_new();
+    string_push_cstr(&long_input, "a\t\"");
+    for (size_t i = 0; i < 100; i++)
+        string_push_cstr(&long_input, "x\t\"\"");
+    string_push_cstr(&long_input, "\"\tb\n\tc\n");
+    Str long_str = string_as_str(&long_input);
+    CsvReader tsv = csv_reader_new(&long_str, '\t');
+    Slice row = csv_reader_next_row(&tsv);
+    ASSERT("tsv row len", size_t, row.__len, ==, 3, "expected: %lu, got: %lu");
+    Str* quoted = slice_index_ref(&row, 1);
+    ASSERT("unescaped len", size_t, str_len(quoted), ==, 300, "expected: %lu, got: %lu");
+    ASSERT("unescaped content", int, memcmp(str_as_ptr(quoted), "x\t\"x\t\"", 6), ==, 0, "expected: %d, got: %d");
+    const char* second[] = {"", "c"};
+    row = csv_reader_next_row(&tsv);
+    assert_csv_row(&row, second, 2);
+    ASSERT("tsv done", uint8_t, csv_reader_done(&tsv), ==, 1, "expected: %d, got: %d");
+    csv_reader_drop(&tsv);
+    string_drop(&long_input);
+}
+
+void test_multi_pattern() {
+    printf("| --- MultiPattern:\n");
+    const char* words[] = {"he", "she", "his", "hers", "", "she"};
+    Vec patterns = vec_new(sizeof(Str));
+    for (size_t i = 0; i < 6; i++) {
+        Str w = str_from_cstr(words[i]);
+        vec_push(&patterns, &w);
+    }
+    MultiPattern mp = multi_pattern_new(&patterns);
+    ASSERT("len", size_t, multi_pattern_len(&mp), ==, 6, "expected: %lu, got: %lu");
+
+    Str hay = str_from_cstr("ushers and his");
+    ASSERT("is match", uint8_t, multi_pattern_is_match(&mp, &hay), ==, 1, "expected: %d, got: %d");
+    PatternMatch m;
+    ASSERT("find first", uint8_t, multi_pattern_find_first(&mp, &hay, &m), ==, 1, "expected: %d, got: %d");
+    ASSERT("first pattern is longest at earliest end", size_t, m.pattern, ==, 1, "expected: %lu, got: %lu");
+    ASSERT("first start", size_t, m.start, ==, 1, "expected: %lu, got: %lu");
+    ASSERT("first end", size_t, m.end, ==, 4, "expected: %lu, got: %lu");
+
+    Vec all = multi_pattern_find_all(&mp, &hay);
+    size_t expected[][3] = {{1, 1, 4}, {0, 2, 4}, {3, 2, 6}, {2, 11, 14}};
+    ASSERT("find all count", size_t, vec_len(&all), ==, 4, "expected: %lu, got: %lu");
+    for (size_t i = 0; i < 4; i++) {
+        PatternMatch* pm = vec_index_ref(&all, i);
+        ASSERT("--- pattern", size_t, pm->pattern, ==, expected[i][0], "expected: %lu, got: %lu");
+        ASSERT("--- start", size_t, pm->start, ==, expected[i][1], "expected: %lu, got: %lu");
+        ASSERT("--- end", size_t, pm->end, ==, expected[i][2], "expected: %lu, got: %lu");
+    }
+    vec_drop(&all);
+
+    Str miss = str_from_cstr("no match in that line ... at all, really");
+    ASSERT("no match", uint8_t, multi_pattern_find_first(&mp, &miss, &m), ==, 0, "expected: %d, got: %d");
+    ASSERT("memory usage", uint8_t, multi_pattern_memory_usage(&mp) > sizeof(MultiPattern), ==, 1, "expected: %d, got: %d");
+    multi_pattern_drop(&mp);
+    vec_drop(&patterns);
+}
+
+void test_ascii_case() {
+    printf("| --- ASCII case:\n");
+    const char* mixed = "Content-Type: Text/HTML; Charset=UTF-8 \xc3\x89t\xc3\xa9 [@`{] 0123456789 MIXED case Tail";
+    String lower = string_copy_from_cstr(mixed);
+    string_make_ascii_lowercase(&lower);
+    ASSERT("lowercase", int, strcmp(string_as_cstr(&lower),
+           "content-type: text/html; charset=utf-8 \xc3\x89t\xc3\xa9 [@`{] 0123456789 mixed case tail"), ==, 0, "expected: %d, got: %d");
+    String upper = string_copy_from_cstr(mixed);
+    string_make_ascii_uppercase(&upper);
+    ASSERT("uppercase", int, strcmp(string_as_cstr(&upper),
+           "CONTENT-TYPE: TEXT/HTML; CHARSET=UTF-8 \xc3\x89T\xc3\xa9 [@`{] 0123456789 MIXED CASE TAIL"), ==, 0, "expected: %d, got: %d");
+
+    ASSERT("strings eq ignoring case", uint8_t, string_eq_ignore_ascii_case(&lower, &upper), ==, 0, "expected: %d, got: %d");
+    ASSERT("strings hash ignoring case", uint64_t, string_hash_ignore_ascii_case(&upper), ==, string_hash(&lower), "expected: %lu, got: %lu");
+    Str a = str_from_cstr("X-Forwarded-For-Some-Long-Header");
+    Str b = str_from_cstr("x-forwarded-for-some-long-HEADER");
+    Str c = str_from_cstr("x-forwarded-for-some-long-HEADEr!");
+    Str d = str_from_cstr("x-forwarded_for-some-long-header");
+    ASSERT("eq ignoring case", uint8_t, str_eq_ignore_ascii_case(&a, &b), ==, 0, "expected: %d, got: %d");
+    ASSERT("length mismatch", uint8_t, str_eq_ignore_ascii_case(&a, &c), !=, 0, "expected: %d, got: %d");
+    ASSERT("punctuation is exact", uint8_t, str_eq_ignore_ascii_case(&a, &d), !=, 0, "expected: %d, got: %d");
+    Str at = str_from_cstr("@");
+    Str backtick = str_from_cstr("`");
+    ASSERT("non-letters don't fold", uint8_t, str_eq_ignore_ascii_case(&at, &backtick), !=, 0, "expected: %d, got: %d");
+    ASSERT("hash ignoring case", uint64_t, str_hash_ignore_ascii_case(&a), ==, str_hash_ignore_ascii_case(&b), "expected: %lu, got: %lu");
+
+    HashMap map = hashmap_new(sizeof(Str), sizeof(int), str_hash_ignore_ascii_case, str_eq_ignore_ascii_case,
+                              utils_noop, utils_noop);
+    Str key = str_from_cstr("Host");
+    int value = 1;
+    hashmap_insert(&map, &key, &value);
+    Str lookup = str_from_cstr("HOST");
+    int* found = hashmap_get_ref(&map, &lookup);
+    ASSERT("case-insensitive map lookup", int, found == NULL ? -1 : *found, ==, 1, "expected: %d, got: %d");
+    hashmap_drop(&map);
+    string_drop(&lower);
+    string_drop(&upper);
+}
+
 void string_tests() {
     printf("\nString tests:\n");
     test_new_string_mutate();
     test_string_from_cstr();
     test_string_from_file_str_trim();
+    test_map_file();
+    test_line_reader();
+    test_parallel_for_lines();
+    test_buf_writer();
+    test_read_files_batch();
     test_str_split_whitespace();
     test_str_split_lines();
     test_str_split_by_match();
     test_str_split_by_blank_match();
+    test_string_builder();
+    test_string_interner();
+    test_str_cmp();
+    test_hashed_str();
+    test_str_validate_utf8();
+    test_str_char_iter();
+    test_str_parse_ints();
+    test_str_parse_f64();
+    test_string_push_numbers();
+    test_csv_reader();
+    test_multi_pattern();
+    test_ascii_case();
 }
 
 
@@ -419,6 +1135,603 @@ void test_slices() {
     vec_drop_with(&v, string_drop);
 }
 
+typedef struct {
+    int32_t x, y;
+} Point;
+
+VEC_DEFINE(point, Point)
+
+void test_typed_vec() {
+    printf("| --- Typed vec (Vec_u64, Vec_point):\n");
+    Vec_u64 v = vec_u64_new();
+    for (uint64_t i = 0; i < 100; i++)
+        vec_u64_push(&v, i * i);
+    ASSERT("len", size_t, vec_u64_len(&v), ==, 100, "expected: %lu, got: %lu");
+    ASSERT("get", uint64_t, vec_u64_get(&v, 12), ==, 144, "expected: %lu, got: %lu");
+    vec_u64_set(&v, 12, 7);
+    ASSERT("set", uint64_t, vec_u64_data(&v)[12], ==, 7, "expected: %lu, got: %lu");
+    uint64_t sum = 0;
+    VecIter_u64 iter = vec_u64_iter(&v);
+    while (!vec_u64_iter_done(&iter))
+        sum += *vec_u64_iter_next(&iter);
+    ASSERT("iter sum", uint64_t, sum, ==, 328350 - 144 + 7, "expected: %lu, got: %lu");
+
+    /* layout compatible with the untyped `Vec` and `Slice` */
+    Vec* untyped = vec_u64_as_vec(&v);
+    ASSERT("untyped item size", size_t, untyped->__item_size, ==, sizeof(uint64_t), "expected: %lu, got: %lu");
+    ASSERT("untyped index", uint64_t, *(uint64_t*)vec_index_ref(untyped, 99), ==, 9801, "expected: %lu, got: %lu");
+    uint64_t pushed = 5;
+    vec_push(untyped, &pushed);
+    ASSERT("untyped push", uint64_t, vec_u64_get(&v, 100), ==, 5, "expected: %lu, got: %lu");
+    Slice sl = vec_u64_as_slice(&v);
+    ASSERT("slice index", uint64_t, *(uint64_t*)slice_index_ref(&sl, 3), ==, 9, "expected: %lu, got: %lu");
+    vec_u64_drop(&v);
+
+    Vec raw = vec_new(sizeof(Point));
+    Point p = { 3, 4 };
+    vec_push(&raw, &p);
+    Vec_point points = vec_point_from_vec(raw);
+    vec_point_push(&points, (Point){ -1, 2 });
+    ASSERT("struct len", size_t, vec_point_len(&points), ==, 2, "expected: %lu, got: %lu");
+    ASSERT("struct get", int32_t, vec_point_get(&points, 1).x, ==, -1, "expected: %d, got: %d");
+    ASSERT("struct ref", int32_t, vec_point_index_ref(&points, 0)->y, ==, 4, "expected: %d, got: %d");
+    vec_point_clear(&points);
+    ASSERT("cleared", size_t, vec_point_len(&points), ==, 0, "expected: %lu, got: %lu");
+    vec_point_drop(&points);
+
+    /* the typed drop works as a `mapFn` for nested `Vec`s */
+    Vec nested = vec_new(sizeof(Vec_u64));
+    for (uint64_t i = 0; i < 3; i++) {
+        Vec_u64 inner = vec_u64_new();
+        vec_u64_push(&inner, i);
+        vec_push(&nested, &inner);
+    }
+    ASSERT("nested get", uint64_t, vec_u64_get((Vec_u64*)vec_index_ref(&nested, 2), 0), ==, 2, "expected: %lu, got: %lu");
+    vec_drop_with(&nested, vec_u64_drop);
+}
+
+typedef struct {
+    int64_t key;
+    uint32_t seq;
+} SortRecord;
+
+CmpOrdering sort_record_cmp(void* a_, void* b_) {
+    SortRecord* a = (SortRecord*)a_;
+    SortRecord* b = (SortRecord*)b_;
+    if (a->key < b->key) return CMP_LESS;
+    if (a->key > b->key) return CMP_GREATER;
+    return CMP_EQUAL;
+}
+
+uint64_t sort_record_key_u64(void* rec) { return (uint64_t)((SortRecord*)rec)->key; }
+uint32_t sort_record_key_u32(void* rec) { return (uint32_t)((SortRecord*)rec)->key; }
+int64_t sort_record_key_i64(void* rec) { return ((SortRecord*)rec)->key; }
+double f64_key(void* f) { return *(double*)f; }
+
+/* Fill `v` with `n` records whose keys follow `pattern`:
+ * 0 -> random, 1 -> ascending, 2 -> descending, 3 -> all equal
+ */
+void fill_sort_records(Vec* v, size_t n, int64_t modulo, int64_t offset, int pattern) {
+    uint64_t state = 88172645463325252ULL;
+    vec_drop(v);
+    *v = vec_new(sizeof(SortRecord));
+    for (size_t i = 0; i < n; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        SortRecord rec = { .key=(int64_t)(state % (uint64_t)modulo) - offset, .seq=(uint32_t)i };
+        if (pattern == 1) rec.key = (int64_t)i;
+        if (pattern == 2) rec.key = (int64_t)(n - i);
+        if (pattern == 3) rec.key = 7;
+        vec_push(v, &rec);
+    }
+}
+
+/* Returns 2 when sorted and stable, 1 when only sorted, 0 otherwise */
+int check_sort_records(Vec* v) {
+    int stable = 1;
+    for (size_t i = 1; i < vec_len(v); i++) {
+        SortRecord* prev = (SortRecord*)vec_index_ref(v, i - 1);
+        SortRecord* cur = (SortRecord*)vec_index_ref(v, i);
+        if (prev->key > cur->key)
+            return 0;
+        if (prev->key == cur->key && prev->seq > cur->seq)
+            stable = 0;
+    }
+    return 1 + stable;
+}
+
+void test_vec_sort() {
+    printf("| --- Sorting vecs:\n");
+    Vec v = vec_new(sizeof(SortRecord));
+    size_t sizes[] = { 0, 1, 2, 23, 24, 200, 5000 };
+    int ok = 1;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int pattern = 0; pattern < 4; pattern++) {
+            fill_sort_records(&v, sizes[s], 50, 0, pattern);
+            vec_sort_by(&v, sort_record_cmp);
+            ok &= check_sort_records(&v) >= 1;
+        }
+    }
+    ASSERT("sort_by sorts patterns", int, ok, ==, 1, "expected: %d, got: %d");
+
+    fill_sort_records(&v, 5000, 1000000, 0, 0);
+    vec_sort_by(&v, sort_record_cmp);
+    ASSERT("sort_by distinct keys", int, check_sort_records(&v), >=, 1, "expected: >= %d, got: %d");
+    ASSERT("len unchanged", size_t, vec_len(&v), ==, 5000, "expected: %lu, got: %lu");
+
+    ok = 1;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int pattern = 0; pattern < 4; pattern++) {
+            fill_sort_records(&v, sizes[s], 50, 0, pattern);
+            vec_sort_stable_by(&v, sort_record_cmp);
+            ok &= check_sort_records(&v) == 2;
+        }
+    }
+    ASSERT("stable sort keeps order of equal keys", int, ok, ==, 1, "expected: %d, got: %d");
+
+    fill_sort_records(&v, 5000, 1000, 0, 0);
+    vec_radix_sort_by_u32(&v, sort_record_key_u32);
+    ASSERT("radix u32 stable", int, check_sort_records(&v), ==, 2, "expected: %d, got: %d");
+    fill_sort_records(&v, 5000, 1000000000000, 0, 0);
+    vec_radix_sort_by_u64(&v, sort_record_key_u64);
+    ASSERT("radix u64 stable", int, check_sort_records(&v), ==, 2, "expected: %d, got: %d");
+    fill_sort_records(&v, 5000, 2000000, 1000000, 0);
+    vec_radix_sort_by_i64(&v, sort_record_key_i64);
+    ASSERT("radix i64 negatives", int, check_sort_records(&v), ==, 2, "expected: %d, got: %d");
+
+    ok = 1;
+    size_t thread_counts[] = { 0, 1, 3, 8 };
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        for (int pattern = 0; pattern < 4; pattern++) {
+            fill_sort_records(&v, 100000, 1000000, 500000, pattern);
+            vec_par_sort_by(&v, sort_record_cmp, thread_counts[t]);
+            ok &= check_sort_records(&v) >= 1 && vec_len(&v) == 100000;
+        }
+    }
+    ASSERT("par_sort_by sorts on any thread count", int, ok, ==, 1, "expected: %d, got: %d");
+    vec_drop(&v);
+
+    Vec floats = vec_new(sizeof(double));
+    double values[] = { 3.5, -0.0, -1e300, 0.0, 1e-300, -2.25, INFINITY, -INFINITY, 42.0, -42.0 };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        vec_push(&floats, &values[i]);
+    vec_radix_sort_by_f64(&floats, f64_key);
+    ok = 1;
+    for (size_t i = 1; i < vec_len(&floats); i++)
+        ok &= *(double*)vec_index_ref(&floats, i - 1) <= *(double*)vec_index_ref(&floats, i);
+    ASSERT("radix f64 sorted", int, ok, ==, 1, "expected: %d, got: %d");
+    ASSERT("radix f64 -inf first", int, isinf(*(double*)vec_index_ref(&floats, 0)), !=, 0, "expected: != %d, got: %d");
+    ASSERT("radix f64 -0.0 before 0.0", int, signbit(*(double*)vec_index_ref(&floats, 4)), !=, 0, "expected: != %d, got: %d");
+    vec_drop(&floats);
+}
+
+CmpOrdering u64_cmp(void* a_, void* b_) {
+    uint64_t a = *(uint64_t*)a_;
+    uint64_t b = *(uint64_t*)b_;
+    if (a < b) return CMP_LESS;
+    if (a > b) return CMP_GREATER;
+    return CMP_EQUAL;
+}
+
+void test_vec_search() {
+    printf("| --- Searching sorted vecs (vec of uint64_t):\n");
+    Vec v = vec_new(sizeof(uint64_t));
+    uint64_t key = 5;
+    size_t index = 99;
+    ASSERT("lower bound of empty", size_t, vec_lower_bound_by(&v, &key, u64_cmp), ==, 0, "expected: %lu, got: %lu");
+    ASSERT("search empty", uint8_t, vec_binary_search_by(&v, &key, u64_cmp, &index), ==, 0, "expected: %d, got: %d");
+    ASSERT("search empty index", size_t, index, ==, 0, "expected: %lu, got: %lu");
+
+    for (uint64_t i = 0; i < 1000; i++) {
+        uint64_t val = i * 3;
+        vec_push(&v, &val);
+    }
+    key = 300;
+    ASSERT("lower bound of present", size_t, vec_lower_bound_by(&v, &key, u64_cmp), ==, 100, "expected: %lu, got: %lu");
+    key = 301;
+    ASSERT("lower bound of absent", size_t, vec_lower_bound_by(&v, &key, u64_cmp), ==, 101, "expected: %lu, got: %lu");
+    key = 5000;
+    ASSERT("lower bound past end", size_t, vec_lower_bound_by(&v, &key, u64_cmp), ==, 1000, "expected: %lu, got: %lu");
+    key = 2997;
+    ASSERT("search last", uint8_t, vec_binary_search_by(&v, &key, u64_cmp, &index), ==, 1, "expected: %d, got: %d");
+    ASSERT("search last index", size_t, index, ==, 999, "expected: %lu, got: %lu");
+    key = 1;
+    ASSERT("search absent", uint8_t, vec_binary_search_by(&v, &key, u64_cmp, &index), ==, 0, "expected: %d, got: %d");
+    ASSERT("search absent insertion point", size_t, index, ==, 1, "expected: %lu, got: %lu");
+
+    /* every tree shape, from a lone root to several incomplete levels */
+    int ok = 1;
+    for (size_t len = 0; len <= 70; len++) {
+        Slice sl = slice_from_ptr_len(sizeof(uint64_t), v.__data, len);
+        EytzingerIndex ei = eytzinger_index_new(&sl);
+        ok &= eytzinger_index_len(&ei) == len;
+        for (uint64_t k = 0; k <= 3 * len + 1; k++) {
+            uint64_t* found = eytzinger_index_lower_bound(&ei, &k, u64_cmp);
+            size_t expected = (k + 2) / 3;
+            ok &= expected >= len ? found == NULL : found != NULL && *found == expected * 3;
+            ok &= (eytzinger_index_find(&ei, &k, u64_cmp) != NULL) == (k % 3 == 0 && k / 3 < len);
+        }
+        eytzinger_index_drop(&ei);
+    }
+    ASSERT("eytzinger lower bound matches", int, ok, ==, 1, "expected: %d, got: %d");
+    vec_drop(&v);
+}
+
+size_t dropped_count = 0;
+void count_drop(void* ptr) {
+    (void)ptr;
+    dropped_count++;
+}
+
+void test_vec_bulk() {
+    printf("| --- Bulk vec operations (vec of uint64_t):\n");
+    Vec v = vec_new(sizeof(uint64_t));
+    vec_reserve(&v, 0);
+    ASSERT("reserve nothing", size_t, vec_cap(&v), ==, 0, "expected: %lu, got: %lu");
+    vec_reserve(&v, 100);
+    ASSERT("reserve", size_t, vec_cap(&v), >=, 100, "expected: >= %lu, got: %lu");
+    uint64_t nums[] = { 1, 2, 3, 4, 5 };
+    Slice sl = slice_from_ptr_len(sizeof(uint64_t), nums, 5);
+    vec_extend_from_slice(&v, &sl);
+    vec_extend_from_slice(&v, &sl);
+    ASSERT("extend len", size_t, vec_len(&v), ==, 10, "expected: %lu, got: %lu");
+    ASSERT("extend content", uint64_t, *(uint64_t*)vec_index_ref(&v, 7), ==, 3, "expected: %lu, got: %lu");
+
+    /* extending from a view of itself across a resize */
+    vec_shrink_to_fit(&v);
+    ASSERT("shrink to fit", size_t, vec_cap(&v), ==, 10, "expected: %lu, got: %lu");
+    Slice self = vec_as_slice(&v);
+    vec_extend_from_slice(&v, &self);
+    ASSERT("self extend len", size_t, vec_len(&v), ==, 20, "expected: %lu, got: %lu");
+    ASSERT("self extend content", uint64_t, *(uint64_t*)vec_index_ref(&v, 19), ==, 5, "expected: %lu, got: %lu");
+
+    vec_swap_remove(&v, 0);
+    ASSERT("swap remove len", size_t, vec_len(&v), ==, 19, "expected: %lu, got: %lu");
+    ASSERT("swap remove moves last", uint64_t, *(uint64_t*)vec_index_ref(&v, 0), ==, 5, "expected: %lu, got: %lu");
+    vec_swap_remove(&v, 18);
+    ASSERT("swap remove last", size_t, vec_len(&v), ==, 18, "expected: %lu, got: %lu");
+    dropped_count = 0;
+    vec_swap_remove_with(&v, 3, count_drop);
+    ASSERT("swap remove with drops", size_t, dropped_count, ==, 1, "expected: %lu, got: %lu");
+
+    vec_truncate(&v, 100);
+    ASSERT("truncate longer is a no-op", size_t, vec_len(&v), ==, 17, "expected: %lu, got: %lu");
+    dropped_count = 0;
+    vec_truncate_with(&v, 5, count_drop);
+    ASSERT("truncate with drops", size_t, dropped_count, ==, 12, "expected: %lu, got: %lu");
+    vec_truncate(&v, 0);
+    ASSERT("truncate", size_t, vec_len(&v), ==, 0, "expected: %lu, got: %lu");
+    vec_shrink_to_fit(&v);
+    ASSERT("shrink empty frees", size_t, vec_cap(&v), ==, 0, "expected: %lu, got: %lu");
+
+    for (uint64_t i = 0; i <= 16384; i++)
+        vec_push(&v, &i);
+    ASSERT("growth stays geometric", size_t, vec_cap(&v), ==, 24576, "expected: %lu, got: %lu");
+    vec_drop(&v);
+}
+
+void test_vec_large_buffers() {
+    printf("| --- Large buffers (vec of uint64_t, String):\n");
+    /* 48 MiB, past the size where buffers are mapped and grown with mremap */
+    const size_t n = 6 << 20;
+    Vec v = vec_new(sizeof(uint64_t));
+    for (uint64_t i = 0; i < n; i++)
+        vec_push(&v, &i);
+    int ok = 1;
+    for (uint64_t i = 0; i < n; i += 4093)
+        ok &= *(uint64_t*)vec_index_ref(&v, i) == i;
+    ASSERT("content survives growth", int, ok, ==, 1, "expected: %d, got: %d");
+    Vec copy = vec_copy(&v);
+    ASSERT("copy", uint64_t, *(uint64_t*)vec_index_ref(&copy, n - 1), ==, n - 1, "expected: %lu, got: %lu");
+    vec_drop(&copy);
+    vec_truncate(&v, 1000);
+    vec_shrink_to_fit(&v);
+    ASSERT("shrink back below", uint64_t, *(uint64_t*)vec_index_ref(&v, 999), ==, 999, "expected: %lu, got: %lu");
+    vec_drop(&v);
+
+    String s = string_new();
+    char block[4096];
+    memset(block, 'x', sizeof(block));
+    for (size_t i = 0; i < (40 << 20) / sizeof(block); i++) {
+        block[0] = (char)('a' + i % 26);
+        string_push_cstr_bound(&s, block, sizeof(block));
+    }
+    ASSERT("string len", size_t, string_len(&s), ==, 40 << 20, "expected: %lu, got: %lu");
+    ASSERT("string content", char, s.__data[4096 * 27], ==, 'b', "expected: %c, got: %c");
+    ASSERT("string terminated", char, s.__data[40 << 20], ==, '\0', "expected: %d, got: %d");
+    String s_copy = string_copy(&s);
+    ASSERT("string copy", char, s_copy.__data[4096 * 25], ==, 'z', "expected: %c, got: %c");
+    string_drop(&s_copy);
+    string_drop(&s);
+}
+
+void test_vec_deque() {
+    printf("| --- VecDeque (deque of uint64_t):\n");
+    VecDeque dq = vec_deque_new(sizeof(uint64_t));
+    uint64_t val = 0;
+    ASSERT("pop empty", uint8_t, vec_deque_pop_front(&dq, &val), ==, 0, "expected: %d, got: %d");
+    ASSERT("front of empty", int, vec_deque_front_ref(&dq) == NULL, ==, 1, "expected: %d, got: %d");
+
+    /* wrap the ring around before growing it */
+    for (uint64_t i = 0; i < 12; i++)
+        vec_deque_push_back(&dq, &i);
+    for (int i = 0; i < 10; i++)
+        vec_deque_pop_front(&dq, NULL);
+    for (uint64_t i = 12; i < 40; i++)
+        vec_deque_push_back(&dq, &i);
+    ASSERT("len", size_t, vec_deque_len(&dq), ==, 30, "expected: %lu, got: %lu");
+    ASSERT("cap power of two", size_t, vec_deque_cap(&dq), ==, 32, "expected: %lu, got: %lu");
+    int ok = 1;
+    for (size_t i = 0; i < 30; i++)
+        ok &= *(uint64_t*)vec_deque_index_ref(&dq, i) == 10 + i;
+    ASSERT("order survives growth", int, ok, ==, 1, "expected: %d, got: %d");
+
+    Slice first, second;
+    vec_deque_as_slices(&dq, &first, &second);
+    ASSERT("slices cover all", size_t, first.__len + second.__len, ==, 30, "expected: %lu, got: %lu");
+    ASSERT("first slice front", uint64_t, *(uint64_t*)slice_index_ref(&first, 0), ==, 10, "expected: %lu, got: %lu");
+    if (second.__len > 0) {
+        ASSERT("second slice continues", uint64_t, *(uint64_t*)slice_index_ref(&second, 0), ==, 10 + first.__len, "expected: %lu, got: %lu");
+    }
+
+    val = 9;
+    vec_deque_push_front(&dq, &val);
+    ASSERT("push front", uint64_t, *(uint64_t*)vec_deque_front_ref(&dq), ==, 9, "expected: %lu, got: %lu");
+    ASSERT("back", uint64_t, *(uint64_t*)vec_deque_back_ref(&dq), ==, 39, "expected: %lu, got: %lu");
+    vec_deque_pop_back(&dq, &val);
+    ASSERT("pop back", uint64_t, val, ==, 39, "expected: %lu, got: %lu");
+    vec_deque_pop_front(&dq, &val);
+    ASSERT("pop front", uint64_t, val, ==, 9, "expected: %lu, got: %lu");
+    dropped_count = 0;
+    vec_deque_clear(&dq, count_drop);
+    ASSERT("clear drops", size_t, dropped_count, ==, 29, "expected: %lu, got: %lu");
+    ASSERT("clear", size_t, vec_deque_len(&dq), ==, 0, "expected: %lu, got: %lu");
+    vec_deque_drop(&dq);
+}
+
+void test_bit_vec() {
+    printf("| --- BitVec (set bits at multiples of 3 and 5):\n");
+    BitVec bv = bit_vec_new();
+    for (size_t i = 0; i < 1000; i++)
+        bit_vec_push(&bv, i % 3 == 0);
+    ASSERT("len", size_t, bit_vec_len(&bv), ==, 1000, "expected: %lu, got: %lu");
+    ASSERT("get set", uint8_t, bit_vec_get(&bv, 999), ==, 1, "expected: %d, got: %d");
+    ASSERT("get unset", uint8_t, bit_vec_get(&bv, 998), ==, 0, "expected: %d, got: %d");
+    ASSERT("count ones", uint64_t, bit_vec_count_ones(&bv), ==, 334, "expected: %lu, got: %lu");
+
+    BitVec fives = bit_vec_zeros(1000);
+    for (size_t i = 0; i < 1000; i += 5)
+        bit_vec_set(&fives, i);
+    bit_vec_set(&fives, 1);
+    bit_vec_clear(&fives, 1);
+    ASSERT("set and clear", uint64_t, bit_vec_count_ones(&fives), ==, 200, "expected: %lu, got: %lu");
+
+    BitVec both = bit_vec_zeros(1000);
+    bit_vec_or(&both, &bv);
+    bit_vec_and(&both, &fives);
+    ASSERT("and", uint64_t, bit_vec_count_ones(&both), ==, 67, "expected: %lu, got: %lu");
+    BitVec either = bit_vec_zeros(1000);
+    bit_vec_or(&either, &bv);
+    bit_vec_or(&either, &fives);
+    ASSERT("or", uint64_t, bit_vec_count_ones(&either), ==, 467, "expected: %lu, got: %lu");
+    bit_vec_xor(&either, &both);
+    ASSERT("xor", uint64_t, bit_vec_count_ones(&either), ==, 400, "expected: %lu, got: %lu");
+    bit_vec_andnot(&either, &fives);
+    ASSERT("andnot", uint64_t, bit_vec_count_ones(&either), ==, 267, "expected: %lu, got: %lu");
+
+    int ok = 1;
+    size_t seen = 0;
+    BitVecIter iter = bit_vec_iter(&both);
+    while (!bit_vec_iter_done(&iter)) {
+        ok &= bit_vec_iter_next(&iter) == seen * 15;
+        seen++;
+    }
+    ASSERT("iter set bits", int, ok && seen == 67, ==, 1, "expected: %d, got: %d");
+
+    RankSelect rs = rank_select_new(&bv);
+    ASSERT("rank start", uint64_t, rank_select_rank(&rs, 0), ==, 0, "expected: %lu, got: %lu");
+    ASSERT("rank", uint64_t, rank_select_rank(&rs, 600), ==, 200, "expected: %lu, got: %lu");
+    ASSERT("rank end", uint64_t, rank_select_rank(&rs, 1000), ==, 334, "expected: %lu, got: %lu");
+    ASSERT("select", size_t, rank_select_select(&rs, 200), ==, 600, "expected: %lu, got: %lu");
+    ASSERT("select past end", size_t, rank_select_select(&rs, 334), ==, 1000, "expected: %lu, got: %lu");
+    rank_select_drop(&rs);
+
+    bit_vec_drop(&bv);
+    bit_vec_drop(&fives);
+    bit_vec_drop(&both);
+    bit_vec_drop(&either);
+}
+
+void test_priority_queue() {
+    printf("| --- PriorityQueue (of uint64_t):\n");
+    PriorityQueue pq = priority_queue_new(sizeof(uint64_t), u64_cmp);
+    uint64_t out = 0;
+    ASSERT("peek empty", int, priority_queue_peek(&pq) == NULL, ==, 1, "expected: %d, got: %d");
+    ASSERT("pop empty", uint8_t, priority_queue_pop(&pq, &out), ==, 0, "expected: %d, got: %d");
+    for (uint64_t i = 0; i < 1000; i++) {
+        uint64_t val = (i * 7919) % 1000;
+        priority_queue_push(&pq, &val);
+    }
+    ASSERT("len", size_t, priority_queue_len(&pq), ==, 1000, "expected: %lu, got: %lu");
+    ASSERT("peek greatest", uint64_t, *(uint64_t*)priority_queue_peek(&pq), ==, 999, "expected: %lu, got: %lu");
+    uint64_t val = 5000;
+    priority_queue_replace_top(&pq, &val, &out);
+    ASSERT("replaced top", uint64_t, out, ==, 999, "expected: %lu, got: %lu");
+    ASSERT("new top", uint64_t, *(uint64_t*)priority_queue_peek(&pq), ==, 5000, "expected: %lu, got: %lu");
+    priority_queue_pop(&pq, NULL);
+    int ok = 1;
+    uint64_t expected = 998;
+    while (priority_queue_pop(&pq, &out)) {
+        ok &= out == expected;
+        expected--;
+    }
+    ASSERT("pops in descending order", int, ok && priority_queue_len(&pq) == 0, ==, 1, "expected: %d, got: %d");
+    priority_queue_drop(&pq);
+
+    Vec v = vec_new(sizeof(uint64_t));
+    for (uint64_t i = 0; i < 1001; i++) {
+        val = (i * 7919) % 1001;
+        vec_push(&v, &val);
+    }
+    pq = priority_queue_from_vec(&v, u64_cmp, 2);
+    ASSERT("from vec consumes", size_t, vec_len(&v), ==, 0, "expected: %lu, got: %lu");
+    ok = 1;
+    expected = 1000;
+    while (priority_queue_pop(&pq, &out)) {
+        ok &= out == expected;
+        expected--;
+    }
+    ASSERT("binary heap from vec", int, ok, ==, 1, "expected: %d, got: %d");
+    priority_queue_drop(&pq);
+    vec_drop(&v);
+
+    Vec vals = vec_new(sizeof(uint64_t));
+    for (uint64_t i = 0; i < 1000; i++) {
+        val = (i * 7919) % 1000;
+        vec_push(&vals, &val);
+    }
+    Slice sl = vec_as_slice(&vals);
+    Vec top = slice_top_k(&sl, 10, u64_cmp);
+    ok = vec_len(&top) == 10;
+    for (size_t i = 0; i < vec_len(&top); i++)
+        ok &= *(uint64_t*)vec_index_ref(&top, i) == 999 - i;
+    ASSERT("top k descending", int, ok, ==, 1, "expected: %d, got: %d");
+    vec_drop(&top);
+    top = slice_top_k(&sl, 5000, u64_cmp);
+    ASSERT("top k past len", size_t, vec_len(&top), ==, 1000, "expected: %lu, got: %lu");
+    ASSERT("top k least last", uint64_t, *(uint64_t*)vec_index_ref(&top, 999), ==, 0, "expected: %lu, got: %lu");
+    vec_drop(&top);
+    vec_drop(&vals);
+}
+
+typedef struct {
+    uint64_t id;
+    double price;
+    uint32_t qty;
+    uint8_t flag;
+} SoaRow; /* no padding between fields, only after the last one */
+
+void test_soa_vec() {
+    printf("| --- SoaVec (columns uint64_t, double, uint32_t, uint8_t):\n");
+    size_t sizes[] = { sizeof(uint64_t), sizeof(double), sizeof(uint32_t), sizeof(uint8_t) };
+    SoaVec sv = soa_vec_new(sizes, 4);
+    ASSERT("num columns", size_t, soa_vec_num_columns(&sv), ==, 4, "expected: %lu, got: %lu");
+    ASSERT("row size", size_t, soa_vec_row_size(&sv), ==, 21, "expected: %lu, got: %lu");
+    for (uint64_t i = 0; i < 1000; i++) {
+        SoaRow row = { .id=i, .price=(double)i / 2, .qty=(uint32_t)(i * 3), .flag=(uint8_t)(i % 2) };
+        soa_vec_push_row(&sv, &row);
+    }
+    ASSERT("len", size_t, soa_vec_len(&sv), ==, 1000, "expected: %lu, got: %lu");
+
+    int aligned = 1;
+    for (size_t col = 0; col < 4; col++) {
+        Slice column = soa_vec_column(&sv, col);
+        aligned &= ((uintptr_t)column.__data % 64 == 0) && column.__len == 1000;
+    }
+    ASSERT("columns aligned", int, aligned, ==, 1, "expected: %d, got: %d");
+
+    Slice qtys = soa_vec_column(&sv, 2);
+    uint64_t qty_sum = 0;
+    for (size_t i = 0; i < qtys.__len; i++)
+        qty_sum += ((const uint32_t*)qtys.__data)[i];
+    ASSERT("column scan", uint64_t, qty_sum, ==, 1498500, "expected: %lu, got: %lu");
+
+    *(double*)soa_vec_column_ref(&sv, 1, 10) = 42.5;
+    SoaRow row;
+    soa_vec_get_row(&sv, 10, &row);
+    ASSERT("row id", uint64_t, row.id, ==, 10, "expected: %lu, got: %lu");
+    ASSERT("row price", double, row.price, ==, 42.5, "expected: %f, got: %f");
+    ASSERT("row qty", uint32_t, row.qty, ==, 30, "expected: %u, got: %u");
+    ASSERT("row flag", uint8_t, row.flag, ==, 0, "expected: %d, got: %d");
+
+    soa_vec_clear(&sv);
+    ASSERT("cleared", size_t, soa_vec_len(&sv), ==, 0, "expected: %lu, got: %lu");
+    soa_vec_drop(&sv);
+}
+
+/* Sorted uint32_t multiples of `step` below `end` */
+Vec sorted_multiples(uint32_t step, uint32_t end) {
+    Vec v = vec_new(sizeof(uint32_t));
+    for (uint32_t x = 0; x < end; x += step)
+        vec_push(&v, &x);
+    return v;
+}
+
+uint8_t check_multiples(Vec* v, uint32_t step, size_t expected_len) {
+    uint8_t ok = vec_len(v) == expected_len;
+    for (size_t i = 0; ok && i < vec_len(v); i++)
+        ok &= *(uint32_t*)vec_index_ref(v, i) == (uint32_t)(i * step);
+    return ok;
+}
+
+void test_sorted_sets() {
+    printf("| --- Sorted set operations (multiples of 2, 3 and 1000 below 30000):\n");
+    Vec twos = sorted_multiples(2, 30000);
+    Vec threes = sorted_multiples(3, 30000);
+    Vec thousands = sorted_multiples(1000, 30000);
+    Slice s2 = vec_as_slice(&twos);
+    Slice s3 = vec_as_slice(&threes);
+    Slice s1000 = vec_as_slice(&thousands);
+
+    Vec out = vec_new(sizeof(uint32_t));
+    slice_sorted_intersect_u32(&s2, &s3, &out);
+    ASSERT("intersect", uint8_t, check_multiples(&out, 6, 5000), ==, 1, "expected: %d, got: %d");
+    vec_truncate(&out, 0);
+    slice_sorted_intersect_u32(&s3, &s1000, &out);
+    ASSERT("intersect skewed", uint8_t, check_multiples(&out, 3000, 10), ==, 1, "expected: %d, got: %d");
+    vec_truncate(&out, 0);
+    slice_sorted_intersect_gallop_u32(&s1000, &s2, &out);
+    ASSERT("intersect gallop", uint8_t, check_multiples(&out, 1000, 30), ==, 1, "expected: %d, got: %d");
+
+    vec_truncate(&out, 0);
+    slice_sorted_union_u32(&s2, &s3, &out);
+    uint8_t ok = vec_len(&out) == 20000;
+    uint32_t prev = 0;
+    for (size_t i = 0; ok && i < vec_len(&out); i++) {
+        uint32_t x = *(uint32_t*)vec_index_ref(&out, i);
+        ok &= (x % 2 == 0 || x % 3 == 0) && (i == 0 || x > prev);
+        prev = x;
+    }
+    ASSERT("union", uint8_t, ok, ==, 1, "expected: %d, got: %d");
+
+    vec_truncate(&out, 0);
+    slice_sorted_difference_u32(&s2, &s3, &out);
+    ok = vec_len(&out) == 10000;
+    for (size_t i = 0; ok && i < vec_len(&out); i++)
+        ok &= *(uint32_t*)vec_index_ref(&out, i) % 3 != 0;
+    ASSERT("difference", uint8_t, ok, ==, 1, "expected: %d, got: %d");
+    vec_drop(&out);
+
+    Vec a64 = vec_new(sizeof(uint64_t));
+    Vec b64 = vec_new(sizeof(uint64_t));
+    for (uint64_t x = 0; x < 1000; x++) {
+        uint64_t big = x << 40;
+        vec_push(&a64, &big);
+        big += (x % 4 == 0) ? 0 : 1;
+        vec_push(&b64, &big);
+    }
+    Slice sa64 = vec_as_slice(&a64);
+    Slice sb64 = vec_as_slice(&b64);
+    Vec out64 = vec_new(sizeof(uint64_t));
+    slice_sorted_intersect_u64(&sa64, &sb64, &out64);
+    ASSERT("intersect u64", size_t, vec_len(&out64), ==, 250, "expected: %lu, got: %lu");
+    ASSERT("intersect u64 last", uint64_t, *(uint64_t*)vec_index_ref(&out64, 249), ==, (uint64_t)996 << 40, "expected: %lu, got: %lu");
+    vec_truncate(&out64, 0);
+    slice_sorted_union_u64(&sa64, &sb64, &out64);
+    ASSERT("union u64", size_t, vec_len(&out64), ==, 1750, "expected: %lu, got: %lu");
+    vec_truncate(&out64, 0);
+    slice_sorted_difference_u64(&sa64, &sb64, &out64);
+    ASSERT("difference u64", size_t, vec_len(&out64), ==, 750, "expected: %lu, got: %lu");
+    vec_drop(&out64);
+    vec_drop(&a64);
+    vec_drop(&b64);
+
+    vec_drop(&twos);
+    vec_drop(&threes);
+    vec_drop(&thousands);
+}
+
 void vec_tests() {
     printf("\nVec tests:\n");
     test_new_vec_mutate();
@@ -430,6 +1743,16 @@ void vec_tests() {
     test_vec_remove();
     test_vec_copy();
     test_slices();
+    test_typed_vec();
+    test_vec_sort();
+    test_vec_search();
+    test_vec_bulk();
+    test_vec_large_buffers();
+    test_vec_deque();
+    test_bit_vec();
+    test_priority_queue();
+    test_soa_vec();
+    test_sorted_sets();
 }
 
 
@@ -1,24 +1,162 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "utils.h"
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTILS_X86
+#include <immintrin.h>
+/* Compile a function for a specific instruction set extension.
+ * Such functions must only be called after checking `__builtin_cpu_supports`.
+ */
+#define UTILS_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__linux__) && defined(__GNUC__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+/* Batched file reads can go through io_uring, using raw syscalls */
+#define UTILS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+/* Large `Vec` and `String` buffers are mapped directly, and grown with mremap */
+#define UTILS_MREMAP
+#endif
+
+/* Size in bytes from which `Vec` and `String` buffers are mapped rather than malloc'd.
+ * Buffers are always allocated as `Vec->__cap * Vec->__item_size` or `String->__cap + 1`
+ * bytes, so the size alone tells which allocator a buffer came from.
+ */
+#ifndef UTILS_BUF_MMAP_THRESHOLD
+#define UTILS_BUF_MMAP_THRESHOLD ((size_t)32 << 20)
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Multiple ascii digits can be processed at once with plain 64bit arithmetic */
+#define UTILS_SWAR_DIGITS
+#endif
+
 
 /* ----------- Misc ------------- */
 
 /* Increase capacity by a factor of 2, unless it's already really big,
- * then increase by a constant value
+ * then by a factor of 1.5. Growth stays geometric so building large
+ * containers element by element costs amortized O(1) copies per element.
  */
 size_t __inc_cap(size_t current) {
     if (current > 8192) {
-        return current + 8192;
+        return current + current / 2;
     } else {
         return current * 2;
     }
 }
 
+/* Mapped buffers are sized in whole huge pages, so all of a buffer can be backed by them */
+#define __BUF_HUGE_PAGE ((size_t)2 << 20)
+
+size_t __buf_map_len(size_t bytes) {
+    return (bytes + __BUF_HUGE_PAGE - 1) & ~(__BUF_HUGE_PAGE - 1);
+}
+
+uint8_t __buf_is_mapped(size_t bytes) {
+#ifdef UTILS_MREMAP
+    return bytes >= UTILS_BUF_MMAP_THRESHOLD;
+#else
+    (void)bytes;
+    return 0;
+#endif
+}
+
+/* Allocate the buffer of a `Vec` or `String`: malloc for small buffers, and an
+ * anonymous mapping advised to use transparent huge pages for large ones.
+ * Returns NULL on failure.
+ */
+void* __buf_alloc(size_t bytes) {
+#ifdef UTILS_MREMAP
+    if (__buf_is_mapped(bytes)) {
+        size_t len = __buf_map_len(bytes);
+        void* data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        madvise(data, len, MADV_HUGEPAGE);
+#endif
+        return data;
+    }
+#endif
+    return malloc(bytes);
+}
+
+/* Free a buffer from `__buf_alloc` or `__buf_realloc` of `bytes` bytes */
+void __buf_free(void* data, size_t bytes) {
+    if (data == NULL)
+        return;
+#ifdef UTILS_MREMAP
+    if (__buf_is_mapped(bytes)) {
+        munmap(data, __buf_map_len(bytes));
+        return;
+    }
+#endif
+    free(data);
+}
+
+/* Resize a buffer from `__buf_alloc` of `old_bytes` bytes, or NULL, to `new_bytes`.
+ * Mapped buffers grow with mremap, which moves pages instead of copying them.
+ * Returns NULL on failure, leaving the original buffer untouched.
+ */
+void* __buf_realloc(void* data, size_t old_bytes, size_t new_bytes) {
+    uint8_t was_mapped = data != NULL && __buf_is_mapped(old_bytes);
+    uint8_t is_mapped = __buf_is_mapped(new_bytes);
+    if (!was_mapped && !is_mapped)
+        return realloc(data, new_bytes);
+#ifdef UTILS_MREMAP
+    if (was_mapped && is_mapped) {
+        size_t old_len = __buf_map_len(old_bytes);
+        size_t new_len = __buf_map_len(new_bytes);
+        if (old_len == new_len)
+            return data;
+        void* moved = mremap(data, old_len, new_len, MREMAP_MAYMOVE);
+        if (moved == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        madvise(moved, new_len, MADV_HUGEPAGE);
+#endif
+        return moved;
+    }
+#endif
+    /* crossing the threshold, switch allocators */
+    void* moved = __buf_alloc(new_bytes);
+    if (moved == NULL)
+        return NULL;
+    if (data != NULL)
+        memcpy(moved, data, old_bytes < new_bytes ? old_bytes : new_bytes);
+    __buf_free(data, old_bytes);
+    return moved;
+}
+
 uint64_t fnv_64(void* ptr, size_t num_bytes) {
     size_t FNV_PRIME = 1099511628211U;
     size_t FNV_OFFSET = 14695981039346656037U;
@@ -32,6 +170,557 @@ uint64_t fnv_64(void* ptr, size_t num_bytes) {
 
 void utils_noop() { return; }
 
+size_t utils_num_cpus() {
+#ifdef CPU_COUNT
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0)
+        return (size_t)CPU_COUNT(&set);
+#endif
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+}
+
+/* Write every buffer described by `iov` to `fd`, retrying partial writes
+ * and interrupts. The `iov` entries are advanced in place as data is written.
+ * When `syscalls` is non-NULL it's incremented for every `writev` made.
+ */
+int __write_all_iov(int fd, struct iovec* iov, int iovcnt, size_t* syscalls) {
+    while (iovcnt > 0) {
+        if (syscalls != NULL)
+            (*syscalls)++;
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        size_t n = (size_t)written;
+        while (iovcnt > 0 && n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+
+/* Return the low 64 bits of the 128bit product of `a` and `b`, writing the high bits to `hi` */
+uint64_t __umul128(uint64_t a, uint64_t b, uint64_t* hi) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 u128;
+    u128 product = (u128)a * b;
+    *hi = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, lo_hi = a_lo * b_hi, hi_lo = a_hi * b_lo, hi_hi = a_hi * b_hi;
+    uint64_t mid = (lo_lo >> 32) + (uint32_t)lo_hi + (uint32_t)hi_lo;
+    *hi = hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + (mid >> 32);
+    return (mid << 32) | (uint32_t)lo_lo;
+#endif
+}
+
+/* Count the leading zero bits of a non-zero value */
+int __clz64(uint64_t v) {
+#ifdef __GNUC__
+    return __builtin_clzll(v);
+#else
+    int n = 0;
+    while (!(v & ((uint64_t)1 << 63))) {
+        v <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Count the trailing zero bits of a non-zero value */
+int __ctz64(uint64_t v) {
+#ifdef __GNUC__
+    return __builtin_ctzll(v);
+#else
+    int n = 0;
+    while (!(v & 1)) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Count the one bits of a value */
+int __popcount64(uint64_t v) {
+#ifdef __GNUC__
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* Fixed size unsigned big integer, only used to generate power of five tables.
+ * Limbs are stored least significant first, `len` counts the limbs in use.
+ */
+#define __BIGNUM_LIMBS 64
+typedef struct {
+    uint32_t limbs[__BIGNUM_LIMBS];
+    size_t len;
+} __Bignum;
+
+void __bignum_set(__Bignum* b, uint32_t v) {
+    memset(b->limbs, 0, sizeof(b->limbs));
+    b->limbs[0] = v;
+    b->len = v != 0;
+}
+
+void __bignum_mul_small(__Bignum* b, uint32_t m) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < b->len; i++) {
+        uint64_t product = (uint64_t)b->limbs[i] * m + carry;
+        b->limbs[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+    if (carry)
+        b->limbs[b->len++] = (uint32_t)carry;
+}
+
+void __bignum_add_small(__Bignum* b, uint32_t v) {
+    uint64_t carry = v;
+    for (size_t i = 0; carry && i < __BIGNUM_LIMBS; i++) {
+        uint64_t sum = (uint64_t)b->limbs[i] + carry;
+        b->limbs[i] = (uint32_t)sum;
+        carry = sum >> 32;
+        if (i >= b->len)
+            b->len = i + 1;
+    }
+}
+
+/* Shift left by one bit, shifting `low_bit` in */
+void __bignum_shl1(__Bignum* b, uint32_t low_bit) {
+    uint32_t carry = low_bit;
+    for (size_t i = 0; i < b->len; i++) {
+        uint32_t next = b->limbs[i] >> 31;
+        b->limbs[i] = (b->limbs[i] << 1) | carry;
+        carry = next;
+    }
+    if (carry)
+        b->limbs[b->len++] = carry;
+}
+
+size_t __bignum_bitlen(__Bignum* b) {
+    if (b->len == 0)
+        return 0;
+    uint32_t top = b->limbs[b->len - 1];
+    size_t bits = 0;
+    while (top) {
+        top >>= 1;
+        bits++;
+    }
+    return (b->len - 1) * 32 + bits;
+}
+
+uint32_t __bignum_bit(__Bignum* b, size_t i) {
+    return (b->limbs[i / 32] >> (i % 32)) & 1;
+}
+
+int __bignum_cmp(__Bignum* a, __Bignum* b) {
+    if (a->len != b->len)
+        return a->len < b->len ? -1 : 1;
+    for (size_t i = a->len; i-- > 0;) {
+        if (a->limbs[i] != b->limbs[i])
+            return a->limbs[i] < b->limbs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/* a -= b, requires a >= b */
+void __bignum_sub(__Bignum* a, __Bignum* b) {
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a->len; i++) {
+        int64_t diff = (int64_t)a->limbs[i] - (i < b->len ? b->limbs[i] : 0) - borrow;
+        borrow = diff < 0;
+        a->limbs[i] = (uint32_t)(diff + (borrow << 32));
+    }
+    while (a->len > 0 && a->limbs[a->len - 1] == 0)
+        a->len--;
+}
+
+/* quot = floor(2^exp / d), by binary long division */
+void __bignum_pow2_div(size_t exp, __Bignum* d, __Bignum* quot) {
+    __Bignum rem;
+    __bignum_set(&rem, 0);
+    __bignum_set(quot, 0);
+    for (size_t i = exp + 1; i-- > 0;) {
+        __bignum_shl1(&rem, i == exp);
+        if (__bignum_cmp(&rem, d) >= 0) {
+            __bignum_sub(&rem, d);
+            quot->limbs[i / 32] |= (uint32_t)1 << (i % 32);
+            if (i / 32 + 1 > quot->len)
+                quot->len = i / 32 + 1;
+        }
+    }
+}
+
+/* Return the (truncated) bits [start, start + 64) of a bignum */
+uint64_t __bignum_bits64(__Bignum* b, size_t start) {
+    uint64_t v = 0;
+    for (size_t i = 64; i-- > 0;) {
+        size_t bit = start + i;
+        v = (v << 1) | (bit < b->len * 32 ? __bignum_bit(b, bit) : 0);
+    }
+    return v;
+}
+
+/* Return the `num_bits` most significant bits of a bignum (truncating),
+ * shifting left first when it has fewer bits. `num_bits` must be at most 128.
+ */
+void __bignum_top_bits(__Bignum* b, size_t num_bits, uint64_t* hi, uint64_t* lo) {
+    size_t len = __bignum_bitlen(b);
+    for (; len < num_bits; len++)
+        __bignum_shl1(b, 0);
+    size_t start = len - num_bits;
+    *lo = __bignum_bits64(b, start);
+    *hi = num_bits > 64 ? __bignum_bits64(b, start + 64) & (UINT64_MAX >> (128 - num_bits)) : 0;
+    if (num_bits <= 64)
+        *lo &= UINT64_MAX >> (64 - num_bits);
+}
+
+
+/* ----------- Number formatting ------------- */
+
+
+/* Pairs of ascii digits for 00 through 99 */
+const char __DIGIT_PAIRS[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Number of base 10 digits in `v` */
+size_t __decimal_len(uint64_t v) {
+    size_t len = 1;
+    for (;;) {
+        if (v < 10) return len;
+        if (v < 100) return len + 1;
+        if (v < 1000) return len + 2;
+        if (v < 10000) return len + 3;
+        v /= 10000;
+        len += 4;
+    }
+}
+
+/* Write the digits of `v` as exactly `len` characters ending at `buf + len`, two at a time */
+void __write_digits(char* buf, uint64_t v, size_t len) {
+    char* end = buf + len;
+    while (v >= 100) {
+        size_t pair = (size_t)(v % 100) * 2;
+        v /= 100;
+        end -= 2;
+        memcpy(end, __DIGIT_PAIRS + pair, 2);
+    }
+    if (v >= 10) {
+        end -= 2;
+        memcpy(end, __DIGIT_PAIRS + v * 2, 2);
+    } else {
+        *--end = (char)('0' + v);
+    }
+}
+
+/* Write the base 10 representation of `v` to `buf` (at least 20 bytes), returning its length */
+size_t __fmt_u64(char* buf, uint64_t v) {
+    size_t len = __decimal_len(v);
+    __write_digits(buf, v, len);
+    return len;
+}
+
+/* Write the base 10 representation of `v` to `buf` (at least 20 bytes), returning its length */
+size_t __fmt_i64(char* buf, int64_t v) {
+    if (v < 0) {
+        *buf = '-';
+        return 1 + __fmt_u64(buf + 1, (uint64_t)0 - (uint64_t)v);
+    }
+    return __fmt_u64(buf, (uint64_t)v);
+}
+
+/* Ryu (Ulf Adams, "Ryu: Fast Float-to-String Conversion") multiplies the binary
+ * mantissa by 125bit approximations of 5^i and 2^k / 5^i. Both tables are
+ * generated on first use (low word first), rather than shipped as literals.
+ */
+#define __RYU_POW5_INV_BITCOUNT 125
+#define __RYU_POW5_BITCOUNT 125
+#define __RYU_POW5_INV_TABLE_SIZE 342
+#define __RYU_POW5_TABLE_SIZE 326
+uint64_t __ryu_pow5_inv_split[__RYU_POW5_INV_TABLE_SIZE][2];
+uint64_t __ryu_pow5_split[__RYU_POW5_TABLE_SIZE][2];
+pthread_once_t __ryu_tables_once = PTHREAD_ONCE_INIT;
+
+void __ryu_tables_init() {
+    __Bignum pow5, tmp;
+    __bignum_set(&pow5, 1);
+    for (size_t i = 0; i < __RYU_POW5_INV_TABLE_SIZE; i++) {
+        size_t pow5_len = __bignum_bitlen(&pow5);
+        if (i < __RYU_POW5_TABLE_SIZE) {
+            tmp = pow5;
+            __bignum_top_bits(&tmp, __RYU_POW5_BITCOUNT, &__ryu_pow5_split[i][1], &__ryu_pow5_split[i][0]);
+        }
+        __bignum_pow2_div(pow5_len - 1 + __RYU_POW5_INV_BITCOUNT, &pow5, &tmp);
+        __bignum_add_small(&tmp, 1);
+        /* at most 126 bits (2^125 + 1 for i = 0), so no normalization */
+        __ryu_pow5_inv_split[i][0] = __bignum_bits64(&tmp, 0);
+        __ryu_pow5_inv_split[i][1] = __bignum_bits64(&tmp, 64);
+        __bignum_mul_small(&pow5, 5);
+    }
+}
+
+/* ceil(log2(5^e)), or 1 for e = 0 */
+int32_t __pow5_bits(int32_t e) {
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+/* floor(log10(2^e)) */
+uint32_t __log10_pow2(int32_t e) {
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+/* floor(log10(5^e)) */
+uint32_t __log10_pow5(int32_t e) {
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+uint8_t __multiple_of_pow5(uint64_t v, uint32_t p) {
+    uint32_t count = 0;
+    while (v % 5 == 0) {
+        v /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+uint8_t __multiple_of_pow2(uint64_t v, uint32_t p) {
+    return (v & (((uint64_t)1 << p) - 1)) == 0;
+}
+
+/* (m * mul) >> j, where mul is a 128bit value and 64 < j < 128 */
+uint64_t __mul_shift64(uint64_t m, const uint64_t* mul, int32_t j) {
+    uint64_t high1;
+    uint64_t low1 = __umul128(m, mul[1], &high1);
+    uint64_t high0;
+    __umul128(m, mul[0], &high0);
+    uint64_t sum = high0 + low1;
+    if (sum < high0)
+        high1++;
+    int32_t dist = j - 64;
+    return (high1 << (64 - dist)) | (sum >> dist);
+}
+
+/* Shortest decimal `digits * 10^exp` that rounds to the double with the given
+ * mantissa and biased exponent bits. A direct port of Ryu's `d2d`.
+ */
+void __ryu_d2d(uint64_t ieee_mantissa, uint32_t ieee_exponent, uint64_t* digits, int32_t* exp) {
+    const int32_t BIAS = 1023;
+    const int32_t MANTISSA_BITS = 52;
+    int32_t e2;
+    uint64_t m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - BIAS - MANTISSA_BITS - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (int32_t)ieee_exponent - BIAS - MANTISSA_BITS - 2;
+        m2 = ((uint64_t)1 << MANTISSA_BITS) | ieee_mantissa;
+    }
+    const uint8_t accept_bounds = (m2 & 1) == 0;
+
+    /* step 2: the interval of valid decimal representations, scaled by 4 */
+    const uint64_t mv = 4 * m2;
+    const uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    /* step 3: convert to a decimal power base */
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    uint8_t vm_trailing_zeros = 0;
+    uint8_t vr_trailing_zeros = 0;
+    if (e2 >= 0) {
+        const uint32_t q = __log10_pow2(e2) - (e2 > 3);
+        e10 = (int32_t)q;
+        const int32_t k = __RYU_POW5_INV_BITCOUNT + __pow5_bits((int32_t)q) - 1;
+        const int32_t i = -e2 + (int32_t)q + k;
+        const uint64_t* mul = __ryu_pow5_inv_split[q];
+        vr = __mul_shift64(4 * m2, mul, i);
+        vp = __mul_shift64(4 * m2 + 2, mul, i);
+        vm = __mul_shift64(4 * m2 - 1 - mm_shift, mul, i);
+        if (q <= 21) {
+            /* only one of mp, mv, and mm can be a multiple of 5, if any */
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = __multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = __multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= __multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        const uint32_t q = __log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int32_t)q + e2;
+        const int32_t i = -e2 - (int32_t)q;
+        const int32_t k = __pow5_bits(i) - __RYU_POW5_BITCOUNT;
+        const int32_t j = (int32_t)q - k;
+        const uint64_t* mul = __ryu_pow5_split[i];
+        vr = __mul_shift64(4 * m2, mul, j);
+        vp = __mul_shift64(4 * m2 + 2, mul, j);
+        vm = __mul_shift64(4 * m2 - 1 - mm_shift, mul, j);
+        if (q <= 1) {
+            /* mv = 4 * m2 always has at least two trailing 0 bits */
+            vr_trailing_zeros = 1;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vr_trailing_zeros = __multiple_of_pow2(mv, q);
+        }
+    }
+
+    /* step 4: find the shortest decimal representation in the interval */
+    int32_t removed = 0;
+    uint8_t last_removed_digit = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        /* rare general case */
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = (uint8_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = (uint8_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+            /* round even if the exact number is .....50..0 */
+            last_removed_digit = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed_digit >= 5);
+    } else {
+        /* common case, removing two digits at a time first */
+        uint8_t round_up = 0;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *digits = output;
+    *exp = e10 + removed;
+}
+
+/* Longest output of `__fmt_f64`, e.g. `-0.0000022250738585072014` */
+#define __FMT_F64_MAX_LEN 32
+
+/* Write the shortest round-trip representation of `v` to `buf` (at least
+ * `__FMT_F64_MAX_LEN` bytes), returning its length.
+ */
+size_t __fmt_f64(char* buf, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint8_t negative = bits >> 63;
+    uint64_t ieee_mantissa = bits & (((uint64_t)1 << 52) - 1);
+    uint32_t ieee_exponent = (uint32_t)((bits >> 52) & 0x7FF);
+    size_t n = 0;
+    if (ieee_exponent == 0x7FF && ieee_mantissa != 0) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    if (negative)
+        buf[n++] = '-';
+    if (ieee_exponent == 0x7FF) {
+        memcpy(buf + n, "inf", 3);
+        return n + 3;
+    }
+    if (ieee_exponent == 0 && ieee_mantissa == 0) {
+        buf[n++] = '0';
+        return n;
+    }
+
+    uint64_t digits;
+    int32_t exp;
+    int32_t e2 = (int32_t)ieee_exponent - 1023 - 52;
+    uint64_t m2 = ((uint64_t)1 << 52) | ieee_mantissa;
+    if (ieee_exponent != 0 && e2 <= 0 && e2 >= -52 && (m2 & (((uint64_t)1 << -e2) - 1)) == 0) {
+        /* small integers are exact, just drop trailing zeros */
+        digits = m2 >> -e2;
+        exp = 0;
+        while (digits % 10 == 0) {
+            digits /= 10;
+            exp++;
+        }
+    } else {
+        pthread_once(&__ryu_tables_once, __ryu_tables_init);
+        __ryu_d2d(ieee_mantissa, ieee_exponent, &digits, &exp);
+    }
+
+    /* digits * 10^exp, with the decimal point `point` digits from the start */
+    int32_t num_digits = (int32_t)__decimal_len(digits);
+    int32_t point = num_digits + exp;
+    if (exp >= 0 && point <= 21) {
+        __write_digits(buf + n, digits, num_digits);
+        n += num_digits;
+        memset(buf + n, '0', exp);
+        n += exp;
+    } else if (point > 0 && point <= 21) {
+        __write_digits(buf + n, digits, num_digits);
+        memmove(buf + n + point + 1, buf + n + point, num_digits - point);
+        buf[n + point] = '.';
+        n += num_digits + 1;
+    } else if (point > -6 && point <= 0) {
+        buf[n++] = '0';
+        buf[n++] = '.';
+        memset(buf + n, '0', -point);
+        n += -point;
+        __write_digits(buf + n, digits, num_digits);
+        n += num_digits;
+    } else {
+        __write_digits(buf + n + 1, digits, num_digits);
+        buf[n] = buf[n + 1];
+        if (num_digits > 1) {
+            buf[n + 1] = '.';
+            n += num_digits + 1;
+        } else {
+            n += 1;
+        }
+        buf[n++] = 'e';
+        n += __fmt_i64(buf + n, point - 1);
+    }
+    return n;
+}
+
 
 /* ----------- String ------------- */
 
@@ -42,7 +731,7 @@ String string_new() {
 }
 
 String string_with_capactiy(size_t cap) {
-    char* data = malloc((cap + 1) * sizeof(char));
+    char* data = __buf_alloc((cap + 1) * sizeof(char));
     if (data == NULL) {
         fprintf(stderr, "String alloc failure\n");
         abort();
@@ -63,13 +752,13 @@ String string_copy_from_str(Str* str) {
 
 String string_copy_from_cstr(const char* cstr) {
     size_t len = strlen(cstr);
-    char* data = malloc((len + 1) * sizeof(char));
+    char* data = __buf_alloc((len + 1) * sizeof(char));
     if (data == NULL) {
         fprintf(stderr, "String alloc failure\n");
         abort();
     }
     memset(data, '\0', len + 1);
-    strncpy(data, cstr, len);
+    memcpy(data, cstr, len);
     String s = { .__data=data, .__len=len, .__cap=len };
     return s;
 }
@@ -86,7 +775,7 @@ void string_resize(String* s, size_t new_cap) {
     if (new_cap == 0)
         new_cap = 16;
 
-    char* data = realloc(s->__data, (new_cap + 1) * sizeof(char));
+    char* data = __buf_realloc(s->__data, (s->__cap + 1) * sizeof(char), (new_cap + 1) * sizeof(char));
     if (data == NULL) {
         fprintf(stderr, "String resize failure\n");
         abort();
@@ -115,22 +804,68 @@ void string_push_cstr(String* s, const char* cstr) {
     string_push_cstr_bound(s, cstr, len);
 }
 
-void string_push_cstr_bound(String* s, const char* cstr, size_t str_len) {
+/* Ensure there's room for at least `additional` more bytes, resizing if necessary */
+void __string_reserve(String* s, size_t additional) {
     size_t avail = s->__cap - s->__len;
-    if (str_len > avail) {
+    if (additional > avail || s->__data == NULL) {
         size_t new_cap = __inc_cap(s->__cap);
-        if (str_len > (new_cap - s->__len)) {
-            new_cap += str_len - (new_cap - s->__len);
+        if (additional > (new_cap - s->__len)) {
+            new_cap += additional - (new_cap - s->__len);
         }
         string_resize(s, new_cap);
     }
-    size_t count = 0;
-    while (*cstr && count < str_len) {
-        s->__data[s->__len] = *cstr;
-        s->__len++;
-        count++;
-        cstr++;
+}
+
+void string_push_cstr_bound(String* s, const char* cstr, size_t str_len) {
+    /* stop at a null byte within the bound, as a buffer size is a valid bound */
+    const char* nul = str_len > 0 ? memchr(cstr, '\0', str_len) : NULL;
+    if (nul != NULL)
+        str_len = (size_t)(nul - cstr);
+    __string_reserve(s, str_len);
+    if (str_len > 0)
+        memcpy(s->__data + s->__len, cstr, str_len);
+    s->__len += str_len;
+    s->__data[s->__len] = '\0';
+}
+
+void string_push_u64(String* s, uint64_t v) {
+    __string_reserve(s, 20);
+    s->__len += __fmt_u64(s->__data + s->__len, v);
+    s->__data[s->__len] = '\0';
+}
+
+void string_push_i64(String* s, int64_t v) {
+    __string_reserve(s, 20);
+    s->__len += __fmt_i64(s->__data + s->__len, v);
+    s->__data[s->__len] = '\0';
+}
+
+void string_push_f64(String* s, double v) {
+    __string_reserve(s, __FMT_F64_MAX_LEN);
+    s->__len += __fmt_f64(s->__data + s->__len, v);
+    s->__data[s->__len] = '\0';
+}
+
+void string_push_fmt(String* s, const char* fmt, ...) {
+    va_list args, retry_args;
+    va_start(args, fmt);
+    va_copy(retry_args, args);
+    if (s->__data == NULL)
+        string_resize(s, 0);
+    /* the buffer always has room for a trailing null byte past the capacity */
+    size_t avail = s->__cap - s->__len;
+    int written = vsnprintf(s->__data + s->__len, avail + 1, fmt, args);
+    if (written < 0) {
+        fprintf(stderr, "String format failure\n");
+        abort();
+    }
+    if ((size_t)written > avail) {
+        __string_reserve(s, written);
+        vsnprintf(s->__data + s->__len, written + 1, fmt, retry_args);
     }
+    s->__len += written;
+    va_end(retry_args);
+    va_end(args);
 }
 
 char string_index(String* s, size_t index) {
@@ -149,6 +884,117 @@ char* string_index_ref(String* s, size_t index) {
     return s->__data + index;
 }
 
+/* Compare `len` bytes for equality, returning a non-zero value when unequal.
+ * `memcmp` is vectorized by the C library, so this avoids any per-byte bounds checks.
+ */
+uint8_t __bytes_eq(const char* a, const char* b, size_t len) {
+    if (a == b || len == 0)
+        return 0;
+    return memcmp(a, b, len) != 0;
+}
+
+/* Lexicographically compare two byte ranges */
+CmpOrdering __bytes_cmp(const char* a, size_t a_len, const char* b, size_t b_len) {
+    size_t len = a_len < b_len ? a_len : b_len;
+    int res = len == 0 ? 0 : memcmp(a, b, len);
+    if (res == 0) {
+        if (a_len == b_len)
+            return CMP_EQUAL;
+        return a_len < b_len ? CMP_LESS : CMP_GREATER;
+    }
+    return res < 0 ? CMP_LESS : CMP_GREATER;
+}
+
+#ifdef UTILS_X86
+/* Flip the case bit of every byte in `[first, first + 26)` 32 bytes at a time,
+ * returning the number of bytes processed
+ */
+UTILS_TARGET("avx2")
+size_t __ascii_flip_case_avx2(char* data, size_t len, char first) {
+    /* shift the range to the bottom of the signed byte range, so one signed compare checks both ends */
+    const __m256i offset = _mm256_set1_epi8((char)(-128 - first));
+    const __m256i limit = _mm256_set1_epi8(-128 + 26);
+    const __m256i flip = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i in_range = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(chunk, offset));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(chunk, _mm256_and_si256(in_range, flip)));
+    }
+    return i;
+}
+#endif
+
+#ifdef __SSE2__
+/* Lowercase 16 bytes with the same range check as `__ascii_flip_case_avx2` */
+__m128i __ascii_lower_sse2(__m128i chunk) {
+    __m128i in_range = _mm_cmplt_epi8(_mm_add_epi8(chunk, _mm_set1_epi8((char)(-128 - 'A'))),
+                                      _mm_set1_epi8(-128 + 26));
+    return _mm_or_si128(chunk, _mm_and_si128(in_range, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/* Flip the case bit of every byte in `[first, first + 26)`, i.e. of `A-Z`
+ * when `first` is `A` and of `a-z` when `first` is `a`
+ */
+void __ascii_flip_case(char* data, size_t len, char first) {
+    size_t i = 0;
+#ifdef UTILS_X86
+    if (len >= 32 && __builtin_cpu_supports("avx2"))
+        i = __ascii_flip_case_avx2(data, len, first);
+#endif
+#ifdef __SSE2__
+    const __m128i offset = _mm_set1_epi8((char)(-128 - first));
+    const __m128i limit = _mm_set1_epi8(-128 + 26);
+    const __m128i flip = _mm_set1_epi8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i in_range = _mm_cmplt_epi8(_mm_add_epi8(chunk, offset), limit);
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(chunk, _mm_and_si128(in_range, flip)));
+    }
+#endif
+    for (; i < len; i++) {
+        if ((unsigned char)(data[i] - first) < 26)
+            data[i] ^= 0x20;
+    }
+}
+
+char __ascii_lower(char c) {
+    return (unsigned char)(c - 'A') < 26 ? (char)(c | 0x20) : c;
+}
+
+/* Compare two byte ranges of the same length ignoring ASCII case, returning non-zero if unequal */
+uint8_t __bytes_eq_ignore_ascii_case(const char* a, const char* b, size_t len) {
+    if (a == b)
+        return 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= len; i += 16) {
+        __m128i ca = __ascii_lower_sse2(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m128i cb = __ascii_lower_sse2(_mm_loadu_si128((const __m128i*)(b + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(ca, cb)) != 0xFFFF)
+            return 1;
+    }
+#endif
+    for (; i < len; i++) {
+        if (__ascii_lower(a[i]) != __ascii_lower(b[i]))
+            return 1;
+    }
+    return 0;
+}
+
+/* `fnv_64` of the lowercased bytes, without making a lowercase copy */
+uint64_t __fnv_64_ignore_ascii_case(const char* ptr, size_t len) {
+    size_t FNV_PRIME = 1099511628211U;
+    size_t FNV_OFFSET = 14695981039346656037U;
+    size_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        hash = hash ^ __ascii_lower(ptr[i]);
+        hash = hash * FNV_PRIME;
+    }
+    return hash;
+}
+
 uint8_t string_eq(void* string1, void* string2) {
     String* s1 = (String*)string1;
     String* s2 = (String*)string2;
@@ -158,12 +1004,13 @@ uint8_t string_eq(void* string1, void* string2) {
     size_t len = string_len(s1);
     if (len != string_len(s2))
         return 1;
+    return __bytes_eq(s1->__data, s2->__data, len);
+}
 
-    for (size_t i = 0; i < len; i++) {
-        if (string_index(s1, i) != string_index(s2, i))
-            return 1;
-    }
-    return 0;
+CmpOrdering string_cmp(void* string1, void* string2) {
+    String* s1 = (String*)string1;
+    String* s2 = (String*)string2;
+    return __bytes_cmp(s1->__data, s1->__len, s2->__data, s2->__len);
 }
 
 uint64_t string_hash(void* string) {
@@ -172,6 +1019,27 @@ uint64_t string_hash(void* string) {
     return fnv_64(s->__data, len);
 }
 
+uint8_t string_eq_ignore_ascii_case(void* s1_, void* s2_) {
+    String* s1 = (String*)s1_;
+    String* s2 = (String*)s2_;
+    if (s1->__len != s2->__len)
+        return 1;
+    return __bytes_eq_ignore_ascii_case(s1->__data, s2->__data, s1->__len);
+}
+
+uint64_t string_hash_ignore_ascii_case(void* s_) {
+    String* s = (String*)s_;
+    return __fnv_64_ignore_ascii_case(s->__data, s->__len);
+}
+
+void string_make_ascii_lowercase(String* s) {
+    __ascii_flip_case(s->__data, s->__len, 'A');
+}
+
+void string_make_ascii_uppercase(String* s) {
+    __ascii_flip_case(s->__data, s->__len, 'a');
+}
+
 Str string_as_str(String* s) {
     Str str = { .__data=s->__data, .__len=s->__len };
     return str;
@@ -218,40 +1086,177 @@ void string_drop(void* string_ptr) {
     String* s = (String*)string_ptr;
     if (s->__data == NULL)
         return;
-    free(s->__data);
+    __buf_free(s->__data, (s->__cap + 1) * sizeof(char));
     s->__len = 0;
     s->__cap = 0;
 }
 
 
-/* ----------- Str -------------- */
+/* ----------- StringBuilder ------------- */
 
 
-Str str_from_cstr(const char* cstr) {
-    size_t len = strlen(cstr);
-    Str s = { .__data=cstr, .__len=len };
-    return s;
+StringBuilder string_builder_new() {
+    return string_builder_with_chunk_size(STRING_BUILDER_CHUNK_SIZE);
 }
 
+StringBuilder string_builder_with_chunk_size(size_t chunk_size) {
+    if (chunk_size == 0)
+        chunk_size = STRING_BUILDER_CHUNK_SIZE;
+    StringBuilder sb = { .__chunks=vec_new(sizeof(String)), .__chunk_size=chunk_size, .__len=0 };
+    return sb;
+}
 
-Str str_from_ptr_len(const char* ptr, size_t len) {
-    Str s = { .__data=ptr, .__len=len };
-    return s;
+/* Append a new empty chunk able to hold at least `min_cap` bytes */
+String* __string_builder_new_chunk(StringBuilder* sb, size_t min_cap) {
+    size_t cap = sb->__chunk_size;
+    if (min_cap > cap)
+        cap = min_cap;
+    char* data = __buf_alloc((cap + 1) * sizeof(char));
+    if (data == NULL) {
+        fprintf(stderr, "StringBuilder alloc failure\n");
+        abort();
+    }
+    data[0] = '\0';
+    String chunk = { .__data=data, .__len=0, .__cap=cap };
+    vec_push(&sb->__chunks, &chunk);
+    return vec_index_ref_unchecked(&sb->__chunks, vec_len(&sb->__chunks) - 1);
 }
 
-Str str_trim_whitespace(Str* s) {
-    size_t start = 0;
-    size_t end = s->__len;
-    while (start < end && isspace(str_index(s, start)))
-        start++;
+size_t string_builder_len(StringBuilder* sb) {
+    return sb->__len;
+}
 
-    size_t len;
-    if (start >= end) {
-        len = 0;
-    } else {
-        if (end > 0)
-            end--;
-        while (isspace(str_index(s, end)))
+void string_builder_push_char(StringBuilder* sb, char c) {
+    string_builder_push_cstr_bound(sb, &c, 1);
+}
+
+void string_builder_push_str(StringBuilder* sb, Str* str) {
+    string_builder_push_cstr_bound(sb, str->__data, str->__len);
+}
+
+void string_builder_push_string(StringBuilder* sb, String* s) {
+    string_builder_push_cstr_bound(sb, s->__data, s->__len);
+}
+
+void string_builder_push_cstr(StringBuilder* sb, const char* cstr) {
+    string_builder_push_cstr_bound(sb, cstr, strlen(cstr));
+}
+
+void string_builder_push_cstr_bound(StringBuilder* sb, const char* cstr, size_t len) {
+    if (len == 0)
+        return;
+    size_t num_chunks = vec_len(&sb->__chunks);
+    String* last = NULL;
+    size_t avail = 0;
+    if (num_chunks > 0) {
+        last = vec_index_ref_unchecked(&sb->__chunks, num_chunks - 1);
+        avail = last->__cap - last->__len;
+    }
+    if (avail > len)
+        avail = len;
+    if (avail > 0) {
+        memcpy(last->__data + last->__len, cstr, avail);
+        last->__len += avail;
+    }
+    if (avail < len) {
+        /* spill the remainder into a fresh chunk, previous chunks are never touched again */
+        size_t rest = len - avail;
+        String* chunk = __string_builder_new_chunk(sb, rest);
+        memcpy(chunk->__data, cstr + avail, rest);
+        chunk->__len = rest;
+    }
+    sb->__len += len;
+}
+
+String string_builder_into_string(StringBuilder* sb) {
+    size_t num_chunks = vec_len(&sb->__chunks);
+    String s;
+    if (num_chunks == 1) {
+        s = *(String*)vec_index_ref_unchecked(&sb->__chunks, 0);
+        s.__data[s.__len] = '\0';
+        vec_drop(&sb->__chunks);
+    } else {
+        char* data = __buf_alloc((sb->__len + 1) * sizeof(char));
+        if (data == NULL) {
+            fprintf(stderr, "String alloc failure\n");
+            abort();
+        }
+        size_t offset = 0;
+        for (size_t i = 0; i < num_chunks; i++) {
+            String* chunk = vec_index_ref_unchecked(&sb->__chunks, i);
+            memcpy(data + offset, chunk->__data, chunk->__len);
+            offset += chunk->__len;
+        }
+        data[offset] = '\0';
+        s.__data = data;
+        s.__len = offset;
+        s.__cap = offset;
+        vec_drop_with(&sb->__chunks, string_drop);
+    }
+    sb->__chunks = vec_new(sizeof(String));
+    sb->__len = 0;
+    return s;
+}
+
+int string_builder_write_fd(StringBuilder* sb, int fd) {
+    struct iovec iov[IOV_MAX < 1024 ? IOV_MAX : 1024];
+    size_t batch = sizeof(iov) / sizeof(iov[0]);
+    size_t num_chunks = vec_len(&sb->__chunks);
+    size_t i = 0;
+    while (i < num_chunks) {
+        int count = 0;
+        for (; i < num_chunks && (size_t)count < batch; i++) {
+            String* chunk = vec_index_ref_unchecked(&sb->__chunks, i);
+            iov[count].iov_base = chunk->__data;
+            iov[count].iov_len = chunk->__len;
+            count++;
+        }
+        if (__write_all_iov(fd, iov, count, NULL) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+void string_builder_clear(StringBuilder* sb) {
+    vec_clear(&sb->__chunks, string_drop);
+    sb->__len = 0;
+}
+
+void string_builder_drop(void* sb_ptr) {
+    StringBuilder* sb = (StringBuilder*)sb_ptr;
+    vec_drop_with(&sb->__chunks, string_drop);
+    sb->__len = 0;
+}
+
+
+/* ----------- Str -------------- */
+
+
+Str str_from_cstr(const char* cstr) {
+    size_t len = strlen(cstr);
+    Str s = { .__data=cstr, .__len=len };
+    return s;
+}
+
+
+Str str_from_ptr_len(const char* ptr, size_t len) {
+    Str s = { .__data=ptr, .__len=len };
+    return s;
+}
+
+Str str_trim_whitespace(Str* s) {
+    size_t start = 0;
+    size_t end = s->__len;
+    while (start < end && isspace(str_index(s, start)))
+        start++;
+
+    size_t len;
+    if (start >= end) {
+        len = 0;
+    } else {
+        if (end > 0)
+            end--;
+        while (isspace(str_index(s, end)))
             end--;
         len = end - start + 1;
     }
@@ -271,13 +1276,9 @@ Vec str_split_lines(Str* str) {
     size_t end = 0;
     Vec v = vec_new(sizeof(Str));
     while (start <= len) {
-        end = start;
-        while (end <= len && *(ptr + end) != '\n') {
-            end++;
-        }
-        if (end >= len) {
-            end = len;
-        }
+        /* never look past `len`, the data may end exactly at an unmapped page */
+        const char* newline = start < len ? memchr(ptr + start, '\n', len - start) : NULL;
+        end = newline == NULL ? len : (size_t)(newline - ptr);
         Str str = str_from_ptr_len((ptr + start), (end - start));
         vec_push(&v, &str);
         start = end + 1;
@@ -401,12 +1402,13 @@ uint8_t str_eq(void* str1_, void* str2_) {
     size_t len = str_len(str1);
     if (len != str_len(str2))
         return 1;
+    return __bytes_eq(str1->__data, str2->__data, len);
+}
 
-    for (size_t i = 0; i < len; i++) {
-        if (str_index(str1, i) != str_index(str2, i))
-            return 1;
-    }
-    return 0;
+CmpOrdering str_cmp(void* str1_, void* str2_) {
+    Str* str1 = (Str*)str1_;
+    Str* str2 = (Str*)str2_;
+    return __bytes_cmp(str1->__data, str1->__len, str2->__data, str2->__len);
 }
 
 uint64_t str_hash(void* str_) {
@@ -415,261 +1417,4510 @@ uint64_t str_hash(void* str_) {
     return fnv_64((void*)str->__data, len);
 }
 
-String read_file(const char* path) {
-    FILE* f = fopen(path, "r");
-    if (f == NULL) {
-        perror("Error opening file");
-        abort();
-    }
-    fseek(f, 0, SEEK_END);
-    size_t len = ftell(f);
-    rewind(f);
-    char* content = malloc((len + 1) * sizeof(char));
-    fread(content, sizeof(char), len, f);
-    content[len] = '\0';
-    fclose(f);
-    String s = { .__data=content, .__len=len, .__cap=len };
-    return s;
+uint8_t str_eq_ignore_ascii_case(void* str1_, void* str2_) {
+    Str* str1 = (Str*)str1_;
+    Str* str2 = (Str*)str2_;
+    if (str1->__len != str2->__len)
+        return 1;
+    return __bytes_eq_ignore_ascii_case(str1->__data, str2->__data, str1->__len);
 }
 
+uint64_t str_hash_ignore_ascii_case(void* str_) {
+    Str* str = (Str*)str_;
+    return __fnv_64_ignore_ascii_case(str->__data, str->__len);
+}
 
-/* ----------- Vec ------------- */
 
+/* ----------- UTF-8 -------------- */
 
-Vec vec_new(size_t item_size) {
-    Vec v = { .__data=NULL, .__item_size=item_size, .__len=0, .__cap=0 };
-    return v;
+
+/* Return the length of the valid UTF-8 sequence starting at `ptr[0]`,
+ * or 0 if the sequence is invalid or truncated. Writes the decoded codepoint to `cp`.
+ */
+size_t __utf8_decode(const uint8_t* ptr, size_t avail, uint32_t* cp) {
+    uint8_t b0 = ptr[0];
+    if (b0 < 0x80) {
+        *cp = b0;
+        return 1;
+    }
+    if (b0 < 0xC2 || b0 > 0xF4)
+        return 0;
+    if (b0 < 0xE0) {
+        if (avail < 2 || (ptr[1] & 0xC0) != 0x80)
+            return 0;
+        *cp = ((uint32_t)(b0 & 0x1F) << 6) | (ptr[1] & 0x3F);
+        return 2;
+    }
+    if (b0 < 0xF0) {
+        if (avail < 3 || (ptr[1] & 0xC0) != 0x80 || (ptr[2] & 0xC0) != 0x80)
+            return 0;
+        if ((b0 == 0xE0 && ptr[1] < 0xA0) || (b0 == 0xED && ptr[1] > 0x9F))
+            return 0;  /* overlong or surrogate */
+        *cp = ((uint32_t)(b0 & 0x0F) << 12) | ((uint32_t)(ptr[1] & 0x3F) << 6) | (ptr[2] & 0x3F);
+        return 3;
+    }
+    if (avail < 4 || (ptr[1] & 0xC0) != 0x80 || (ptr[2] & 0xC0) != 0x80 || (ptr[3] & 0xC0) != 0x80)
+        return 0;
+    if ((b0 == 0xF0 && ptr[1] < 0x90) || (b0 == 0xF4 && ptr[1] > 0x8F))
+        return 0;  /* overlong or above U+10FFFF */
+    *cp = ((uint32_t)(b0 & 0x07) << 18) | ((uint32_t)(ptr[1] & 0x3F) << 12)
+        | ((uint32_t)(ptr[2] & 0x3F) << 6) | (ptr[3] & 0x3F);
+    return 4;
 }
 
-Vec vec_with_capacity(size_t item_size, size_t cap) {
-    void* data = malloc(cap * item_size);
-    if (data == NULL) {
-        fprintf(stderr, "Vec alloc failure\n");
-        abort();
+uint8_t __utf8_validate_scalar(const uint8_t* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+#ifdef __SSE2__
+        /* skip whole blocks of ascii */
+        while (i + 16 <= len && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i))) == 0)
+            i += 16;
+        if (i >= len)
+            break;
+#endif
+        uint32_t cp;
+        size_t n = __utf8_decode(data + i, len - i, &cp);
+        if (n == 0)
+            return 0;
+        i += n;
     }
-    Vec v = { .__data=data, .__item_size=item_size, .__len=0, .__cap=cap };
-    return v;
+    return 1;
 }
 
-Vec vec_copy(Vec* src) {
-    size_t len = vec_len(src);
-    size_t item_size = src->__item_size;
-    Vec v = vec_with_capacity(item_size, len);
-    v.__len = len;
-    memcpy(v.__data, src->__data, len * item_size);
-    return v;
+#ifdef UTILS_X86
+/* Vectorized validation using the lookup-table algorithm from
+ * Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+ * The high and low nibbles of each byte and the high nibble of the following
+ * byte index three tables whose intersection flags every error class that can
+ * be detected from a pair of bytes. Missing or extra continuation bytes of
+ * 3 and 4 byte sequences are caught by comparing against the bytes 2 and 3 back.
+ */
+UTILS_TARGET("ssse3")
+uint8_t __utf8_validate_ssse3(const uint8_t* data, size_t len) {
+    /* error classes */
+    const char TOO_SHORT = 1 << 0, TOO_LONG = 1 << 1, OVERLONG_3 = 1 << 2, TOO_LARGE = 1 << 3,
+          SURROGATE = 1 << 4, OVERLONG_2 = 1 << 5, TOO_LARGE_1000 = 1 << 6, OVERLONG_4 = 1 << 6;
+    const char TWO_CONTS = (char)(1 << 7);
+    const char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    const __m128i byte_1_high_table = _mm_setr_epi8(
+        /* 0xxx: ascii */
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        /* 10xx: continuation */
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        /* 1100, 1101: two byte lead */
+        TOO_SHORT | OVERLONG_2, TOO_SHORT,
+        /* 1110: three byte lead */
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        /* 1111: four byte lead */
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m128i byte_1_low_table = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY, CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m128i byte_2_high_table = _mm_setr_epi8(
+        /* 0xxx: ascii */
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        /* 1000 */
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        /* 1001 */
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        /* 101x */
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        /* 11xx: lead byte */
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    /* bytes at the end of a block that start a sequence which can't fit in it */
+    const __m128i max_value = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+
+    __m128i error = _mm_setzero_si128();
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    uint8_t tail[16];
+    for (size_t i = 0; i < len; i += 16) {
+        __m128i input;
+        if (len - i >= 16) {
+            input = _mm_loadu_si128((const __m128i*)(data + i));
+        } else {
+            /* pad the final block with ascii nulls, truncated sequences then show up as TOO_SHORT */
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, data + i, len - i);
+            input = _mm_loadu_si128((const __m128i*)tail);
+        }
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, prev_incomplete);
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+            __m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table,
+                    _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble_mask));
+            __m128i byte_1_low = _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, nibble_mask));
+            __m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table,
+                    _mm_and_si128(_mm_srli_epi16(input, 4), nibble_mask));
+            __m128i special_cases = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+            __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+            __m128i is_third_byte = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+            __m128i is_fourth_byte = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+            __m128i must_be_continuation = _mm_and_si128(_mm_or_si128(is_third_byte, is_fourth_byte),
+                                                         _mm_set1_epi8((char)0x80));
+            error = _mm_or_si128(error, _mm_xor_si128(must_be_continuation, special_cases));
+            prev_incomplete = _mm_subs_epu8(input, max_value);
+        }
+        prev_input = input;
+    }
+    error = _mm_or_si128(error, prev_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
 }
+#endif
 
-size_t vec_len(Vec* v) {
-    return v->__len;
+uint8_t str_validate_utf8(Str* s) {
+    const uint8_t* data = (const uint8_t*)s->__data;
+#ifdef UTILS_X86
+    if (s->__len >= 16 && __builtin_cpu_supports("ssse3"))
+        return __utf8_validate_ssse3(data, s->__len);
+#endif
+    return __utf8_validate_scalar(data, s->__len);
 }
 
-size_t vec_cap(Vec* v) {
-    return v->__cap;
+StrCharIter str_char_iter(Str* s) {
+    StrCharIter iter = { .__data=s->__data, .__len=s->__len, .__ind=0 };
+    return iter;
 }
 
-void vec_resize(Vec* v, size_t new_cap) {
-    if (new_cap == 0)
-        new_cap = 16;
+uint8_t str_char_iter_done(StrCharIter* iter) {
+    return iter->__ind >= iter->__len ? 1 : 0;
+}
 
-    void* data = realloc(v->__data, new_cap * v->__item_size);
-    if (data == NULL) {
-        fprintf(stderr, "Vec resize failure\n");
-        abort();
+uint32_t str_char_iter_next(StrCharIter* iter) {
+    uint32_t cp;
+    size_t n = __utf8_decode((const uint8_t*)iter->__data + iter->__ind, iter->__len - iter->__ind, &cp);
+    if (n == 0) {
+        iter->__ind++;
+        return UTF8_REPLACEMENT_CHAR;
     }
-    v->__data = data;
-    v->__cap = new_cap;
+    iter->__ind += n;
+    return cp;
 }
 
-void __vec_check_resize(Vec* v) {
-    size_t avail = v->__cap - v->__len;
-    if (avail == 0) {
-        size_t new_cap = __inc_cap(v->__cap);
-        vec_resize(v, new_cap);
+size_t str_char_iter_offset(StrCharIter* iter) {
+    return iter->__ind;
+}
+
+/* Count the bytes in `data` that start a codepoint, i.e. that aren't continuation bytes */
+size_t __utf8_count_chars(const uint8_t* data, size_t len) {
+    size_t count = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    /* continuation bytes are 0x80..0xBF, or -128..-65 when viewed as signed */
+    const __m128i last_continuation = _mm_set1_epi8(-65);
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpgt_epi8(input, last_continuation));
+        count += __builtin_popcount(mask);
+    }
+#endif
+    for (; i < len; i++) {
+        count += (data[i] & 0xC0) != 0x80;
     }
+    return count;
 }
 
-void vec_push(Vec* v, void* obj) {
-    __vec_check_resize(v);
-    char* offset = (char*)v->__data + (v->__len * v->__item_size);
-    memcpy((void*)offset, obj, v->__item_size);
-    v->__len++;
+size_t str_char_count(Str* s) {
+    return __utf8_count_chars((const uint8_t*)s->__data, s->__len);
 }
 
-void vec_insert(Vec* v, void* obj, size_t ind) {
-    if (ind > v->__len) {
-        fprintf(stderr, "Out of bounds (ind > len): veclen: %lu, insert-index: %lu\n", v->__len, ind);
+size_t str_char_index(Str* s, size_t byte_offset) {
+    if (byte_offset > s->__len) {
+        fprintf(stderr, "Out of bounds: strlen: %lu, offset: %lu\n", s->__len, byte_offset);
         abort();
     }
-    __vec_check_resize(v);
-    size_t trailing_elems = v->__len - ind;
-    char* insert_ptr = (char*)v->__data + (ind * v->__item_size);
-    char* offset_ptr = insert_ptr + v->__item_size;
-    memmove(offset_ptr, insert_ptr, (trailing_elems * v->__item_size));
-    memcpy((void*)insert_ptr, obj, v->__item_size);
-    v->__len++;
+    return __utf8_count_chars((const uint8_t*)s->__data, byte_offset);
 }
 
-void vec_remove(Vec* v, size_t ind) {
-    if (ind >= v->__len) {
-        fprintf(stderr, "Out of bounds (ind >= len): veclen: %lu, insert-index: %lu\n", v->__len, ind);
-        abort();
-    }
-    size_t trailing_elems = v->__len - 1 - ind;
-    if (trailing_elems == 0) {
-        v->__len--;
-    } else {
-        char* dest_ptr = (char*)v->__data + (ind * v->__item_size);
-        char* src_ptr = dest_ptr + v->__item_size;
-        memmove(dest_ptr, src_ptr, (trailing_elems * v->__item_size));
-        v->__len--;
-    }
+
+/* ----------- Str number parsing -------------- */
+
+
+#ifdef UTILS_SWAR_DIGITS
+/* Load 8 bytes as a little-endian word */
+uint64_t __load_u64(const char* ptr) {
+    uint64_t v;
+    memcpy(&v, ptr, sizeof(v));
+    return v;
 }
 
-void vec_remove_with(Vec* v, size_t ind, mapFn drop) {
-    if (ind >= v->__len) {
-        fprintf(stderr, "Out of bounds (ind >= len): veclen: %lu, insert-index: %lu\n", v->__len, ind);
-        abort();
+/* Check that all 8 bytes of a word are ascii digits */
+uint8_t __is_eight_digits(uint64_t v) {
+    return (((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+            == 0x3333333333333333);
+}
+
+/* Convert a word of 8 ascii digits (first digit in the lowest byte) to its value,
+ * combining pairs, then quads, then the two halves with 3 multiplications.
+ */
+uint32_t __parse_eight_digits(uint64_t v) {
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 0x000F424000000064;  /* 100 + (1000000 << 32) */
+    const uint64_t mul2 = 0x0000271000000001;  /* 1 + (10000 << 32) */
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)v;
+}
+#endif
+
+/* Parse a non-empty run of digits as a `uint64_t` */
+ParseStatus __parse_u64_digits(const char* ptr, size_t len, uint64_t* out) {
+    if (len == 0)
+        return PARSE_INVALID;
+    size_t i = 0;
+    while (i < len && ptr[i] == '0')
+        i++;
+    uint64_t v = 0;
+    size_t num_digits = 0;
+    uint8_t overflow = 0;
+    while (i < len) {
+#ifdef UTILS_SWAR_DIGITS
+        /* 19 digits always fit in a uint64_t */
+        if (num_digits + 8 <= 19 && len - i >= 8 && __is_eight_digits(__load_u64(ptr + i))) {
+            v = v * 100000000 + __parse_eight_digits(__load_u64(ptr + i));
+            num_digits += 8;
+            i += 8;
+            continue;
+        }
+#endif
+        unsigned d = (unsigned char)ptr[i] - '0';
+        if (d > 9)
+            return PARSE_INVALID;
+        if (v > (UINT64_MAX - d) / 10)
+            overflow = 1;
+        else
+            v = v * 10 + d;
+        num_digits++;
+        i++;
     }
-    char* remove_ptr = (char*)v->__data + (ind * v->__item_size);
-    drop((void*)remove_ptr);
-    vec_remove(v, ind);
+    if (overflow)
+        return PARSE_OVERFLOW;
+    *out = v;
+    return PARSE_OK;
 }
 
-void* vec_index_ref(Vec* v, size_t ind) {
-    if (ind >= v->__len) {
-        fprintf(stderr, "Out of bounds: veclen: %lu, index: %lu\n", v->__len, ind);
-        abort();
+ParseStatus str_parse_u64(Str* s, uint64_t* out) {
+    const char* ptr = s->__data;
+    size_t len = s->__len;
+    if (len == 0)
+        return PARSE_EMPTY;
+    if (ptr[0] == '+') {
+        ptr++;
+        len--;
     }
-    char* offset = (char*)v->__data + (ind * v->__item_size);
-    return (void*)offset;
+    return __parse_u64_digits(ptr, len, out);
 }
 
-inline void* vec_index_ref_unchecked(Vec* v, size_t ind) {
-    char* offset = (char*)v->__data + (ind * v->__item_size);
-    return (void*)offset;
+ParseStatus str_parse_i64(Str* s, int64_t* out) {
+    const char* ptr = s->__data;
+    size_t len = s->__len;
+    if (len == 0)
+        return PARSE_EMPTY;
+    uint8_t negative = 0;
+    if (ptr[0] == '+' || ptr[0] == '-') {
+        negative = ptr[0] == '-';
+        ptr++;
+        len--;
+    }
+    uint64_t magnitude;
+    ParseStatus status = __parse_u64_digits(ptr, len, &magnitude);
+    if (status != PARSE_OK)
+        return status;
+    if (negative) {
+        if (magnitude > (uint64_t)INT64_MAX + 1)
+            return PARSE_OVERFLOW;
+        *out = magnitude == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)magnitude;
+    } else {
+        if (magnitude > (uint64_t)INT64_MAX)
+            return PARSE_OVERFLOW;
+        *out = (int64_t)magnitude;
+    }
+    return PARSE_OK;
 }
 
-void vec_iter_ref(Vec* v, mapFn func) {
-    size_t len = vec_len(v);
-    for (size_t i = 0; i < len; i++) {
-        void* ref = vec_index_ref(v, i);
-        func(ref);
+/* Powers of five as normalized, truncated 128bit values (high word first)
+ * for exponents in [__POW5_128_MIN, __POW5_128_MAX], used by Eisel-Lemire.
+ * Generated once on first use rather than shipped as a 10KB literal table.
+ */
+#define __POW5_128_MIN (-342)
+#define __POW5_128_MAX 308
+uint64_t __pow5_128[2 * (__POW5_128_MAX - __POW5_128_MIN + 1)];
+pthread_once_t __pow5_128_once = PTHREAD_ONCE_INIT;
+
+void __pow5_128_init() {
+    __Bignum pow5, tmp;
+    __bignum_set(&pow5, 1);
+    for (int q = 0; q <= __POW5_128_MAX; q++) {
+        tmp = pow5;
+        size_t ind = 2 * (size_t)(q - __POW5_128_MIN);
+        __bignum_top_bits(&tmp, 128, &__pow5_128[ind], &__pow5_128[ind + 1]);
+        __bignum_mul_small(&pow5, 5);
+    }
+    /* negative powers are reciprocals: floor(2^b / 5^-q) + 1, truncated to 128 bits */
+    __bignum_set(&pow5, 5);
+    for (int q = -1; q >= __POW5_128_MIN; q--) {
+        size_t z = __bignum_bitlen(&pow5);
+        size_t b = q >= -27 ? z + 127 : 2 * z + 128;
+        __bignum_pow2_div(b, &pow5, &tmp);
+        __bignum_add_small(&tmp, 1);
+        size_t ind = 2 * (size_t)(q - __POW5_128_MIN);
+        __bignum_top_bits(&tmp, 128, &__pow5_128[ind], &__pow5_128[ind + 1]);
+        __bignum_mul_small(&pow5, 5);
     }
 }
 
-uint8_t vec_eq(void* v1_, void* v2_, cmpEq cmp_func) {
-    Vec* v1 = (Vec*)v1_;
-    Vec* v2 = (Vec*)v2_;
-    if (v1 == v2)
-        return 0;
+/* floor(v / 2^16) for signed values */
+int64_t __floor_shr16(int64_t v) {
+    return v >= 0 ? v >> 16 : -((-v + 65535) >> 16);
+}
 
-    size_t len = vec_len(v1);
-    if (len != vec_len(v2))
+/* Compute the bits of the double nearest to w * 10^q with the Eisel-Lemire algorithm
+ * (as implemented by fast_float). Returns 0 if the 128bit product approximation
+ * can't decide the rounding, which requires falling back to a slower method.
+ */
+uint8_t __eisel_lemire(uint64_t w, int64_t q, uint64_t* bits) {
+    const int MANTISSA_BITS = 52;
+    if (w == 0 || q < __POW5_128_MIN) {
+        *bits = 0;
+        return 1;
+    }
+    if (q > __POW5_128_MAX) {
+        *bits = (uint64_t)0x7FF << MANTISSA_BITS;
         return 1;
+    }
+    pthread_once(&__pow5_128_once, __pow5_128_init);
 
-    for (size_t i = 0; i < len; i++) {
-        void* a = vec_index_ref(v1, i);
-        void* b = vec_index_ref(v2, i);
-        if (cmp_func(a, b))
+    int lz = __clz64(w);
+    w <<= lz;
+    size_t ind = 2 * (size_t)(q - __POW5_128_MIN);
+    uint64_t hi;
+    uint64_t lo = __umul128(w, __pow5_128[ind], &hi);
+    const uint64_t precision_mask = UINT64_MAX >> (MANTISSA_BITS + 3);
+    if ((hi & precision_mask) == precision_mask) {
+        /* the low bits are all ones, so the truncated part of the power may carry */
+        uint64_t hi2;
+        __umul128(w, __pow5_128[ind + 1], &hi2);
+        lo += hi2;
+        if (hi2 > lo)
+            hi++;
+    }
+    if (lo == UINT64_MAX && (q < -27 || q > 55))
+        return 0;
+
+    int upperbit = (int)(hi >> 63);
+    int shift = upperbit + 64 - MANTISSA_BITS - 3;
+    uint64_t mantissa = hi >> shift;
+    int64_t power2 = __floor_shr16((152170 + 65536) * q) + 63 + upperbit - lz + 1023;
+    if (power2 <= 0) {
+        /* subnormal */
+        if (-power2 + 1 >= 64) {
+            *bits = 0;
             return 1;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < ((uint64_t)1 << MANTISSA_BITS) ? 0 : 1;
+        *bits = mantissa | ((uint64_t)power2 << MANTISSA_BITS);
+        return 1;
     }
-    return 0;
+    /* exactly halfway between two doubles, round to even instead of up */
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi)
+        mantissa &= ~(uint64_t)1;
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= ((uint64_t)2 << MANTISSA_BITS)) {
+        mantissa = (uint64_t)1 << MANTISSA_BITS;
+        power2++;
+    }
+    mantissa &= ~((uint64_t)1 << MANTISSA_BITS);
+    if (power2 >= 0x7FF) {
+        power2 = 0x7FF;
+        mantissa = 0;
+    }
+    *bits = mantissa | ((uint64_t)power2 << MANTISSA_BITS);
+    return 1;
 }
 
-uint64_t vec_hash_with(void* v, hashFn hash_func) {
-    size_t len = vec_len(v);
-    uint64_t hash = 17;
-    for (size_t i = 0; i < len; i++) {
-        void* ref = vec_index_ref(v, i);
-        hash = hash * 31 + hash_func(ref);
+/* Case insensitive match of an ascii keyword against the whole of `ptr[0..len]` */
+uint8_t __matches_keyword(const char* ptr, size_t len, const char* keyword) {
+    size_t i = 0;
+    for (; i < len && keyword[i]; i++) {
+        if (tolower((unsigned char)ptr[i]) != keyword[i])
+            return 0;
     }
-    return hash;
+    return i == len && keyword[i] == '\0';
 }
 
-void vec_clear(Vec* v, mapFn drop) {
-    if (v->__data == NULL)
-        return;
-    vec_iter_ref(v, drop);
-    v->__len = 0;
+double __f64_from_bits(uint64_t bits) {
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
 }
 
-void vec_drop(void* vec_ptr) {
-    Vec* v = (Vec*)vec_ptr;
-    if (v->__data == NULL)
-        return;
-    free(v->__data);
-    v->__len = 0;
-    v->__cap = 0;
+locale_t __parse_c_locale = (locale_t)0;
+pthread_once_t __parse_c_locale_once = PTHREAD_ONCE_INIT;
+
+void __parse_c_locale_init() {
+    __parse_c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
 }
 
-void vec_drop_with(Vec* v, mapFn drop) {
-    if (v->__data == NULL)
+ParseStatus str_parse_f64(Str* s, double* out) {
+    const char* ptr = s->__data;
+    size_t len = s->__len;
+    if (len == 0)
+        return PARSE_EMPTY;
+    size_t i = 0;
+    uint8_t negative = 0;
+    if (ptr[0] == '+' || ptr[0] == '-') {
+        negative = ptr[0] == '-';
+        i++;
+    }
+    uint64_t sign_bit = (uint64_t)negative << 63;
+    if (i < len && !isdigit((unsigned char)ptr[i]) && ptr[i] != '.') {
+        if (__matches_keyword(ptr + i, len - i, "inf") || __matches_keyword(ptr + i, len - i, "infinity")) {
+            *out = __f64_from_bits(sign_bit | ((uint64_t)0x7FF << 52));
+            return PARSE_OK;
+        }
+        if (__matches_keyword(ptr + i, len - i, "nan")) {
+            *out = __f64_from_bits(sign_bit | 0x7FF8000000000000);
+            return PARSE_OK;
+        }
+        return PARSE_INVALID;
+    }
+
+    /* value = w * 10^q, keeping at most 19 significant digits in w */
+    uint64_t w = 0;
+    int64_t q = 0;
+    size_t num_digits = 0;
+    size_t num_significant = 0;
+    uint8_t truncated = 0;
+    while (i < len && ptr[i] == '0') {
+        i++;
+        num_digits++;
+    }
+    while (i < len) {
+#ifdef UTILS_SWAR_DIGITS
+        if (num_significant + 8 <= 19 && len - i >= 8 && __is_eight_digits(__load_u64(ptr + i))) {
+            w = w * 100000000 + __parse_eight_digits(__load_u64(ptr + i));
+            num_significant += 8;
+            num_digits += 8;
+            i += 8;
+            continue;
+        }
+#endif
+        unsigned d = (unsigned char)ptr[i] - '0';
+        if (d > 9)
+            break;
+        if (num_significant < 19) {
+            w = w * 10 + d;
+            num_significant++;
+        } else {
+            q++;
+            truncated |= d != 0;
+        }
+        num_digits++;
+        i++;
+    }
+    if (i < len && ptr[i] == '.') {
+        i++;
+        if (num_significant == 0) {
+            while (i < len && ptr[i] == '0') {
+                i++;
+                num_digits++;
+                q--;
+            }
+        }
+        while (i < len) {
+#ifdef UTILS_SWAR_DIGITS
+            if (num_significant + 8 <= 19 && len - i >= 8 && __is_eight_digits(__load_u64(ptr + i))) {
+                w = w * 100000000 + __parse_eight_digits(__load_u64(ptr + i));
+                num_significant += 8;
+                num_digits += 8;
+                q -= 8;
+                i += 8;
+                continue;
+            }
+#endif
+            unsigned d = (unsigned char)ptr[i] - '0';
+            if (d > 9)
+                break;
+            if (num_significant < 19) {
+                w = w * 10 + d;
+                num_significant++;
+                q--;
+            } else {
+                truncated |= d != 0;
+            }
+            num_digits++;
+            i++;
+        }
+    }
+    if (num_digits == 0)
+        return PARSE_INVALID;
+    if (i < len && (ptr[i] == 'e' || ptr[i] == 'E')) {
+        i++;
+        uint8_t exp_negative = 0;
+        if (i < len && (ptr[i] == '+' || ptr[i] == '-')) {
+            exp_negative = ptr[i] == '-';
+            i++;
+        }
+        if (i >= len || !isdigit((unsigned char)ptr[i]))
+            return PARSE_INVALID;
+        int64_t exp = 0;
+        for (; i < len && isdigit((unsigned char)ptr[i]); i++) {
+            if (exp < 100000)  /* saturate, anything larger is 0 or inf anyway */
+                exp = exp * 10 + (ptr[i] - '0');
+        }
+        q += exp_negative ? -exp : exp;
+    }
+    if (i != len)
+        return PARSE_INVALID;
+
+    if (!truncated) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+        /* Clinger's fast path: both operands are exact doubles, so a single
+         * correctly rounded multiplication or division gives the exact result */
+        static const double POW10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+        if (w <= ((uint64_t)1 << 53) && q >= -22 && q <= 22) {
+            double v = (double)w;
+            v = q < 0 ? v / POW10[-q] : v * POW10[q];
+            *out = negative ? -v : v;
+            return PARSE_OK;
+        }
+#endif
+        uint64_t bits;
+        if (__eisel_lemire(w, q, &bits)) {
+            *out = __f64_from_bits(sign_bit | bits);
+            return (bits >> 52) == 0x7FF ? PARSE_OVERFLOW : PARSE_OK;
+        }
+    }
+
+    /* more than 19 significant digits or an undecidable rounding: defer to strtod,
+     * in the "C" locale so a process-wide `LC_NUMERIC` can't change the decimal point */
+    pthread_once(&__parse_c_locale_once, __parse_c_locale_init);
+    char buf[128];
+    char* cstr = len < sizeof(buf) ? buf : malloc(len + 1);
+    if (cstr == NULL) {
+        fprintf(stderr, "Parse alloc failure\n");
+        abort();
+    }
+    memcpy(cstr, ptr, len);
+    cstr[len] = '\0';
+    double v = __parse_c_locale != (locale_t)0 ? strtod_l(cstr, NULL, __parse_c_locale) : strtod(cstr, NULL);
+    if (cstr != buf)
+        free(cstr);
+    *out = v;
+    return isinf(v) ? PARSE_OVERFLOW : PARSE_OK;
+}
+
+
+/* ----------- HashedStr -------------- */
+
+
+HashedStr hashed_str_new(Str* str) {
+    HashedStr hs = { .__str=*str, .__hash=str_hash(str) };
+    return hs;
+}
+
+HashedStr hashed_str_from_cstr(const char* cstr) {
+    Str str = str_from_cstr(cstr);
+    return hashed_str_new(&str);
+}
+
+Str hashed_str_as_str(HashedStr* hs) {
+    return hs->__str;
+}
+
+uint8_t hashed_str_eq(void* hs1_, void* hs2_) {
+    HashedStr* hs1 = (HashedStr*)hs1_;
+    HashedStr* hs2 = (HashedStr*)hs2_;
+    if (hs1 == hs2)
+        return 0;
+    if (hs1->__hash != hs2->__hash || hs1->__str.__len != hs2->__str.__len)
+        return 1;
+    return __bytes_eq(hs1->__str.__data, hs2->__str.__data, hs1->__str.__len);
+}
+
+uint64_t hashed_str_hash(void* hs) {
+    return ((HashedStr*)hs)->__hash;
+}
+
+String read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        perror("Error opening file");
+        abort();
+    }
+    long end = -1;
+    if (fseek(f, 0, SEEK_END) == 0)
+        end = ftell(f);
+    if (end < 0) {
+        perror("Error reading file");
+        abort();
+    }
+    rewind(f);
+    size_t len = (size_t)end;
+    char* content = __buf_alloc((len + 1) * sizeof(char));
+    if (content == NULL) {
+        fprintf(stderr, "String alloc failure\n");
+        abort();
+    }
+    /* fread may return short counts, keep reading until the file is exhausted */
+    size_t total = 0;
+    while (total < len) {
+        size_t n = fread(content + total, sizeof(char), len - total, f);
+        if (n == 0) {
+            if (ferror(f)) {
+                perror("Error reading file");
+                abort();
+            }
+            break;  /* file shrank since it was measured */
+        }
+        total += n;
+    }
+    content[total] = '\0';
+    fclose(f);
+    String s = { .__data=content, .__len=total, .__cap=len };
+    return s;
+}
+
+
+/* ----------- Batch file reading ------------- */
+
+
+/* Read a whole file into `out`, returning 0 or the `errno` of the failure */
+int __read_whole_file(const char* path, String* out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    size_t cap = (size_t)st.st_size;
+    char* data = __buf_alloc(cap + 1);
+    if (data == NULL) {
+        fprintf(stderr, "String alloc failure\n");
+        abort();
+    }
+    size_t total = 0;
+    while (total < cap) {
+        ssize_t n = read(fd, data + total, cap - total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            int err = errno;
+            __buf_free(data, cap + 1);
+            close(fd);
+            return err;
+        }
+        if (n == 0)
+            break;
+        total += (size_t)n;
+    }
+    close(fd);
+    data[total] = '\0';
+    String s = { .__data=data, .__len=total, .__cap=cap };
+    *out = s;
+    return 0;
+}
+
+/* Work shared by the threads of `__read_files_pool`, files are claimed by index */
+typedef struct {
+    const char** paths;
+    String* out;
+    int* errors;
+    size_t n, next;
+    pthread_mutex_t lock;
+} __ReadBatch;
+
+void* __read_batch_worker(void* batch_ptr) {
+    __ReadBatch* batch = (__ReadBatch*)batch_ptr;
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        size_t i = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (i >= batch->n)
+            return NULL;
+        batch->errors[i] = __read_whole_file(batch->paths[i], &batch->out[i]);
+    }
+}
+
+/* Reads are dominated by waiting on the disk, so use more threads than cpus */
+#define __READ_BATCH_THREADS 16
+
+void __read_files_pool(const char** paths, size_t n, String* out, int* errors) {
+    __ReadBatch batch = { .paths=paths, .out=out, .errors=errors, .n=n, .next=0 };
+    pthread_mutex_init(&batch.lock, NULL);
+    size_t nthreads = n < __READ_BATCH_THREADS ? n : __READ_BATCH_THREADS;
+    pthread_t threads[__READ_BATCH_THREADS];
+    size_t spawned = 0;
+    for (; spawned + 1 < nthreads; spawned++) {
+        if (pthread_create(&threads[spawned], NULL, __read_batch_worker, &batch) != 0)
+            break;
+    }
+    __read_batch_worker(&batch);
+    for (size_t i = 0; i < spawned; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&batch.lock);
+}
+
+#ifdef UTILS_IO_URING
+/* Minimal io_uring submission and completion rings, mapped from the kernel */
+typedef struct {
+    int fd;
+    unsigned entries, to_submit;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    void* cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+} __Uring;
+
+void __uring_drop(__Uring* u) {
+    if (u->sqes != NULL && u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != NULL && u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != NULL && u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+}
+
+/* Check that the kernel supports every operation used to read files */
+uint8_t __uring_supports_ops(int fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (probe == NULL)
+        return 0;
+    uint8_t ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const uint8_t ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ };
+    for (size_t i = 0; ok && i < sizeof(ops); i++)
+        ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return ok;
+}
+
+/* Set up a ring of `entries` submissions, returning 0 or -1 if io_uring isn't available */
+int __uring_init(__Uring* u, unsigned entries) {
+    memset(u, 0, sizeof(*u));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    u->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (u->fd < 0)
+        return -1;
+    u->entries = params.sq_entries;
+    u->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size)
+            u->sq_ring_size = u->cq_ring_size;
+        u->cq_ring_size = u->sq_ring_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        __uring_drop(u);
+        return -1;
+    }
+    u->cq_ring = u->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          u->fd, IORING_OFF_CQ_RING);
+    }
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->fd, IORING_OFF_SQES);
+    if (u->cq_ring == MAP_FAILED || u->sqes == MAP_FAILED || !__uring_supports_ops(u->fd)) {
+        __uring_drop(u);
+        return -1;
+    }
+    char* sq = (char*)u->sq_ring;
+    char* cq = (char*)u->cq_ring;
+    u->sq_head = (unsigned*)(sq + params.sq_off.head);
+    u->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    u->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + params.sq_off.array);
+    u->cq_head = (unsigned*)(cq + params.cq_off.head);
+    u->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    u->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+/* Queue a zeroed submission, the caller keeps the ring from overfilling */
+struct io_uring_sqe* __uring_push(__Uring* u, uint8_t opcode, uint64_t user_data) {
+    unsigned tail = *u->sq_tail;
+    unsigned ind = tail & *u->sq_mask;
+    struct io_uring_sqe* sqe = &u->sqes[ind];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = user_data;
+    u->sq_array[ind] = ind;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->to_submit++;
+    return sqe;
+}
+
+/* State of a file read through the ring, tagged in `user_data` as `index * 4 + op` */
+typedef struct {
+    int fd, error;
+    uint8_t pending;
+    size_t total, cap;
+    char* data;
+    struct statx stx;
+} __UringFile;
+
+enum { __URING_OPEN, __URING_STATX, __URING_READ };
+
+void __uring_submit_read(__Uring* u, __UringFile* f, size_t ind) {
+    size_t remaining = (size_t)f->stx.stx_size - f->total;
+    struct io_uring_sqe* sqe = __uring_push(u, IORING_OP_READ, ind * 4 + __URING_READ);
+    sqe->fd = f->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(f->data + f->total);
+    sqe->len = remaining < (1u << 30) ? (unsigned)remaining : (1u << 30);
+    sqe->off = f->total;
+    f->pending = 1;
+}
+
+/* Read the files through io_uring, returning -1 (having read nothing) if it's unavailable */
+int __read_files_uring(const char** paths, size_t n, String* out, int* errors) {
+    __Uring u;
+    if (__uring_init(&u, 256) != 0)
+        return -1;
+    __UringFile* files = calloc(n, sizeof(__UringFile));
+    if (files == NULL) {
+        fprintf(stderr, "read_files_batch alloc failure\n");
+        abort();
+    }
+    /* every file in flight has at most 2 submissions queued */
+    size_t max_in_flight = u.entries / 2;
+    size_t next = 0, in_flight = 0, finished = 0;
+    while (finished < n) {
+        for (; next < n && in_flight < max_in_flight; next++, in_flight++) {
+            __UringFile* f = &files[next];
+            f->fd = -1;
+            f->pending = 2;
+            struct io_uring_sqe* sqe = __uring_push(&u, IORING_OP_OPENAT, next * 4 + __URING_OPEN);
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)paths[next];
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe = __uring_push(&u, IORING_OP_STATX, next * 4 + __URING_STATX);
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)paths[next];
+            sqe->len = STATX_SIZE;
+            sqe->off = (uint64_t)(uintptr_t)&f->stx;
+        }
+        int submitted = (int)syscall(__NR_io_uring_enter, u.fd, u.to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("io_uring_enter failure");
+            abort();
+        }
+        u.to_submit -= (unsigned)submitted;
+
+        unsigned head = *u.cq_head;
+        unsigned tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &u.cqes[head & *u.cq_mask];
+            size_t ind = (size_t)(cqe->user_data / 4);
+            __UringFile* f = &files[ind];
+            int res = cqe->res;
+            f->pending--;
+            switch (cqe->user_data % 4) {
+                case __URING_OPEN:
+                    if (res >= 0)
+                        f->fd = res;
+                    else
+                        f->error = -res;
+                    break;
+                case __URING_STATX:
+                    if (res < 0 && f->error == 0)
+                        f->error = -res;
+                    break;
+                default:
+                    if (res < 0)
+                        f->error = -res;
+                    else if (res == 0)
+                        f->stx.stx_size = f->total;  /* file shrank since it was measured */
+                    else
+                        f->total += (size_t)res;
+                    break;
+            }
+            if (f->pending > 0)
+                continue;
+            if (f->error == 0 && f->data == NULL) {
+                /* opened and measured */
+                f->cap = (size_t)f->stx.stx_size;
+                f->data = __buf_alloc(f->cap + 1);
+                if (f->data == NULL) {
+                    fprintf(stderr, "String alloc failure\n");
+                    abort();
+                }
+            }
+            if (f->error == 0 && f->total < (size_t)f->stx.stx_size) {
+                __uring_submit_read(&u, f, ind);
+                continue;
+            }
+            if (f->fd >= 0)
+                close(f->fd);
+            if (f->error == 0) {
+                f->data[f->total] = '\0';
+                String s = { .__data=f->data, .__len=f->total, .__cap=f->cap };
+                out[ind] = s;
+            } else if (f->data != NULL) {
+                __buf_free(f->data, f->cap + 1);
+            }
+            errors[ind] = f->error;
+            in_flight--;
+            finished++;
+        }
+        __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+    }
+    free(files);
+    __uring_drop(&u);
+    return 0;
+}
+#endif
+
+size_t read_files_batch(const char** paths, size_t n, String* out, int* errors) {
+    int* errs = errors;
+    if (errs == NULL) {
+        errs = malloc((n + 1) * sizeof(int));
+        if (errs == NULL) {
+            fprintf(stderr, "read_files_batch alloc failure\n");
+            abort();
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+        out[i] = string_new();
+#ifdef UTILS_IO_URING
+    if (n == 0 || __read_files_uring(paths, n, out, errs) != 0)
+        __read_files_pool(paths, n, out, errs);
+#else
+    __read_files_pool(paths, n, out, errs);
+#endif
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i++)
+        failed += errs[i] != 0;
+    if (errs != errors)
+        free(errs);
+    return failed;
+}
+
+
+/* ----------- MappedFile ------------- */
+
+
+MappedFile map_file(const char* path) {
+    return map_file_with_flags(path, 0);
+}
+
+MappedFile map_file_with_flags(const char* path, int flags) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening file");
+        abort();
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Error reading file");
+        abort();
+    }
+    MappedFile mf = { .__data=NULL, .__len=(size_t)st.st_size };
+    if (mf.__len == 0) {
+        /* zero length mappings aren't allowed, an empty file needs no memory anyway */
+        close(fd);
+        return mf;
+    }
+    int mmap_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (flags & MAP_FILE_POPULATE)
+        mmap_flags |= MAP_POPULATE;
+#endif
+    void* data = mmap(NULL, mf.__len, PROT_READ, mmap_flags, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping file");
+        abort();
+    }
+    madvise(data, mf.__len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if (flags & MAP_FILE_HUGE_PAGES)
+        madvise(data, mf.__len, MADV_HUGEPAGE);
+#endif
+    mf.__data = data;
+    return mf;
+}
+
+size_t mapped_file_len(MappedFile* mf) {
+    return mf->__len;
+}
+
+Str mapped_file_as_str(MappedFile* mf) {
+    Str str = { .__data=mf->__data == NULL ? "" : mf->__data, .__len=mf->__len };
+    return str;
+}
+
+void mapped_file_drop(void* mf_ptr) {
+    MappedFile* mf = (MappedFile*)mf_ptr;
+    if (mf->__data != NULL)
+        munmap((void*)mf->__data, mf->__len);
+    mf->__data = NULL;
+    mf->__len = 0;
+}
+
+
+/* ----------- LineReader ------------- */
+
+
+LineReader line_reader_new(int fd) {
+    return line_reader_with_block_size(fd, LINE_READER_BLOCK_SIZE);
+}
+
+LineReader line_reader_with_block_size(int fd, size_t block_size) {
+    if (block_size == 0)
+        block_size = LINE_READER_BLOCK_SIZE;
+    LineReader lr = {
+        .__fd=fd,
+        .__buf=malloc(block_size),
+        .__cap=block_size,
+        .__start=0,
+        .__end=0,
+        .__scan=0,
+        .__offset=-1,
+        .__eof=0,
+        .__error=0,
+    };
+    if (lr.__buf == NULL) {
+        fprintf(stderr, "LineReader alloc failure\n");
+        abort();
+    }
+    /* read-ahead hints only apply to seekable files, the offset stays -1 for pipes */
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset >= 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) == 0)
+        lr.__offset = (int64_t)offset;
+    return lr;
+}
+
+/* Move unconsumed data to the front of the buffer and read another block behind it,
+ * growing the buffer when it's entirely taken up by a single line
+ */
+void __line_reader_fill(LineReader* lr) {
+    size_t pending = lr->__end - lr->__start;
+    if (lr->__start > 0) {
+        memmove(lr->__buf, lr->__buf + lr->__start, pending);
+        lr->__scan -= lr->__start;
+        lr->__start = 0;
+        lr->__end = pending;
+    }
+    if (lr->__end == lr->__cap) {
+        char* buf = realloc(lr->__buf, lr->__cap * 2);
+        if (buf == NULL) {
+            fprintf(stderr, "LineReader resize failure\n");
+            abort();
+        }
+        lr->__buf = buf;
+        lr->__cap *= 2;
+    }
+    ssize_t n;
+    do {
+        n = read(lr->__fd, lr->__buf + lr->__end, lr->__cap - lr->__end);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n < 0)
+            lr->__error = errno;
+        lr->__eof = 1;
+        return;
+    }
+    lr->__end += (size_t)n;
+    if (lr->__offset >= 0) {
+        /* start fetching the following block while this one is processed */
+        lr->__offset += n;
+        posix_fadvise(lr->__fd, (off_t)lr->__offset, (off_t)lr->__cap, POSIX_FADV_WILLNEED);
+    }
+}
+
+uint8_t line_reader_done(LineReader* lr) {
+    while (lr->__start == lr->__end) {
+        if (lr->__eof)
+            return 1;
+        __line_reader_fill(lr);
+    }
+    return 0;
+}
+
+Str line_reader_next(LineReader* lr) {
+    for (;;) {
+        const char* newline = memchr(lr->__buf + lr->__scan, '\n', lr->__end - lr->__scan);
+        if (newline != NULL) {
+            size_t end = (size_t)(newline - lr->__buf);
+            Str line = { .__data=lr->__buf + lr->__start, .__len=end - lr->__start };
+            lr->__start = end + 1;
+            lr->__scan = lr->__start;
+            return line;
+        }
+        lr->__scan = lr->__end;
+        if (lr->__eof) {
+            Str line = { .__data=lr->__buf + lr->__start, .__len=lr->__end - lr->__start };
+            lr->__start = lr->__end;
+            return line;
+        }
+        __line_reader_fill(lr);
+    }
+}
+
+int line_reader_error(LineReader* lr) {
+    return lr->__error;
+}
+
+void line_reader_drop(void* lr_ptr) {
+    LineReader* lr = (LineReader*)lr_ptr;
+    free(lr->__buf);
+    lr->__buf = NULL;
+    lr->__cap = 0;
+    lr->__start = 0;
+    lr->__end = 0;
+    lr->__scan = 0;
+}
+
+
+/* ----------- BufWriter ------------- */
+
+
+BufWriter buf_writer_new(int fd) {
+    return buf_writer_with_capacity(fd, BUF_WRITER_CAPACITY);
+}
+
+BufWriter buf_writer_with_capacity(int fd, size_t cap) {
+    /* numbers are formatted in place, so always leave room for the longest one */
+    if (cap < __FMT_F64_MAX_LEN)
+        cap = __FMT_F64_MAX_LEN;
+    BufWriter w = {
+        .__fd=fd,
+        .__buf=malloc(cap),
+        .__cap=cap,
+        .__len=0,
+        .__error=0,
+        .__syscalls=0,
+    };
+    if (w.__buf == NULL) {
+        fprintf(stderr, "BufWriter alloc failure\n");
+        abort();
+    }
+    return w;
+}
+
+/* Write the buffered data followed by `len` bytes of `bytes`, emptying the buffer */
+void __buf_writer_write_through(BufWriter* w, const char* bytes, size_t len) {
+    if (w->__error != 0)
+        return;
+    struct iovec iov[2];
+    int count = 0;
+    if (w->__len > 0) {
+        iov[count].iov_base = w->__buf;
+        iov[count].iov_len = w->__len;
+        count++;
+    }
+    if (len > 0) {
+        iov[count].iov_base = (void*)bytes;
+        iov[count].iov_len = len;
+        count++;
+    }
+    if (__write_all_iov(w->__fd, iov, count, &w->__syscalls) != 0)
+        w->__error = errno;
+    w->__len = 0;
+}
+
+void buf_writer_write(BufWriter* w, const char* bytes, size_t len) {
+    if (w->__error != 0)
+        return;
+    /* large payloads go straight out with the buffered bytes in one writev, even
+     * when they'd fit, rather than being copied into the buffer first */
+    if (len >= w->__cap / 2) {
+        __buf_writer_write_through(w, bytes, len);
+        return;
+    }
+    if (len > w->__cap - w->__len) {
+        __buf_writer_write_through(w, NULL, 0);
+        if (w->__error != 0)
+            return;
+    }
+    memcpy(w->__buf + w->__len, bytes, len);
+    w->__len += len;
+}
+
+void buf_writer_write_char(BufWriter* w, char c) {
+    if (w->__len == w->__cap)
+        __buf_writer_write_through(w, NULL, 0);
+    if (w->__error != 0)
+        return;
+    w->__buf[w->__len++] = c;
+}
+
+void buf_writer_write_str(BufWriter* w, Str* str) {
+    buf_writer_write(w, str->__data, str->__len);
+}
+
+void buf_writer_write_string(BufWriter* w, String* s) {
+    buf_writer_write(w, s->__data, s->__len);
+}
+
+void buf_writer_write_cstr(BufWriter* w, const char* cstr) {
+    buf_writer_write(w, cstr, strlen(cstr));
+}
+
+/* Make sure `len` bytes can be formatted directly into the buffer */
+uint8_t __buf_writer_reserve(BufWriter* w, size_t len) {
+    if (len > w->__cap - w->__len)
+        __buf_writer_write_through(w, NULL, 0);
+    return w->__error == 0;
+}
+
+void buf_writer_write_u64(BufWriter* w, uint64_t v) {
+    if (__buf_writer_reserve(w, 20))
+        w->__len += __fmt_u64(w->__buf + w->__len, v);
+}
+
+void buf_writer_write_i64(BufWriter* w, int64_t v) {
+    if (__buf_writer_reserve(w, 20))
+        w->__len += __fmt_i64(w->__buf + w->__len, v);
+}
+
+void buf_writer_write_f64(BufWriter* w, double v) {
+    if (__buf_writer_reserve(w, __FMT_F64_MAX_LEN))
+        w->__len += __fmt_f64(w->__buf + w->__len, v);
+}
+
+int buf_writer_flush(BufWriter* w) {
+    if (w->__len > 0)
+        __buf_writer_write_through(w, NULL, 0);
+    if (w->__error != 0) {
+        errno = w->__error;
+        return -1;
+    }
+    return 0;
+}
+
+int buf_writer_error(BufWriter* w) {
+    return w->__error;
+}
+
+size_t buf_writer_syscalls(BufWriter* w) {
+    return w->__syscalls;
+}
+
+void buf_writer_drop(void* w_ptr) {
+    BufWriter* w = (BufWriter*)w_ptr;
+    if (w->__buf != NULL)
+        buf_writer_flush(w);
+    free(w->__buf);
+    w->__buf = NULL;
+    w->__cap = 0;
+    w->__len = 0;
+}
+
+
+/* ----------- Parallel ------------- */
+
+
+/* A newline-aligned range of lines, processed by one thread */
+typedef struct {
+    const char* data;
+    size_t len;
+    lineFn func;
+    void* ctx;
+} __LineChunk;
+
+void* __line_chunk_run(void* chunk_ptr) {
+    __LineChunk* chunk = (__LineChunk*)chunk_ptr;
+    const char* ptr = chunk->data;
+    const char* end = chunk->data + chunk->len;
+    while (ptr < end) {
+        const char* newline = memchr(ptr, '\n', (size_t)(end - ptr));
+        const char* line_end = newline == NULL ? end : newline;
+        Str line = { .__data=ptr, .__len=(size_t)(line_end - ptr) };
+        chunk->func(&line, chunk->ctx);
+        ptr = line_end + 1;
+    }
+    return NULL;
+}
+
+void parallel_for_lines(Str* s, size_t nthreads, lineFn func, void* ctxs, size_t ctx_size, mergeFn merge) {
+    if (nthreads == 0)
+        nthreads = 1;
+    __LineChunk* chunks = malloc(nthreads * sizeof(__LineChunk));
+    pthread_t* threads = malloc(nthreads * sizeof(pthread_t));
+    uint8_t* spawned = calloc(nthreads, sizeof(uint8_t));
+    if (chunks == NULL || threads == NULL || spawned == NULL) {
+        fprintf(stderr, "parallel_for_lines alloc failure\n");
+        abort();
+    }
+
+    /* split at even byte offsets, then push each split past the next newline */
+    size_t start = 0;
+    for (size_t i = 0; i < nthreads; i++) {
+        size_t end = i == nthreads - 1 ? s->__len : s->__len / nthreads * (i + 1);
+        if (end < start) {
+            end = start;  /* the previous chunk's last line ran past this split */
+        } else if (end > start && end < s->__len && s->__data[end - 1] != '\n') {
+            const char* newline = memchr(s->__data + end, '\n', s->__len - end);
+            end = newline == NULL ? s->__len : (size_t)(newline - s->__data) + 1;
+        }
+        chunks[i].data = s->__data + start;
+        chunks[i].len = end - start;
+        chunks[i].func = func;
+        chunks[i].ctx = (char*)ctxs + i * ctx_size;
+        start = end;
+    }
+
+    /* with more threads than lines, most chunks are empty and need no thread */
+    for (size_t i = 1; i < nthreads; i++) {
+        if (chunks[i].len > 0)
+            spawned[i] = pthread_create(&threads[i], NULL, __line_chunk_run, &chunks[i]) == 0;
+    }
+    __line_chunk_run(&chunks[0]);
+    for (size_t i = 1; i < nthreads; i++) {
+        if (spawned[i])
+            pthread_join(threads[i], NULL);
+        else if (chunks[i].len > 0)
+            __line_chunk_run(&chunks[i]);  /* couldn't start a thread, do the work here */
+    }
+
+    if (merge != NULL) {
+        for (size_t i = 1; i < nthreads; i++)
+            merge(ctxs, (char*)ctxs + i * ctx_size);
+    }
+    free(chunks);
+    free(threads);
+    free(spawned);
+}
+
+void parallel_for_lines_in_file(const char* path, size_t nthreads, lineFn func,
+                                void* ctxs, size_t ctx_size, mergeFn merge) {
+    MappedFile mf = map_file(path);
+    Str s = mapped_file_as_str(&mf);
+    parallel_for_lines(&s, nthreads, func, ctxs, ctx_size, merge);
+    mapped_file_drop(&mf);
+}
+
+
+/* ----------- StringInterner ------------- */
+
+
+StringInterner string_interner_new() {
+    StringInterner si = {
+        .__blocks=vec_new(sizeof(char*)),
+        .__cursor=NULL,
+        .__avail=0,
+        .__strs=vec_new(sizeof(Str)),
+        .__hashes=vec_new(sizeof(uint64_t)),
+        .__table=NULL,
+        .__table_cap=0,
+    };
+    return si;
+}
+
+size_t string_interner_len(StringInterner* si) {
+    return vec_len(&si->__strs);
+}
+
+/* Copy `len` bytes plus a trailing null byte into the arena */
+const char* __string_interner_alloc(StringInterner* si, const char* ptr, size_t len) {
+    if (len + 1 > si->__avail) {
+        size_t block_size = STRING_INTERNER_BLOCK_SIZE;
+        if (len + 1 > block_size)
+            block_size = len + 1;
+        char* block = malloc(block_size);
+        if (block == NULL) {
+            fprintf(stderr, "StringInterner alloc failure\n");
+            abort();
+        }
+        vec_push(&si->__blocks, &block);
+        si->__cursor = block;
+        si->__avail = block_size;
+    }
+    char* dest = si->__cursor;
+    memcpy(dest, ptr, len);
+    dest[len] = '\0';
+    si->__cursor += len + 1;
+    si->__avail -= len + 1;
+    return dest;
+}
+
+/* Return the table slot holding `str` or the empty slot where it belongs */
+size_t __string_interner_slot(StringInterner* si, Str* str, uint64_t hash) {
+    size_t mask = si->__table_cap - 1;
+    size_t slot = hash & mask;
+    while (1) {
+        uint32_t entry = si->__table[slot];
+        if (entry == 0)
+            return slot;
+        Symbol sym = entry - 1;
+        uint64_t* entry_hash = vec_index_ref_unchecked(&si->__hashes, sym);
+        Str* entry_str = vec_index_ref_unchecked(&si->__strs, sym);
+        if (*entry_hash == hash && entry_str->__len == str->__len
+                && memcmp(entry_str->__data, str->__data, str->__len) == 0)
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+}
+
+/* Double the lookup table capacity, reinserting existing symbols using their stored hashes */
+void __string_interner_grow_table(StringInterner* si) {
+    size_t new_cap = si->__table_cap == 0 ? 64 : si->__table_cap * 2;
+    uint32_t* table = calloc(new_cap, sizeof(uint32_t));
+    if (table == NULL) {
+        fprintf(stderr, "StringInterner alloc failure\n");
+        abort();
+    }
+    size_t mask = new_cap - 1;
+    size_t len = vec_len(&si->__hashes);
+    for (size_t sym = 0; sym < len; sym++) {
+        uint64_t hash = *(uint64_t*)vec_index_ref_unchecked(&si->__hashes, sym);
+        size_t slot = hash & mask;
+        while (table[slot] != 0)
+            slot = (slot + 1) & mask;
+        table[slot] = (uint32_t)sym + 1;
+    }
+    free(si->__table);
+    si->__table = table;
+    si->__table_cap = new_cap;
+}
+
+Symbol string_interner_intern(StringInterner* si, Str* str) {
+    /* keep the table at most half full so probe sequences stay short */
+    if ((vec_len(&si->__strs) + 1) * 2 > si->__table_cap)
+        __string_interner_grow_table(si);
+
+    uint64_t hash = str_hash(str);
+    size_t slot = __string_interner_slot(si, str, hash);
+    if (si->__table[slot] != 0)
+        return si->__table[slot] - 1;
+
+    size_t len = vec_len(&si->__strs);
+    if (len >= UINT32_MAX - 1) {
+        fprintf(stderr, "StringInterner symbol overflow\n");
+        abort();
+    }
+    Str interned = str_from_ptr_len(__string_interner_alloc(si, str->__data, str->__len), str->__len);
+    vec_push(&si->__strs, &interned);
+    vec_push(&si->__hashes, &hash);
+    si->__table[slot] = (uint32_t)len + 1;
+    return (Symbol)len;
+}
+
+Symbol string_interner_intern_cstr(StringInterner* si, const char* cstr) {
+    Str str = str_from_cstr(cstr);
+    return string_interner_intern(si, &str);
+}
+
+uint8_t string_interner_get(StringInterner* si, Str* str, Symbol* sym) {
+    if (si->__table_cap == 0)
+        return 0;
+    size_t slot = __string_interner_slot(si, str, str_hash(str));
+    if (si->__table[slot] == 0)
+        return 0;
+    *sym = si->__table[slot] - 1;
+    return 1;
+}
+
+Str string_interner_resolve(StringInterner* si, Symbol sym) {
+    return *(Str*)vec_index_ref(&si->__strs, sym);
+}
+
+void string_interner_drop(void* interner_ptr) {
+    StringInterner* si = (StringInterner*)interner_ptr;
+    size_t num_blocks = vec_len(&si->__blocks);
+    for (size_t i = 0; i < num_blocks; i++) {
+        free(*(char**)vec_index_ref_unchecked(&si->__blocks, i));
+    }
+    vec_drop(&si->__blocks);
+    vec_drop(&si->__strs);
+    vec_drop(&si->__hashes);
+    free(si->__table);
+    si->__table = NULL;
+    si->__table_cap = 0;
+    si->__cursor = NULL;
+    si->__avail = 0;
+}
+
+uint8_t symbol_eq(void* sym1, void* sym2) {
+    return *(Symbol*)sym1 != *(Symbol*)sym2;
+}
+
+uint64_t symbol_hash(void* sym) {
+    /* symbols are dense small integers, so they're already perfectly distributed
+     * across the `HashMap`'s `hash % buckets` indexing */
+    return *(Symbol*)sym;
+}
+
+
+/* ----------- CsvReader ------------- */
+
+
+CsvReader csv_reader_new(Str* input, char delim) {
+    CsvReader r = {
+        .__data=input->__data,
+        .__len=input->__len,
+        .__pos=0,
+        .__block=0,
+        .__bits_base=0,
+        .__bits=0,
+        .__quote_carry=0,
+        .__delim=delim,
+        .__fields=vec_new(sizeof(Str)),
+        .__escaped=vec_new(sizeof(size_t)),
+        .__scratch=string_new(),
+    };
+    return r;
+}
+
+uint8_t csv_reader_done(CsvReader* r) {
+    return r->__pos >= r->__len;
+}
+
+/* Set bit `i` for each byte `i` of a 64 byte block equal to `c` */
+uint64_t __csv_eq_mask(const char* block, char c) {
+    uint64_t mask = 0;
+#ifdef __SSE2__
+    __m128i needle = _mm_set1_epi8(c);
+    for (size_t i = 0; i < 4; i++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(block + i * 16));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle)) << (i * 16);
+    }
+#else
+    for (size_t i = 0; i < 64; i++)
+        mask |= (uint64_t)(block[i] == c) << i;
+#endif
+    return mask;
+}
+
+/* Classify a 64 byte block, returning a bitmask of the delimiters and
+ * newlines outside of quotes. Which bytes are quoted is the prefix xor of the
+ * quote bitmask, carried between blocks through `quote_carry` (all ones when
+ * the previous block ended inside a quoted field). Escaped `""` quotes toggle
+ * the state twice and so need no special handling.
+ */
+uint64_t __csv_classify(const char* block, char delim, uint64_t* quote_carry) {
+    uint64_t quoted = __csv_eq_mask(block, '"');
+    quoted ^= quoted << 1;
+    quoted ^= quoted << 2;
+    quoted ^= quoted << 4;
+    quoted ^= quoted << 8;
+    quoted ^= quoted << 16;
+    quoted ^= quoted << 32;
+    quoted ^= *quote_carry;
+    *quote_carry = (uint64_t)((int64_t)quoted >> 63);
+    return (__csv_eq_mask(block, delim) | __csv_eq_mask(block, '\n')) & ~quoted;
+}
+
+/* Return the index of the next unquoted delimiter or newline, or the input length */
+size_t __csv_next_structural(CsvReader* r) {
+    while (r->__bits == 0) {
+        if (r->__block >= r->__len)
+            return r->__len;
+        const char* block = r->__data + r->__block;
+        char tail[64];
+        if (r->__len - r->__block < 64) {
+            /* pad the last partial block with bytes that are never structural */
+            memset(tail, '\0', sizeof(tail));
+            memcpy(tail, block, r->__len - r->__block);
+            block = tail;
+        }
+        r->__bits = __csv_classify(block, r->__delim, &r->__quote_carry);
+        r->__bits_base = r->__block;
+        r->__block += 64;
+    }
+    size_t ind = r->__bits_base + (size_t)__ctz64(r->__bits);
+    r->__bits &= r->__bits - 1;
+    return ind;
+}
+
+/* Push the raw field `__data[start..end]`, stripping quotes and unescaping `""` */
+void __csv_push_field(CsvReader* r, size_t start, size_t end, uint8_t last) {
+    const char* ptr = r->__data + start;
+    size_t len = end - start;
+    if (last && len > 0 && ptr[len - 1] == '\r')
+        len--;
+    if (len > 0 && ptr[0] == '"') {
+        ptr++;
+        len--;
+        if (len > 0 && ptr[len - 1] == '"')
+            len--;
+        if (memchr(ptr, '"', len) != NULL) {
+            /* the scratch buffer may move while the row is read, so
+             * record offsets now and point fields at it afterwards */
+            String* scratch = &r->__scratch;
+            size_t offset = scratch->__len;
+            vec_push(&r->__escaped, &offset);
+            for (size_t i = 0; i < len; i++) {
+                string_push_char(scratch, ptr[i]);
+                if (ptr[i] == '"' && i + 1 < len && ptr[i + 1] == '"')
+                    i++;
+            }
+            Str field = { .__data=NULL, .__len=scratch->__len - offset };
+            vec_push(&r->__fields, &field);
+            return;
+        }
+    }
+    Str field = { .__data=ptr, .__len=len };
+    vec_push(&r->__fields, &field);
+}
+
+Slice csv_reader_next_row(CsvReader* r) {
+    r->__fields.__len = 0;
+    r->__escaped.__len = 0;
+    r->__scratch.__len = 0;
+    size_t start = r->__pos;
+    while (start <= r->__len) {
+        size_t end = __csv_next_structural(r);
+        uint8_t last = end >= r->__len || r->__data[end] == '\n';
+        __csv_push_field(r, start, end, last);
+        start = end + 1;
+        if (last)
+            break;
+    }
+    r->__pos = start;
+
+    size_t escaped_ind = 0;
+    for (size_t i = 0; escaped_ind < r->__escaped.__len && i < r->__fields.__len; i++) {
+        Str* field = vec_index_ref_unchecked(&r->__fields, i);
+        if (field->__data == NULL) {
+            size_t* offset = vec_index_ref_unchecked(&r->__escaped, escaped_ind++);
+            field->__data = r->__scratch.__data + *offset;
+        }
+    }
+    return vec_as_slice(&r->__fields);
+}
+
+void csv_reader_drop(void* r_ptr) {
+    CsvReader* r = (CsvReader*)r_ptr;
+    vec_drop(&r->__fields);
+    vec_drop(&r->__escaped);
+    string_drop(&r->__scratch);
+}
+
+
+/* ----------- MultiPattern ------------- */
+
+#define __MULTI_PATTERN_NONE UINT32_MAX
+
+void* __multi_pattern_alloc(size_t size) {
+    void* ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "MultiPattern alloc failure\n");
+        abort();
+    }
+    return ptr;
+}
+
+MultiPattern multi_pattern_new(Vec* patterns) {
+    MultiPattern mp;
+    size_t num_patterns = vec_len(patterns);
+    mp.__num_patterns = num_patterns;
+    mp.__pattern_lens = __multi_pattern_alloc((num_patterns + 1) * sizeof(size_t));
+
+    /* bytes that never appear in a pattern share class 0 */
+    memset(mp.__classes, 0, sizeof(mp.__classes));
+    uint8_t starts[256] = {0};
+    size_t num_classes = 1, total_len = 0;
+    for (size_t p = 0; p < num_patterns; p++) {
+        Str* pattern = vec_index_ref_unchecked(patterns, p);
+        mp.__pattern_lens[p] = pattern->__len;
+        total_len += pattern->__len;
+        if (pattern->__len > 0)
+            starts[(uint8_t)pattern->__data[0]] = 1;
+        for (size_t i = 0; i < pattern->__len; i++) {
+            uint8_t b = (uint8_t)pattern->__data[i];
+            /* if all 256 byte values are used, the last one seen keeps class 0 to itself */
+            if (mp.__classes[b] == 0 && num_classes < 256)
+                mp.__classes[b] = (uint8_t)num_classes++;
+        }
+    }
+    mp.__num_classes = num_classes;
+    mp.__num_start_bytes = 0;
+    for (size_t b = 0; b < 256; b++) {
+        if (starts[b] && mp.__num_start_bytes++ < 3)
+            mp.__start_bytes[mp.__num_start_bytes - 1] = (uint8_t)b;
+    }
+    if (mp.__num_start_bytes > 3)
+        mp.__num_start_bytes = 0;
+
+    size_t max_states = total_len + 1;
+    if (max_states > UINT32_MAX) {
+        fprintf(stderr, "MultiPattern too many states\n");
+        abort();
+    }
+    uint32_t* delta = calloc(max_states * num_classes, sizeof(uint32_t));
+    if (delta == NULL) {
+        fprintf(stderr, "MultiPattern alloc failure\n");
+        abort();
+    }
+    uint32_t* own = __multi_pattern_alloc(max_states * sizeof(uint32_t));
+    own[0] = __MULTI_PATTERN_NONE;
+
+    /* build the trie, where a transition to the root (0) means no child yet */
+    size_t num_states = 1;
+    for (size_t p = 0; p < num_patterns; p++) {
+        Str* pattern = vec_index_ref_unchecked(patterns, p);
+        if (pattern->__len == 0)
+            continue;
+        uint32_t state = 0;
+        for (size_t i = 0; i < pattern->__len; i++) {
+            uint32_t* next = &delta[state * num_classes + mp.__classes[(uint8_t)pattern->__data[i]]];
+            if (*next == 0) {
+                own[num_states] = __MULTI_PATTERN_NONE;
+                *next = (uint32_t)num_states++;
+            }
+            state = *next;
+        }
+        if (own[state] == __MULTI_PATTERN_NONE)
+            own[state] = (uint32_t)p;
+    }
+
+    /* breadth first, fill in missing transitions from each state's failure
+     * state, whose row is already complete since it's shallower */
+    uint32_t* fail = __multi_pattern_alloc(num_states * sizeof(uint32_t));
+    uint32_t* queue = __multi_pattern_alloc(num_states * sizeof(uint32_t));
+    uint32_t* dict = __multi_pattern_alloc(num_states * sizeof(uint32_t));
+    size_t head = 0, tail = 0;
+    dict[0] = __MULTI_PATTERN_NONE;
+    for (size_t c = 0; c < num_classes; c++) {
+        uint32_t child = delta[c];
+        if (child != 0) {
+            fail[child] = 0;
+            dict[child] = __MULTI_PATTERN_NONE;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        uint32_t* row = &delta[state * num_classes];
+        uint32_t* fail_row = &delta[fail[state] * num_classes];
+        for (size_t c = 0; c < num_classes; c++) {
+            uint32_t child = row[c];
+            if (child == 0) {
+                row[c] = fail_row[c];
+                continue;
+            }
+            uint32_t child_fail = fail_row[c];
+            fail[child] = child_fail;
+            dict[child] = own[child_fail] != __MULTI_PATTERN_NONE ? child_fail : dict[child_fail];
+            queue[tail++] = child;
+        }
+    }
+    free(fail);
+    free(queue);
+
+    /* the first state reporting a match from each state, so the scan checks one entry per byte */
+    uint32_t* output = __multi_pattern_alloc(num_states * sizeof(uint32_t));
+    for (size_t st = 0; st < num_states; st++)
+        output[st] = own[st] != __MULTI_PATTERN_NONE ? (uint32_t)st : dict[st];
+    mp.__delta = realloc(delta, num_states * num_classes * sizeof(uint32_t));
+    mp.__own = realloc(own, num_states * sizeof(uint32_t));
+    if (mp.__delta == NULL || mp.__own == NULL) {
+        fprintf(stderr, "MultiPattern alloc failure\n");
+        abort();
+    }
+    mp.__dict = dict;
+    mp.__output = output;
+    mp.__num_states = num_states;
+    return mp;
+}
+
+size_t multi_pattern_len(MultiPattern* mp) {
+    return mp->__num_patterns;
+}
+
+/* Return the index of the first byte at or after `ind` equal to one of the
+ * `num_bytes` (1 to 3) bytes in `bytes`, or `len` when there is none
+ */
+size_t __find_any_byte(const char* data, size_t len, size_t ind, const uint8_t* bytes, size_t num_bytes) {
+    uint8_t b0 = bytes[0];
+    uint8_t b1 = num_bytes > 1 ? bytes[1] : b0;
+    uint8_t b2 = num_bytes > 2 ? bytes[2] : b0;
+#ifdef __SSE2__
+    __m128i n0 = _mm_set1_epi8((char)b0), n1 = _mm_set1_epi8((char)b1), n2 = _mm_set1_epi8((char)b2);
+    for (; ind + 16 <= len; ind += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + ind));
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(chunk, n0),
+                                  _mm_or_si128(_mm_cmpeq_epi8(chunk, n1), _mm_cmpeq_epi8(chunk, n2)));
+        int mask = _mm_movemask_epi8(eq);
+        if (mask != 0)
+            return ind + (size_t)__ctz64((uint64_t)mask);
+    }
+#endif
+    for (; ind < len; ind++) {
+        uint8_t b = (uint8_t)data[ind];
+        if (b == b0 || b == b1 || b == b2)
+            return ind;
+    }
+    return len;
+}
+
+/* Run the automaton over `haystack`. Every match is pushed onto `all` when
+ * it's non-NULL, otherwise the scan stops at the first match, stored in `first`.
+ * Returns the number of matches found.
+ */
+size_t __multi_pattern_scan(MultiPattern* mp, Str* haystack, Vec* all, PatternMatch* first) {
+    const char* data = haystack->__data;
+    size_t len = haystack->__len;
+    size_t num_classes = mp->__num_classes;
+    size_t found = 0;
+    uint32_t state = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (state == 0 && mp->__num_start_bytes > 0) {
+            i = __find_any_byte(data, len, i, mp->__start_bytes, mp->__num_start_bytes);
+            if (i >= len)
+                break;
+        }
+        state = mp->__delta[state * num_classes + mp->__classes[(uint8_t)data[i]]];
+        uint32_t out = mp->__output[state];
+        if (out == __MULTI_PATTERN_NONE)
+            continue;
+        for (; out != __MULTI_PATTERN_NONE; out = mp->__dict[out]) {
+            uint32_t pattern = mp->__own[out];
+            PatternMatch m = { .pattern=pattern, .start=i + 1 - mp->__pattern_lens[pattern], .end=i + 1 };
+            found++;
+            if (all == NULL) {
+                if (first != NULL)
+                    *first = m;
+                return found;
+            }
+            vec_push(all, &m);
+        }
+    }
+    return found;
+}
+
+uint8_t multi_pattern_is_match(MultiPattern* mp, Str* haystack) {
+    return __multi_pattern_scan(mp, haystack, NULL, NULL) > 0;
+}
+
+uint8_t multi_pattern_find_first(MultiPattern* mp, Str* haystack, PatternMatch* m) {
+    return __multi_pattern_scan(mp, haystack, NULL, m) > 0;
+}
+
+Vec multi_pattern_find_all(MultiPattern* mp, Str* haystack) {
+    Vec matches = vec_new(sizeof(PatternMatch));
+    __multi_pattern_scan(mp, haystack, &matches, NULL);
+    return matches;
+}
+
+size_t multi_pattern_memory_usage(MultiPattern* mp) {
+    return sizeof(MultiPattern)
+        + mp->__num_states * mp->__num_classes * sizeof(uint32_t)
+        + mp->__num_states * 3 * sizeof(uint32_t)
+        + (mp->__num_patterns + 1) * sizeof(size_t);
+}
+
+void multi_pattern_drop(void* mp_ptr) {
+    MultiPattern* mp = (MultiPattern*)mp_ptr;
+    free(mp->__delta);
+    free(mp->__own);
+    free(mp->__dict);
+    free(mp->__output);
+    free(mp->__pattern_lens);
+    mp->__delta = NULL;
+    mp->__own = NULL;
+    mp->__dict = NULL;
+    mp->__output = NULL;
+    mp->__pattern_lens = NULL;
+    mp->__num_states = 0;
+}
+
+
+/* ----------- Vec ------------- */
+
+
+Vec vec_new(size_t item_size) {
+    Vec v = { .__data=NULL, .__item_size=item_size, .__len=0, .__cap=0 };
+    return v;
+}
+
+Vec vec_with_capacity(size_t item_size, size_t cap) {
+    void* data = __buf_alloc(cap * item_size);
+    if (data == NULL) {
+        fprintf(stderr, "Vec alloc failure\n");
+        abort();
+    }
+    Vec v = { .__data=data, .__item_size=item_size, .__len=0, .__cap=cap };
+    return v;
+}
+
+Vec vec_copy(Vec* src) {
+    size_t len = vec_len(src);
+    size_t item_size = src->__item_size;
+    Vec v = vec_with_capacity(item_size, len);
+    v.__len = len;
+    memcpy(v.__data, src->__data, len * item_size);
+    return v;
+}
+
+size_t vec_len(Vec* v) {
+    return v->__len;
+}
+
+size_t vec_cap(Vec* v) {
+    return v->__cap;
+}
+
+void vec_resize(Vec* v, size_t new_cap) {
+    if (new_cap == 0)
+        new_cap = 16;
+
+    void* data = __buf_realloc(v->__data, v->__cap * v->__item_size, new_cap * v->__item_size);
+    if (data == NULL) {
+        fprintf(stderr, "Vec resize failure\n");
+        abort();
+    }
+    v->__data = data;
+    v->__cap = new_cap;
+}
+
+void __vec_check_resize(Vec* v) {
+    size_t avail = v->__cap - v->__len;
+    if (avail == 0) {
+        size_t new_cap = __inc_cap(v->__cap);
+        vec_resize(v, new_cap);
+    }
+}
+
+void vec_reserve(Vec* v, size_t additional) {
+    size_t avail = v->__cap - v->__len;
+    if (additional > avail) {
+        size_t new_cap = __inc_cap(v->__cap);
+        if (additional > (new_cap - v->__len)) {
+            new_cap += additional - (new_cap - v->__len);
+        }
+        vec_resize(v, new_cap);
+    }
+}
+
+void vec_extend_from_slice(Vec* v, Slice* sl) {
+    if (sl->__item_size != v->__item_size) {
+        fprintf(stderr, "Mismatched item size: vec: %lu, slice: %lu\n", v->__item_size, sl->__item_size);
+        abort();
+    }
+    if (sl->__len == 0)
+        return;
+    const char* src = sl->__data;
+    char* data = v->__data;
+    /* the slice may view this `Vec`, which resizing can move */
+    uint8_t aliased = data != NULL && src >= data && src < data + v->__cap * v->__item_size;
+    size_t src_offset = aliased ? (size_t)(src - data) : 0;
+    vec_reserve(v, sl->__len);
+    if (aliased)
+        src = (char*)v->__data + src_offset;
+    memcpy((char*)v->__data + v->__len * v->__item_size, src, sl->__len * v->__item_size);
+    v->__len += sl->__len;
+}
+
+void vec_push(Vec* v, void* obj) {
+    __vec_check_resize(v);
+    char* offset = (char*)v->__data + (v->__len * v->__item_size);
+    memcpy((void*)offset, obj, v->__item_size);
+    v->__len++;
+}
+
+void vec_insert(Vec* v, void* obj, size_t ind) {
+    if (ind > v->__len) {
+        fprintf(stderr, "Out of bounds (ind > len): veclen: %lu, insert-index: %lu\n", v->__len, ind);
+        abort();
+    }
+    __vec_check_resize(v);
+    size_t trailing_elems = v->__len - ind;
+    char* insert_ptr = (char*)v->__data + (ind * v->__item_size);
+    char* offset_ptr = insert_ptr + v->__item_size;
+    memmove(offset_ptr, insert_ptr, (trailing_elems * v->__item_size));
+    memcpy((void*)insert_ptr, obj, v->__item_size);
+    v->__len++;
+}
+
+void vec_remove(Vec* v, size_t ind) {
+    if (ind >= v->__len) {
+        fprintf(stderr, "Out of bounds (ind >= len): veclen: %lu, insert-index: %lu\n", v->__len, ind);
+        abort();
+    }
+    size_t trailing_elems = v->__len - 1 - ind;
+    if (trailing_elems == 0) {
+        v->__len--;
+    } else {
+        char* dest_ptr = (char*)v->__data + (ind * v->__item_size);
+        char* src_ptr = dest_ptr + v->__item_size;
+        memmove(dest_ptr, src_ptr, (trailing_elems * v->__item_size));
+        v->__len--;
+    }
+}
+
+void vec_remove_with(Vec* v, size_t ind, mapFn drop) {
+    if (ind >= v->__len) {
+        fprintf(stderr, "Out of bounds (ind >= len): veclen: %lu, insert-index: %lu\n", v->__len, ind);
+        abort();
+    }
+    char* remove_ptr = (char*)v->__data + (ind * v->__item_size);
+    drop((void*)remove_ptr);
+    vec_remove(v, ind);
+}
+
+void vec_swap_remove(Vec* v, size_t ind) {
+    if (ind >= v->__len) {
+        fprintf(stderr, "Out of bounds (ind >= len): veclen: %lu, remove-index: %lu\n", v->__len, ind);
+        abort();
+    }
+    v->__len--;
+    if (ind != v->__len) {
+        char* dest_ptr = (char*)v->__data + (ind * v->__item_size);
+        char* last_ptr = (char*)v->__data + (v->__len * v->__item_size);
+        memcpy(dest_ptr, last_ptr, v->__item_size);
+    }
+}
+
+void vec_swap_remove_with(Vec* v, size_t ind, mapFn drop) {
+    if (ind >= v->__len) {
+        fprintf(stderr, "Out of bounds (ind >= len): veclen: %lu, remove-index: %lu\n", v->__len, ind);
+        abort();
+    }
+    char* remove_ptr = (char*)v->__data + (ind * v->__item_size);
+    drop((void*)remove_ptr);
+    vec_swap_remove(v, ind);
+}
+
+void vec_truncate(Vec* v, size_t len) {
+    if (len < v->__len)
+        v->__len = len;
+}
+
+void vec_truncate_with(Vec* v, size_t len, mapFn drop) {
+    for (size_t i = len; i < v->__len; i++)
+        drop((char*)v->__data + (i * v->__item_size));
+    vec_truncate(v, len);
+}
+
+void vec_shrink_to_fit(Vec* v) {
+    if (v->__data == NULL || v->__len == v->__cap)
+        return;
+    if (v->__len == 0) {
+        __buf_free(v->__data, v->__cap * v->__item_size);
+        v->__data = NULL;
+        v->__cap = 0;
+        return;
+    }
+    vec_resize(v, v->__len);
+}
+
+void* vec_index_ref(Vec* v, size_t ind) {
+    if (ind >= v->__len) {
+        fprintf(stderr, "Out of bounds: veclen: %lu, index: %lu\n", v->__len, ind);
+        abort();
+    }
+    char* offset = (char*)v->__data + (ind * v->__item_size);
+    return (void*)offset;
+}
+
+inline void* vec_index_ref_unchecked(Vec* v, size_t ind) {
+    char* offset = (char*)v->__data + (ind * v->__item_size);
+    return (void*)offset;
+}
+
+void vec_iter_ref(Vec* v, mapFn func) {
+    size_t len = vec_len(v);
+    for (size_t i = 0; i < len; i++) {
+        void* ref = vec_index_ref(v, i);
+        func(ref);
+    }
+}
+
+uint8_t vec_eq(void* v1_, void* v2_, cmpEq cmp_func) {
+    Vec* v1 = (Vec*)v1_;
+    Vec* v2 = (Vec*)v2_;
+    if (v1 == v2)
+        return 0;
+
+    size_t len = vec_len(v1);
+    if (len != vec_len(v2))
+        return 1;
+
+    for (size_t i = 0; i < len; i++) {
+        void* a = vec_index_ref(v1, i);
+        void* b = vec_index_ref(v2, i);
+        if (cmp_func(a, b))
+            return 1;
+    }
+    return 0;
+}
+
+uint64_t vec_hash_with(void* v, hashFn hash_func) {
+    size_t len = vec_len(v);
+    uint64_t hash = 17;
+    for (size_t i = 0; i < len; i++) {
+        void* ref = vec_index_ref(v, i);
+        hash = hash * 31 + hash_func(ref);
+    }
+    return hash;
+}
+
+void vec_clear(Vec* v, mapFn drop) {
+    if (v->__data == NULL)
+        return;
+    vec_iter_ref(v, drop);
+    v->__len = 0;
+}
+
+void vec_drop(void* vec_ptr) {
+    Vec* v = (Vec*)vec_ptr;
+    if (v->__data == NULL)
+        return;
+    __buf_free(v->__data, v->__cap * v->__item_size);
+    v->__len = 0;
+    v->__cap = 0;
+}
+
+void vec_drop_with(Vec* v, mapFn drop) {
+    if (v->__data == NULL)
+        return;
+    vec_iter_ref(v, drop);
+    __buf_free(v->__data, v->__cap * v->__item_size);
+    v->__len = 0;
+    v->__cap = 0;
+}
+
+Slice vec_as_slice(Vec* v) {
+    Slice sl = {
+        .__data=v->__data,
+        .__item_size=v->__item_size,
+        .__len=v->__len,
+    };
+    return sl;
+}
+
+SliceIter vec_iter(Vec* v) {
+    SliceIter iter = {
+        .__data=v->__data,
+        .__item_size=v->__item_size,
+        .__len=v->__len,
+        .__ind=0,
+    };
+    return iter;
+}
+
+
+/* ----------- Vec sorting ------------- */
+
+/* Element moves dominate sorting generic items. Fixed-size `memcpy`s compile
+ * to plain loads and stores, so the common item sizes get their own cases.
+ */
+void __elem_copy(void* dst, const void* src, size_t size) {
+    switch (size) {
+        case 4: memcpy(dst, src, 4); break;
+        case 8: memcpy(dst, src, 8); break;
+        case 16: memcpy(dst, src, 16); break;
+        default: memcpy(dst, src, size); break;
+    }
+}
+
+void __elem_swap(void* a, void* b, void* tmp, size_t size) {
+    __elem_copy(tmp, a, size);
+    __elem_copy(a, b, size);
+    __elem_copy(b, tmp, size);
+}
+
+/* Elements at or below this count are insertion sorted */
+#define __SORT_INSERTION_THRESHOLD 24
+/* Partitions above this size pick their pivot with Tukey's ninther */
+#define __SORT_NINTHER_THRESHOLD 128
+/* Element moves allowed before a partial insertion sort gives up */
+#define __SORT_PARTIAL_INSERTION_LIMIT 8
+
+typedef struct {
+    char* base;
+    size_t size;
+    cmpFn cmp;
+    char* pivot;
+    char* tmp;
+} __SortCtx;
+
+#define __SORT_AT(ctx, i) ((ctx)->base + (i) * (ctx)->size)
+
+int __sort_less(__SortCtx* ctx, void* a, void* b) {
+    return ctx->cmp(a, b) == CMP_LESS;
+}
+
+void __sort_swap(__SortCtx* ctx, size_t a, size_t b) {
+    __elem_swap(__SORT_AT(ctx, a), __SORT_AT(ctx, b), ctx->tmp, ctx->size);
+}
+
+void __sort2(__SortCtx* ctx, size_t a, size_t b) {
+    if (__sort_less(ctx, __SORT_AT(ctx, b), __SORT_AT(ctx, a)))
+        __sort_swap(ctx, a, b);
+}
+
+void __sort3(__SortCtx* ctx, size_t a, size_t b, size_t c) {
+    __sort2(ctx, a, b);
+    __sort2(ctx, b, c);
+    __sort2(ctx, a, b);
+}
+
+/* Insertion sort of [begin, end). When `guarded` is zero, the element
+ * before `begin` must be no greater than any element in the range,
+ * which removes the bounds check from the inner loop.
+ */
+void __sort_insertion(__SortCtx* ctx, size_t begin, size_t end, int guarded) {
+    size_t size = ctx->size;
+    for (size_t cur = begin + 1; cur < end; cur++) {
+        char* sift = __SORT_AT(ctx, cur);
+        if (!__sort_less(ctx, sift, sift - size))
+            continue;
+        __elem_copy(ctx->pivot, sift, size);
+        do {
+            __elem_copy(sift, sift - size, size);
+            sift -= size;
+        } while ((!guarded || sift != __SORT_AT(ctx, begin)) && __sort_less(ctx, ctx->pivot, sift - size));
+        __elem_copy(sift, ctx->pivot, size);
+    }
+}
+
+/* Insertion sort that gives up after `__SORT_PARTIAL_INSERTION_LIMIT` moves,
+ * returning whether the range was sorted.
+ */
+int __sort_partial_insertion(__SortCtx* ctx, size_t begin, size_t end) {
+    size_t size = ctx->size;
+    size_t moves = 0;
+    for (size_t cur = begin + 1; cur < end; cur++) {
+        char* sift = __SORT_AT(ctx, cur);
+        if (!__sort_less(ctx, sift, sift - size))
+            continue;
+        __elem_copy(ctx->pivot, sift, size);
+        do {
+            __elem_copy(sift, sift - size, size);
+            sift -= size;
+        } while (sift != __SORT_AT(ctx, begin) && __sort_less(ctx, ctx->pivot, sift - size));
+        __elem_copy(sift, ctx->pivot, size);
+        moves += (size_t)(__SORT_AT(ctx, cur) - sift) / size;
+        if (moves > __SORT_PARTIAL_INSERTION_LIMIT)
+            return 0;
+    }
+    return 1;
+}
+
+void __sort_sift_down(__SortCtx* ctx, size_t begin, size_t root, size_t n) {
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= n)
+            return;
+        if (child + 1 < n && __sort_less(ctx, __SORT_AT(ctx, begin + child), __SORT_AT(ctx, begin + child + 1)))
+            child++;
+        if (!__sort_less(ctx, __SORT_AT(ctx, begin + root), __SORT_AT(ctx, begin + child)))
+            return;
+        __sort_swap(ctx, begin + root, begin + child);
+        root = child;
+    }
+}
+
+void __sort_heapsort(__SortCtx* ctx, size_t begin, size_t end) {
+    size_t n = end - begin;
+    for (size_t i = n / 2; i > 0; i--)
+        __sort_sift_down(ctx, begin, i - 1, n);
+    for (size_t i = n - 1; i > 0; i--) {
+        __sort_swap(ctx, begin, begin + i);
+        __sort_sift_down(ctx, begin, 0, i);
+    }
+}
+
+/* Swap `num` pairs of misplaced elements found by `__sort_partition_right`,
+ * at `left_base + offsets_l[i]` and `right_base - offsets_r[i]`. Unless the counts
+ * match, which descending inputs need to stay O(n), the elements are rotated
+ * through a single temporary, one move per element instead of three.
+ */
+void __sort_swap_offsets(__SortCtx* ctx, size_t left_base, size_t right_base,
+        unsigned char* offsets_l, unsigned char* offsets_r, size_t num, int use_swaps) {
+    if (use_swaps) {
+        for (size_t i = 0; i < num; i++)
+            __sort_swap(ctx, left_base + offsets_l[i], right_base - offsets_r[i]);
+    } else if (num > 0) {
+        size_t size = ctx->size;
+        char* l = __SORT_AT(ctx, left_base + offsets_l[0]);
+        char* r = __SORT_AT(ctx, right_base - offsets_r[0]);
+        __elem_copy(ctx->tmp, l, size);
+        __elem_copy(l, r, size);
+        for (size_t i = 1; i < num; i++) {
+            l = __SORT_AT(ctx, left_base + offsets_l[i]);
+            __elem_copy(r, l, size);
+            r = __SORT_AT(ctx, right_base - offsets_r[i]);
+            __elem_copy(l, r, size);
+        }
+        __elem_copy(r, ctx->tmp, size);
+    }
+}
+
+/* Elements classified per block by the branchless partition */
+#define __SORT_BLOCK_SIZE 64
+
+/* Partition [begin, end) around the pivot at `begin`, placing elements equal
+ * to the pivot on the right. Returns the final pivot position and sets
+ * `already_partitioned` when no elements had to be swapped.
+ * Comparisons are made a block at a time, recording the offsets of misplaced
+ * elements without branching on the result, as in BlockQuicksort
+ * (https://arxiv.org/abs/1604.06697), so random inputs don't pay for mispredictions.
+ */
+size_t __sort_partition_right(__SortCtx* ctx, size_t begin, size_t end, int* already_partitioned) {
+    char* pivot = ctx->pivot;
+    __elem_copy(pivot, __SORT_AT(ctx, begin), ctx->size);
+
+    size_t first = begin;
+    size_t last = end;
+    while (__sort_less(ctx, __SORT_AT(ctx, ++first), pivot)) {}
+    if (first - 1 == begin) {
+        while (first < last && !__sort_less(ctx, __SORT_AT(ctx, --last), pivot)) {}
+    } else {
+        while (!__sort_less(ctx, __SORT_AT(ctx, --last), pivot)) {}
+    }
+
+    *already_partitioned = first >= last;
+    if (!*already_partitioned) {
+        __sort_swap(ctx, first, last);
+        first++;
+
+        unsigned char offsets_l[__SORT_BLOCK_SIZE];
+        unsigned char offsets_r[__SORT_BLOCK_SIZE];
+        size_t left_base = first;
+        size_t right_base = last;
+        size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+        while (first < last) {
+            /* Only refill the blocks that have been used up */
+            size_t num_unknown = last - first;
+            size_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+            size_t right_split = num_r == 0 ? num_unknown - left_split : 0;
+            if (left_split > __SORT_BLOCK_SIZE)
+                left_split = __SORT_BLOCK_SIZE;
+            if (right_split > __SORT_BLOCK_SIZE)
+                right_split = __SORT_BLOCK_SIZE;
+
+            for (size_t i = 0; i < left_split; i++) {
+                offsets_l[num_l] = (unsigned char)i;
+                num_l += !__sort_less(ctx, __SORT_AT(ctx, first), pivot);
+                first++;
+            }
+            for (size_t i = 0; i < right_split; i++) {
+                offsets_r[num_r] = (unsigned char)(i + 1);
+                num_r += __sort_less(ctx, __SORT_AT(ctx, --last), pivot);
+            }
+
+            size_t num = num_l < num_r ? num_l : num_r;
+            __sort_swap_offsets(ctx, left_base, right_base,
+                    offsets_l + start_l, offsets_r + start_r, num, num_l == num_r);
+            num_l -= num;
+            num_r -= num;
+            start_l += num;
+            start_r += num;
+            if (num_l == 0) {
+                start_l = 0;
+                left_base = first;
+            }
+            if (num_r == 0) {
+                start_r = 0;
+                right_base = last;
+            }
+        }
+
+        /* One side may still hold misplaced elements, move them to the boundary */
+        if (num_l) {
+            while (num_l--)
+                __sort_swap(ctx, left_base + offsets_l[start_l + num_l], --last);
+            first = last;
+        }
+        if (num_r) {
+            while (num_r--)
+                __sort_swap(ctx, right_base - offsets_r[start_r + num_r], first++);
+            last = first;
+        }
+    }
+
+    size_t pivot_pos = first - 1;
+    __elem_copy(__SORT_AT(ctx, begin), __SORT_AT(ctx, pivot_pos), ctx->size);
+    __elem_copy(__SORT_AT(ctx, pivot_pos), pivot, ctx->size);
+    return pivot_pos;
+}
+
+/* Partition [begin, end) around the pivot at `begin`, placing elements equal
+ * to the pivot on the left. Used when the pivot equals the element preceding
+ * the range, so every element equal to it is already in its final place.
+ */
+size_t __sort_partition_left(__SortCtx* ctx, size_t begin, size_t end) {
+    char* pivot = ctx->pivot;
+    __elem_copy(pivot, __SORT_AT(ctx, begin), ctx->size);
+
+    size_t first = begin;
+    size_t last = end;
+    while (__sort_less(ctx, pivot, __SORT_AT(ctx, --last))) {}
+    if (last + 1 == end) {
+        while (first < last && !__sort_less(ctx, pivot, __SORT_AT(ctx, ++first))) {}
+    } else {
+        while (!__sort_less(ctx, pivot, __SORT_AT(ctx, ++first))) {}
+    }
+
+    while (first < last) {
+        __sort_swap(ctx, first, last);
+        while (__sort_less(ctx, pivot, __SORT_AT(ctx, --last))) {}
+        while (!__sort_less(ctx, pivot, __SORT_AT(ctx, ++first))) {}
+    }
+
+    __elem_copy(__SORT_AT(ctx, begin), __SORT_AT(ctx, last), ctx->size);
+    __elem_copy(__SORT_AT(ctx, last), pivot, ctx->size);
+    return last;
+}
+
+/* Pattern-defeating quicksort, see https://github.com/orlp/pdqsort
+ * Recurses on the left partition and loops on the right. `bad_allowed` limits
+ * the number of highly unbalanced partitions before falling back to heapsort.
+ */
+void __pdqsort_loop(__SortCtx* ctx, size_t begin, size_t end, int bad_allowed, int leftmost) {
+    for (;;) {
+        size_t size = end - begin;
+        if (size < __SORT_INSERTION_THRESHOLD) {
+            __sort_insertion(ctx, begin, end, leftmost);
+            return;
+        }
+
+        size_t s2 = size / 2;
+        if (size > __SORT_NINTHER_THRESHOLD) {
+            __sort3(ctx, begin, begin + s2, end - 1);
+            __sort3(ctx, begin + 1, begin + (s2 - 1), end - 2);
+            __sort3(ctx, begin + 2, begin + (s2 + 1), end - 3);
+            __sort3(ctx, begin + (s2 - 1), begin + s2, begin + (s2 + 1));
+            __sort_swap(ctx, begin, begin + s2);
+        } else {
+            __sort3(ctx, begin + s2, begin, end - 1);
+        }
+
+        /* Many elements equal to the pivot: they're already in place */
+        if (!leftmost && !__sort_less(ctx, __SORT_AT(ctx, begin - 1), __SORT_AT(ctx, begin))) {
+            begin = __sort_partition_left(ctx, begin, end) + 1;
+            continue;
+        }
+
+        int already_partitioned;
+        size_t pivot_pos = __sort_partition_right(ctx, begin, end, &already_partitioned);
+        size_t l_size = pivot_pos - begin;
+        size_t r_size = end - (pivot_pos + 1);
+
+        if (l_size < size / 8 || r_size < size / 8) {
+            if (--bad_allowed == 0) {
+                __sort_heapsort(ctx, begin, end);
+                return;
+            }
+            /* Break up patterns that produce bad pivots */
+            if (l_size >= __SORT_INSERTION_THRESHOLD) {
+                __sort_swap(ctx, begin, begin + l_size / 4);
+                __sort_swap(ctx, pivot_pos - 1, pivot_pos - l_size / 4);
+                if (l_size > __SORT_NINTHER_THRESHOLD) {
+                    __sort_swap(ctx, begin + 1, begin + (l_size / 4 + 1));
+                    __sort_swap(ctx, begin + 2, begin + (l_size / 4 + 2));
+                    __sort_swap(ctx, pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+                    __sort_swap(ctx, pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+                }
+            }
+            if (r_size >= __SORT_INSERTION_THRESHOLD) {
+                __sort_swap(ctx, pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+                __sort_swap(ctx, end - 1, end - r_size / 4);
+                if (r_size > __SORT_NINTHER_THRESHOLD) {
+                    __sort_swap(ctx, pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+                    __sort_swap(ctx, pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+                    __sort_swap(ctx, end - 2, end - (1 + r_size / 4));
+                    __sort_swap(ctx, end - 3, end - (2 + r_size / 4));
+                }
+            }
+        } else if (already_partitioned
+                && __sort_partial_insertion(ctx, begin, pivot_pos)
+                && __sort_partial_insertion(ctx, pivot_pos + 1, end)) {
+            /* Likely already sorted */
+            return;
+        }
+
+        __pdqsort_loop(ctx, begin, pivot_pos, bad_allowed, leftmost);
+        begin = pivot_pos + 1;
+        leftmost = 0;
+    }
+}
+
+void vec_sort_by(Vec* v, cmpFn cmp_func) {
+    size_t n = v->__len;
+    if (n < 2)
+        return;
+    size_t size = v->__item_size;
+    char* scratch = malloc(2 * size);
+    if (scratch == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+    __SortCtx ctx = {
+        .base=v->__data,
+        .size=size,
+        .cmp=cmp_func,
+        .pivot=scratch,
+        .tmp=scratch + size,
+    };
+    int bad_allowed = 0;
+    for (size_t m = n; m > 1; m >>= 1)
+        bad_allowed++;
+    __pdqsort_loop(&ctx, 0, n, bad_allowed + 1, 1);
+    free(scratch);
+}
+
+/* Top-down merge sort of [begin, end) using `ctx->tmp` (space for half the
+ * range) as scratch. Already ordered halves skip the merge, so sorted runs
+ * cost a single comparison.
+ */
+void __sort_merge(__SortCtx* ctx, size_t begin, size_t end) {
+    size_t n = end - begin;
+    if (n <= __SORT_INSERTION_THRESHOLD) {
+        __sort_insertion(ctx, begin, end, 1);
+        return;
+    }
+    size_t mid = begin + n / 2;
+    __sort_merge(ctx, begin, mid);
+    __sort_merge(ctx, mid, end);
+    if (!__sort_less(ctx, __SORT_AT(ctx, mid), __SORT_AT(ctx, mid - 1)))
+        return;
+
+    size_t size = ctx->size;
+    size_t left_len = mid - begin;
+    memcpy(ctx->tmp, __SORT_AT(ctx, begin), left_len * size);
+    char* left = ctx->tmp;
+    char* left_end = ctx->tmp + left_len * size;
+    char* right = __SORT_AT(ctx, mid);
+    char* right_end = __SORT_AT(ctx, end);
+    char* out = __SORT_AT(ctx, begin);
+    /* Take from the right only when strictly less, keeping equal elements in order */
+    while (left < left_end && right < right_end) {
+        if (__sort_less(ctx, right, left)) {
+            __elem_copy(out, right, size);
+            right += size;
+        } else {
+            __elem_copy(out, left, size);
+            left += size;
+        }
+        out += size;
+    }
+    memcpy(out, left, (size_t)(left_end - left));
+}
+
+void vec_sort_stable_by(Vec* v, cmpFn cmp_func) {
+    size_t n = v->__len;
+    if (n < 2)
+        return;
+    size_t size = v->__item_size;
+    char* scratch = malloc((n / 2 + 2) * size);
+    if (scratch == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+    __SortCtx ctx = {
+        .base=v->__data,
+        .size=size,
+        .cmp=cmp_func,
+        .pivot=scratch,
+        .tmp=scratch + size,
+    };
+    __sort_merge(&ctx, 0, n);
+    free(scratch);
+}
+
+/* Bits of the key sorted on per radix pass. 11 bits needs a pass less than
+ * a byte at a time for 32 and 64 bit keys while the counts still fit in L1.
+ */
+#define __RADIX_BITS 11
+#define __RADIX_BUCKETS (1 << __RADIX_BITS)
+
+/* LSD radix sort of the `Vec` elements by their order-preserving unsigned `keys`
+ * of `key_bits` bits, `__RADIX_BITS` at a time. Counts for every digit are built
+ * in a single pass over the keys, and passes where all keys share the same digit
+ * are skipped, so small key ranges only pay for the digits that differ. Keys and
+ * elements are scattered together between ping-pong buffers. Takes ownership of `keys`.
+ */
+void __vec_radix_sort(Vec* v, uint64_t* keys, size_t key_bits) {
+    size_t n = v->__len;
+    size_t size = v->__item_size;
+    size_t digits = (key_bits + __RADIX_BITS - 1) / __RADIX_BITS;
+    const uint64_t mask = __RADIX_BUCKETS - 1;
+
+    size_t (*counts)[__RADIX_BUCKETS] = calloc(digits, sizeof(*counts));
+    uint64_t* keys_tmp = malloc(n * sizeof(uint64_t));
+    char* data_tmp = __buf_alloc(v->__cap * size);
+    if (counts == NULL || keys_tmp == NULL || data_tmp == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = keys[i];
+        for (size_t d = 0; d < digits; d++)
+            counts[d][(key >> (d * __RADIX_BITS)) & mask]++;
+    }
+
+    char* data = v->__data;
+    size_t offsets[__RADIX_BUCKETS];
+    for (size_t d = 0; d < digits; d++) {
+        size_t shift = d * __RADIX_BITS;
+        size_t* count = counts[d];
+        if (count[(keys[0] >> shift) & mask] == n)
+            continue;
+
+        size_t total = 0;
+        for (size_t b = 0; b < __RADIX_BUCKETS; b++) {
+            offsets[b] = total;
+            total += count[b];
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t key = keys[i];
+            size_t dst = offsets[(key >> shift) & mask]++;
+            keys_tmp[dst] = key;
+            __elem_copy(data_tmp + dst * size, data + i * size, size);
+        }
+
+        uint64_t* keys_swap = keys;
+        keys = keys_tmp;
+        keys_tmp = keys_swap;
+        char* data_swap = data;
+        data = data_tmp;
+        data_tmp = data_swap;
+    }
+
+    v->__data = data;
+    __buf_free(data_tmp, v->__cap * size);
+    free(keys);
+    free(keys_tmp);
+    free(counts);
+}
+
+uint64_t* __vec_radix_keys(Vec* v) {
+    uint64_t* keys = malloc(v->__len * sizeof(uint64_t));
+    if (keys == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+    return keys;
+}
+
+void vec_radix_sort_by_u32(Vec* v, keyU32Fn key_func) {
+    if (v->__len < 2)
+        return;
+    uint64_t* keys = __vec_radix_keys(v);
+    char* data = v->__data;
+    for (size_t i = 0; i < v->__len; i++)
+        keys[i] = key_func(data + i * v->__item_size);
+    __vec_radix_sort(v, keys, 32);
+}
+
+void vec_radix_sort_by_u64(Vec* v, keyU64Fn key_func) {
+    if (v->__len < 2)
+        return;
+    uint64_t* keys = __vec_radix_keys(v);
+    char* data = v->__data;
+    for (size_t i = 0; i < v->__len; i++)
+        keys[i] = key_func(data + i * v->__item_size);
+    __vec_radix_sort(v, keys, 64);
+}
+
+void vec_radix_sort_by_i64(Vec* v, keyI64Fn key_func) {
+    if (v->__len < 2)
+        return;
+    uint64_t* keys = __vec_radix_keys(v);
+    char* data = v->__data;
+    for (size_t i = 0; i < v->__len; i++) {
+        /* Flipping the sign bit orders negatives before positives */
+        keys[i] = (uint64_t)key_func(data + i * v->__item_size) ^ ((uint64_t)1 << 63);
+    }
+    __vec_radix_sort(v, keys, 64);
+}
+
+void vec_radix_sort_by_f64(Vec* v, keyF64Fn key_func) {
+    if (v->__len < 2)
+        return;
+    uint64_t* keys = __vec_radix_keys(v);
+    char* data = v->__data;
+    for (size_t i = 0; i < v->__len; i++) {
+        double key = key_func(data + i * v->__item_size);
+        uint64_t bits;
+        memcpy(&bits, &key, sizeof(bits));
+        /* Negatives have all bits flipped so larger magnitudes sort first,
+         * positives only have the sign bit set so they sort after negatives */
+        uint64_t mask = (uint64_t)-(int64_t)(bits >> 63) | ((uint64_t)1 << 63);
+        keys[i] = bits ^ mask;
+    }
+    __vec_radix_sort(v, keys, 64);
+}
+
+/* Below this many elements per thread, `vec_par_sort_by` sorts on fewer threads */
+#define __PAR_SORT_MIN_RUN 16384
+/* Samples taken from each sorted run per thread to pick the partition splitters */
+#define __PAR_SORT_OVERSAMPLE 8
+
+/* One thread's share of a `vec_par_sort_by`: first sorting the run [begin, end)
+ * in place, then merging partition `part` of every run into `out`.
+ * `bounds` holds `nruns` rows of `nruns + 1` offsets, where partition p of
+ * run r is [bounds[r][p], bounds[r][p + 1]).
+ */
+typedef struct {
+    char* data;
+    char* out;
+    size_t size;
+    cmpFn cmp;
+    size_t begin;
+    size_t end;
+    size_t part;
+    size_t nruns;
+    size_t* bounds;
+    size_t out_begin;
+} __ParSortTask;
+
+void* __par_sort_run(void* task_ptr) {
+    __ParSortTask* task = (__ParSortTask*)task_ptr;
+    Vec run = {
+        .__data=task->data + task->begin * task->size,
+        .__item_size=task->size,
+        .__len=task->end - task->begin,
+        .__cap=task->end - task->begin,
+    };
+    vec_sort_by(&run, task->cmp);
+    return NULL;
+}
+
+/* Restore the heap of run indices ordered by their current head element */
+void __par_sort_sift_down(__ParSortTask* task, size_t* heap, size_t* heads, size_t len, size_t root) {
+    size_t size = task->size;
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= len)
+            return;
+        if (child + 1 < len && task->cmp(task->data + heads[heap[child + 1]] * size,
+                                         task->data + heads[heap[child]] * size) == CMP_LESS)
+            child++;
+        if (task->cmp(task->data + heads[heap[child]] * size,
+                      task->data + heads[heap[root]] * size) != CMP_LESS)
+            return;
+        size_t tmp = heap[root];
+        heap[root] = heap[child];
+        heap[child] = tmp;
+        root = child;
+    }
+}
+
+/* K-way merge of partition `part` of every run, through a binary heap of runs */
+void* __par_sort_merge(void* task_ptr) {
+    __ParSortTask* task = (__ParSortTask*)task_ptr;
+    size_t size = task->size;
+    size_t nruns = task->nruns;
+    size_t* heads = malloc(nruns * sizeof(size_t));
+    size_t* tails = malloc(nruns * sizeof(size_t));
+    size_t* heap = malloc(nruns * sizeof(size_t));
+    if (heads == NULL || tails == NULL || heap == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+
+    size_t len = 0;
+    for (size_t r = 0; r < nruns; r++) {
+        heads[r] = task->bounds[r * (nruns + 1) + task->part];
+        tails[r] = task->bounds[r * (nruns + 1) + task->part + 1];
+        if (heads[r] < tails[r])
+            heap[len++] = r;
+    }
+    for (size_t i = len / 2; i > 0; i--)
+        __par_sort_sift_down(task, heap, heads, len, i - 1);
+
+    char* out = task->out + task->out_begin * size;
+    while (len > 1) {
+        size_t r = heap[0];
+        __elem_copy(out, task->data + heads[r] * size, size);
+        out += size;
+        if (++heads[r] == tails[r])
+            heap[0] = heap[--len];
+        __par_sort_sift_down(task, heap, heads, len, 0);
+    }
+    if (len == 1) {
+        size_t r = heap[0];
+        memcpy(out, task->data + heads[r] * size, (tails[r] - heads[r]) * size);
+    }
+
+    free(heads);
+    free(tails);
+    free(heap);
+    return NULL;
+}
+
+/* Run `func` over every task, the calling thread taking the first */
+void __par_sort_spawn(__ParSortTask* tasks, size_t ntasks, void* (*func)(void*)) {
+    pthread_t* threads = malloc(ntasks * sizeof(pthread_t));
+    uint8_t* spawned = calloc(ntasks, sizeof(uint8_t));
+    if (threads == NULL || spawned == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+    for (size_t i = 1; i < ntasks; i++)
+        spawned[i] = pthread_create(&threads[i], NULL, func, &tasks[i]) == 0;
+    func(&tasks[0]);
+    for (size_t i = 1; i < ntasks; i++) {
+        if (spawned[i])
+            pthread_join(threads[i], NULL);
+        else
+            func(&tasks[i]);  /* couldn't start a thread, do the work here */
+    }
+    free(threads);
+    free(spawned);
+}
+
+/* Index of the first element of the sorted [begin, end) not less than `key` */
+size_t __par_sort_lower_bound(char* data, size_t size, cmpFn cmp, size_t begin, size_t end, void* key) {
+    while (begin < end) {
+        size_t mid = begin + (end - begin) / 2;
+        if (cmp(data + mid * size, key) == CMP_LESS)
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+    return begin;
+}
+
+void vec_par_sort_by(Vec* v, cmpFn cmp_func, size_t nthreads) {
+    size_t n = v->__len;
+    size_t size = v->__item_size;
+    if (nthreads > n / __PAR_SORT_MIN_RUN)
+        nthreads = n / __PAR_SORT_MIN_RUN;
+    if (nthreads <= 1) {
+        vec_sort_by(v, cmp_func);
+        return;
+    }
+
+    char* data = v->__data;
+    char* out = __buf_alloc(v->__cap * size);
+    __ParSortTask* tasks = malloc(nthreads * sizeof(__ParSortTask));
+    size_t* bounds = malloc(nthreads * (nthreads + 1) * sizeof(size_t));
+    if (out == NULL || tasks == NULL || bounds == NULL) {
+        fprintf(stderr, "Vec sort alloc failure\n");
+        abort();
+    }
+
+    /* sort an equal share of the elements on each thread */
+    for (size_t i = 0; i < nthreads; i++) {
+        __ParSortTask task = {
+            .data=data,
+            .out=out,
+            .size=size,
+            .cmp=cmp_func,
+            .begin=n / nthreads * i,
+            .end=i == nthreads - 1 ? n : n / nthreads * (i + 1),
+            .part=i,
+            .nruns=nthreads,
+            .bounds=bounds,
+            .out_begin=0,
+        };
+        tasks[i] = task;
+    }
+    __par_sort_spawn(tasks, nthreads, __par_sort_run);
+
+    /* pick splitters from evenly spaced samples of the sorted runs,
+     * then split every run at them into one partition per thread */
+    size_t per_run = nthreads * __PAR_SORT_OVERSAMPLE;
+    Vec samples = vec_with_capacity(size, nthreads * per_run);
+    for (size_t r = 0; r < nthreads; r++) {
+        size_t run_len = tasks[r].end - tasks[r].begin;
+        for (size_t s = 0; s < per_run; s++)
+            vec_push(&samples, data + (tasks[r].begin + run_len / per_run * s + run_len / per_run / 2) * size);
+    }
+    vec_sort_by(&samples, cmp_func);
+    for (size_t r = 0; r < nthreads; r++) {
+        size_t* row = bounds + r * (nthreads + 1);
+        row[0] = tasks[r].begin;
+        row[nthreads] = tasks[r].end;
+        for (size_t p = 1; p < nthreads; p++) {
+            void* splitter = vec_index_ref(&samples, p * per_run);
+            row[p] = __par_sort_lower_bound(data, size, cmp_func, row[p - 1], tasks[r].end, splitter);
+        }
+    }
+    vec_drop(&samples);
+
+    /* merge each partition of the runs into its place in `out` */
+    size_t out_begin = 0;
+    for (size_t p = 0; p < nthreads; p++) {
+        tasks[p].out_begin = out_begin;
+        for (size_t r = 0; r < nthreads; r++)
+            out_begin += bounds[r * (nthreads + 1) + p + 1] - bounds[r * (nthreads + 1) + p];
+    }
+    __par_sort_spawn(tasks, nthreads, __par_sort_merge);
+
+    v->__data = out;
+    __buf_free(data, v->__cap * size);
+    free(tasks);
+    free(bounds);
+}
+
+
+/* ----------- Vec searching ------------- */
+
+#ifdef __GNUC__
+#define __PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define __PREFETCH(ptr) ((void)(ptr))
+#endif
+
+/* Branchless lower bound over `len` sorted elements of `size` bytes.
+ * The search range halves on every probe whatever the comparison result,
+ * so the loop has no data dependent branch to mispredict: the result only
+ * selects the next base with a multiply. Both candidate probes of the next
+ * iteration are prefetched while the current comparison runs.
+ */
+size_t __lower_bound(const char* data, size_t len, size_t size, void* key, cmpFn cmp_func) {
+    if (len == 0)
+        return 0;
+    const char* base = data;
+    while (len > 1) {
+        size_t half = len / 2;
+        __PREFETCH(base + (half / 2) * size);
+        __PREFETCH(base + (half + half / 2) * size);
+        size_t less = cmp_func((void*)(base + half * size), key) == CMP_LESS;
+        base += less * half * size;
+        len -= half;
+    }
+    size_t less = cmp_func((void*)base, key) == CMP_LESS;
+    return (size_t)(base - data) / size + less;
+}
+
+size_t vec_lower_bound_by(Vec* v, void* key, cmpFn cmp_func) {
+    return __lower_bound(v->__data, v->__len, v->__item_size, key, cmp_func);
+}
+
+uint8_t vec_binary_search_by(Vec* v, void* key, cmpFn cmp_func, size_t* index) {
+    size_t ind = __lower_bound(v->__data, v->__len, v->__item_size, key, cmp_func);
+    *index = ind;
+    return ind < v->__len && cmp_func((char*)v->__data + ind * v->__item_size, key) == CMP_EQUAL;
+}
+
+
+/* ----------- Slice ------------- */
+
+void* slice_index_ref(Slice* sl, size_t ind) {
+    if (ind >= sl->__len) {
+        fprintf(stderr, "Out of bounds: len: %lu, index: %lu\n", sl->__len, ind);
+        abort();
+    }
+    return slice_index_ref_unchecked(sl, ind);
+}
+
+inline void* slice_index_ref_unchecked(Slice* sl, size_t ind) {
+    char* offset = (char*)sl->__data + (ind * sl->__item_size);
+    return (void*)offset;
+}
+
+Slice slice_from_ptr_len(size_t item_size, const void* ptr, size_t len) {
+    Slice sl = { .__data=ptr, .__item_size=item_size, .__len=len };
+    return sl;
+}
+
+SliceIter slice_iter(Slice* sl) {
+    SliceIter iter = {
+        .__data=(void*)sl->__data,
+        .__item_size=sl->__item_size,
+        .__len=sl->__len,
+        .__ind=0,
+    };
+    return iter;
+}
+
+uint8_t slice_iter_done(SliceIter* iter) {
+    return iter->__ind < iter->__len ? 1 : 0;
+}
+
+void* slice_iter_next(SliceIter* iter) {
+    char* ref = (char*)iter->__data + iter->__item_size * iter->__ind;
+    iter->__ind++;
+    return (void*)ref;
+}
+
+
+/* ----------- EytzingerIndex ------------- */
+
+/* Copy the sorted elements into the Eytzinger layout with an in-order walk
+ * of the implicit tree, where node `k` has children `2k` and `2k + 1`.
+ */
+void __eytzinger_fill(EytzingerIndex* ei, const char* sorted, size_t* next, size_t k) {
+    while (k <= ei->__len) {
+        __eytzinger_fill(ei, sorted, next, 2 * k);
+        memcpy((char*)ei->__data + k * ei->__item_size, sorted + *next * ei->__item_size, ei->__item_size);
+        (*next)++;
+        k = 2 * k + 1;
+    }
+}
+
+EytzingerIndex eytzinger_index_new(Slice* sorted) {
+    EytzingerIndex ei = { .__data=NULL, .__item_size=sorted->__item_size, .__len=sorted->__len };
+    /* slot 0 is unused, so the root is at index 1 */
+    ei.__data = malloc((sorted->__len + 1) * sorted->__item_size);
+    if (ei.__data == NULL) {
+        fprintf(stderr, "EytzingerIndex alloc failure\n");
+        abort();
+    }
+    size_t next = 0;
+    __eytzinger_fill(&ei, sorted->__data, &next, 1);
+    return ei;
+}
+
+size_t eytzinger_index_len(EytzingerIndex* ei) {
+    return ei->__len;
+}
+
+void* eytzinger_index_lower_bound(EytzingerIndex* ei, void* key, cmpFn cmp_func) {
+    const char* data = ei->__data;
+    size_t size = ei->__item_size;
+    size_t k = 1;
+    while (k <= ei->__len) {
+        /* the 16 descendants four levels down are contiguous */
+        __PREFETCH(data + 16 * k * size);
+        k = 2 * k + (cmp_func((void*)(data + k * size), key) == CMP_LESS);
+    }
+    /* undo the trailing right turns, and the left turn before them */
+    k >>= __ctz64(~(uint64_t)k) + 1;
+    return k == 0 ? NULL : (void*)(data + k * size);
+}
+
+void* eytzinger_index_find(EytzingerIndex* ei, void* key, cmpFn cmp_func) {
+    void* found = eytzinger_index_lower_bound(ei, key, cmp_func);
+    if (found == NULL || cmp_func(found, key) != CMP_EQUAL)
+        return NULL;
+    return found;
+}
+
+void eytzinger_index_drop(void* ei_ptr) {
+    EytzingerIndex* ei = (EytzingerIndex*)ei_ptr;
+    free(ei->__data);
+    ei->__data = NULL;
+    ei->__len = 0;
+}
+
+
+/* ----------- Sorted sets ------------- */
+
+/* Set operations over strictly increasing u32/u64 `Slice`s, like posting lists.
+ * The merges are branch free: both cursors advance by the result of comparisons.
+ */
+
+size_t __sorted_intersect_scalar_u32(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint32_t x = a[i], y = b[j];
+        out[k] = x;
+        k += x == y;
+        i += x <= y;
+        j += y <= x;
+    }
+    return k;
+}
+
+size_t __sorted_intersect_scalar_u64(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint64_t x = a[i], y = b[j];
+        out[k] = x;
+        k += x == y;
+        i += x <= y;
+        j += y <= x;
+    }
+    return k;
+}
+
+size_t __sorted_difference_scalar_u32(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint32_t x = a[i], y = b[j];
+        out[k] = x;
+        k += x < y;
+        i += x <= y;
+        j += y <= x;
+    }
+    if (i < na)
+        memcpy(out + k, a + i, (na - i) * sizeof(uint32_t));
+    return k + na - i;
+}
+
+size_t __sorted_difference_scalar_u64(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint64_t x = a[i], y = b[j];
+        out[k] = x;
+        k += x < y;
+        i += x <= y;
+        j += y <= x;
+    }
+    if (i < na)
+        memcpy(out + k, a + i, (na - i) * sizeof(uint64_t));
+    return k + na - i;
+}
+
+size_t __sorted_union_u32(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint32_t x = a[i], y = b[j];
+        out[k++] = x <= y ? x : y;
+        i += x <= y;
+        j += y <= x;
+    }
+    if (i < na)
+        memcpy(out + k, a + i, (na - i) * sizeof(uint32_t));
+    k += na - i;
+    if (j < nb)
+        memcpy(out + k, b + j, (nb - j) * sizeof(uint32_t));
+    return k + nb - j;
+}
+
+size_t __sorted_union_u64(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint64_t x = a[i], y = b[j];
+        out[k++] = x <= y ? x : y;
+        i += x <= y;
+        j += y <= x;
+    }
+    if (i < na)
+        memcpy(out + k, a + i, (na - i) * sizeof(uint64_t));
+    k += na - i;
+    if (j < nb)
+        memcpy(out + k, b + j, (nb - j) * sizeof(uint64_t));
+    return k + nb - j;
+}
+
+/* Index of the first element of `v` at or after `from` that isn't less than `x`,
+ * found by doubling steps from `from`, then binary searching the last step
+ */
+size_t __sorted_seek_u32(const uint32_t* v, size_t n, size_t from, uint32_t x) {
+    if (from >= n || v[from] >= x)
+        return from;
+    size_t lo = from, step = 1;
+    while (lo + step < n && v[lo + step] < x) {
+        lo += step;
+        step *= 2;
+    }
+    size_t first = lo + 1;
+    size_t len = (lo + step < n ? lo + step : n) - first;
+    while (len > 0) {
+        size_t half = len / 2;
+        if (v[first + half] < x) {
+            first += half + 1;
+            len -= half + 1;
+        } else {
+            len = half;
+        }
+    }
+    return first;
+}
+
+/* The galloping variants walk the smaller side and seek through the larger one,
+ * in O(small * log(large / small)), copying the runs of the larger side in between
+ * when they belong in the output
+ */
+size_t __sorted_gallop_u32(const uint32_t* small, size_t ns, const uint32_t* large, size_t nl, uint32_t* out) {
+    size_t j = 0, k = 0;
+    for (size_t i = 0; i < ns; i++) {
+        j = __sorted_seek_u32(large, nl, j, small[i]);
+        if (j == nl)
+            break;
+        if (large[j] == small[i]) {
+            out[k++] = small[i];
+            j++;
+        }
+    }
+    return k;
+}
+
+size_t __sorted_union_gallop_u32(const uint32_t* small, size_t ns, const uint32_t* large, size_t nl, uint32_t* out) {
+    size_t j = 0, k = 0;
+    for (size_t i = 0; i < ns; i++) {
+        size_t run = __sorted_seek_u32(large, nl, j, small[i]);
+        if (run > j)
+            memcpy(out + k, large + j, (run - j) * sizeof(uint32_t));
+        k += run - j;
+        j = run + (run < nl && large[run] == small[i]);
+        out[k++] = small[i];
+    }
+    if (j < nl)
+        memcpy(out + k, large + j, (nl - j) * sizeof(uint32_t));
+    return k + nl - j;
+}
+
+size_t __sorted_difference_gallop_u32(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    if (na <= nb) {
+        for (; i < na; i++) {
+            j = __sorted_seek_u32(b, nb, j, a[i]);
+            out[k] = a[i];
+            k += j == nb || b[j] != a[i];
+        }
+        return k;
+    }
+    for (; j < nb; j++) {
+        size_t run = __sorted_seek_u32(a, na, i, b[j]);
+        if (run > i)
+            memcpy(out + k, a + i, (run - i) * sizeof(uint32_t));
+        k += run - i;
+        i = run + (run < na && a[run] == b[j]);
+    }
+    if (i < na)
+        memcpy(out + k, a + i, (na - i) * sizeof(uint32_t));
+    return k + na - i;
+}
+
+size_t __sorted_seek_u64(const uint64_t* v, size_t n, size_t from, uint64_t x) {
+    if (from >= n || v[from] >= x)
+        return from;
+    size_t lo = from, step = 1;
+    while (lo + step < n && v[lo + step] < x) {
+        lo += step;
+        step *= 2;
+    }
+    size_t first = lo + 1;
+    size_t len = (lo + step < n ? lo + step : n) - first;
+    while (len > 0) {
+        size_t half = len / 2;
+        if (v[first + half] < x) {
+            first += half + 1;
+            len -= half + 1;
+        } else {
+            len = half;
+        }
+    }
+    return first;
+}
+
+size_t __sorted_gallop_u64(const uint64_t* small, size_t ns, const uint64_t* large, size_t nl, uint64_t* out) {
+    size_t j = 0, k = 0;
+    for (size_t i = 0; i < ns; i++) {
+        j = __sorted_seek_u64(large, nl, j, small[i]);
+        if (j == nl)
+            break;
+        if (large[j] == small[i]) {
+            out[k++] = small[i];
+            j++;
+        }
+    }
+    return k;
+}
+
+size_t __sorted_union_gallop_u64(const uint64_t* small, size_t ns, const uint64_t* large, size_t nl, uint64_t* out) {
+    size_t j = 0, k = 0;
+    for (size_t i = 0; i < ns; i++) {
+        size_t run = __sorted_seek_u64(large, nl, j, small[i]);
+        if (run > j)
+            memcpy(out + k, large + j, (run - j) * sizeof(uint64_t));
+        k += run - j;
+        j = run + (run < nl && large[run] == small[i]);
+        out[k++] = small[i];
+    }
+    if (j < nl)
+        memcpy(out + k, large + j, (nl - j) * sizeof(uint64_t));
+    return k + nl - j;
+}
+
+size_t __sorted_difference_gallop_u64(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    if (na <= nb) {
+        for (; i < na; i++) {
+            j = __sorted_seek_u64(b, nb, j, a[i]);
+            out[k] = a[i];
+            k += j == nb || b[j] != a[i];
+        }
+        return k;
+    }
+    for (; j < nb; j++) {
+        size_t run = __sorted_seek_u64(a, na, i, b[j]);
+        if (run > i)
+            memcpy(out + k, a + i, (run - i) * sizeof(uint64_t));
+        k += run - i;
+        i = run + (run < na && a[run] == b[j]);
+    }
+    if (i < na)
+        memcpy(out + k, a + i, (na - i) * sizeof(uint64_t));
+    return k + na - i;
+}
+
+#ifdef UTILS_X86
+/* The AVX2 kernels compare a block of `a` against every rotation of a block of `b`,
+ * then advance whichever block ends lower (or both). An element of `a` is compared
+ * against every block of `b` overlapping its range, and can match at most once.
+ * Selected 32bit lanes are packed to the front with a permutation whose indices
+ * are extracted from 0..7 by the lane mask with `pext`. Up to 8 lanes are stored,
+ * so the output needs 32 bytes of room past the kept elements.
+ */
+UTILS_TARGET("avx2,bmi2,popcnt")
+size_t __sorted_compact_avx2(void* out, __m256i v, unsigned lanes32) {
+    uint64_t bytes = _pdep_u64(lanes32, 0x0101010101010101ULL) * 0xFF;
+    uint64_t indices = _pext_u64(0x0706050403020100ULL, bytes);
+    __m256i perm = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)indices));
+    _mm256_storeu_si256((__m256i*)out, _mm256_permutevar8x32_epi32(v, perm));
+    return (size_t)_mm_popcnt_u32(lanes32) * 4;
+}
+
+/* Mask of the 32bit lanes of `a` equal to any 32bit lane of `b` */
+UTILS_TARGET("avx2,bmi2,popcnt")
+unsigned __sorted_match_u32_avx2(__m256i a, __m256i b) {
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    __m256i eq = _mm256_cmpeq_epi32(a, b);
+    for (int r = 1; r < 8; r++) {
+        b = _mm256_permutevar8x32_epi32(b, rotate);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(a, b));
+    }
+    return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+}
+
+/* Mask of the 64bit lanes of `a` equal to any 64bit lane of `b`, as pairs of 32bit lanes */
+UTILS_TARGET("avx2,bmi2,popcnt")
+unsigned __sorted_match_u64_avx2(__m256i a, __m256i b) {
+    __m256i eq = _mm256_cmpeq_epi64(a, b);
+    for (int r = 1; r < 4; r++) {
+        b = _mm256_permute4x64_epi64(b, 0x39);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(a, b));
+    }
+    return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+}
+
+UTILS_TARGET("avx2,bmi2,popcnt")
+size_t __sorted_intersect_avx2_u32(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i + 8 <= na && j + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        k += __sorted_compact_avx2(out + k, va, __sorted_match_u32_avx2(va, vb)) / 4;
+        uint32_t a_max = a[i + 7], b_max = b[j + 7];
+        i += (a_max <= b_max) * 8;
+        j += (b_max <= a_max) * 8;
+    }
+    return k + __sorted_intersect_scalar_u32(a + i, na - i, b + j, nb - j, out + k);
+}
+
+UTILS_TARGET("avx2,bmi2,popcnt")
+size_t __sorted_intersect_avx2_u64(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        k += __sorted_compact_avx2(out + k, va, __sorted_match_u64_avx2(va, vb)) / 8;
+        uint64_t a_max = a[i + 3], b_max = b[j + 3];
+        i += (a_max <= b_max) * 4;
+        j += (b_max <= a_max) * 4;
+    }
+    return k + __sorted_intersect_scalar_u64(a + i, na - i, b + j, nb - j, out + k);
+}
+
+/* Blocks of `a` are only emitted, minus the lanes matched along the way, once `b` has
+ * moved past them. A block still pending when `b` runs out finishes with the scalar merge.
+ */
+UTILS_TARGET("avx2,bmi2,popcnt")
+size_t __sorted_difference_avx2_u32(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    unsigned found = 0;
+    while (i + 8 <= na && j + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        found |= __sorted_match_u32_avx2(va, vb);
+        uint32_t a_max = a[i + 7], b_max = b[j + 7];
+        if (a_max <= b_max) {
+            k += __sorted_compact_avx2(out + k, va, ~found & 0xFF) / 4;
+            found = 0;
+            i += 8;
+        }
+        j += (b_max <= a_max) * 8;
+    }
+    if (found != 0) {
+        uint32_t rest[8];
+        size_t num_rest = 0;
+        for (size_t r = 0; r < 8; r++) {
+            if (!((found >> r) & 1))
+                rest[num_rest++] = a[i + r];
+        }
+        k += __sorted_difference_scalar_u32(rest, num_rest, b + j, nb - j, out + k);
+        i += 8;
+    }
+    return k + __sorted_difference_scalar_u32(a + i, na - i, b + j, nb - j, out + k);
+}
+
+UTILS_TARGET("avx2,bmi2,popcnt")
+size_t __sorted_difference_avx2_u64(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    unsigned found = 0;
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        found |= __sorted_match_u64_avx2(va, vb);
+        uint64_t a_max = a[i + 3], b_max = b[j + 3];
+        if (a_max <= b_max) {
+            k += __sorted_compact_avx2(out + k, va, ~found & 0xFF) / 8;
+            found = 0;
+            i += 4;
+        }
+        j += (b_max <= a_max) * 4;
+    }
+    if (found != 0) {
+        uint64_t rest[4];
+        size_t num_rest = 0;
+        for (size_t r = 0; r < 4; r++) {
+            if (!((found >> (2 * r)) & 1))
+                rest[num_rest++] = a[i + r];
+        }
+        k += __sorted_difference_scalar_u64(rest, num_rest, b + j, nb - j, out + k);
+        i += 4;
+    }
+    return k + __sorted_difference_scalar_u64(a + i, na - i, b + j, nb - j, out + k);
+}
+
+uint8_t __sorted_use_avx2() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")
+        && __builtin_cpu_supports("popcnt");
+}
+#endif
+
+/* Past these size ratios, intersections gallop through the larger side instead of
+ * merging, which is cheaper for much longer with the AVX2 kernels
+ */
+#define __SORTED_GALLOP_RATIO 16
+#define __SORTED_GALLOP_RATIO_AVX2 64
+
+/* Check the operands' item sizes, and make room in `out` for `max_len` more elements
+ * plus the slack that SIMD stores may write past the kept ones
+ */
+void __sorted_prepare(Slice* a, Slice* b, Vec* out, size_t width, size_t max_len) {
+    if (a->__item_size != width || b->__item_size != width || out->__item_size != width) {
+        fprintf(stderr, "Mismatched item size: expected: %lu, a: %lu, b: %lu, out: %lu\n",
+                width, a->__item_size, b->__item_size, out->__item_size);
+        abort();
+    }
+    vec_reserve(out, max_len + 32 / width);
+}
+
+void slice_sorted_intersect_u32(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    size_t ratio = __SORTED_GALLOP_RATIO;
+#ifdef UTILS_X86
+    uint8_t avx2 = __sorted_use_avx2();
+    if (avx2)
+        ratio = __SORTED_GALLOP_RATIO_AVX2;
+#endif
+    if (na > nb * ratio || nb > na * ratio) {
+        slice_sorted_intersect_gallop_u32(a, b, out);
+        return;
+    }
+    __sorted_prepare(a, b, out, sizeof(uint32_t), na < nb ? na : nb);
+    uint32_t* dst = (uint32_t*)out->__data + out->__len;
+#ifdef UTILS_X86
+    if (avx2) {
+        out->__len += __sorted_intersect_avx2_u32(a->__data, na, b->__data, nb, dst);
+        return;
+    }
+#endif
+    out->__len += __sorted_intersect_scalar_u32(a->__data, na, b->__data, nb, dst);
+}
+
+void slice_sorted_intersect_u64(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    size_t ratio = __SORTED_GALLOP_RATIO;
+#ifdef UTILS_X86
+    uint8_t avx2 = __sorted_use_avx2();
+    if (avx2)
+        ratio = __SORTED_GALLOP_RATIO_AVX2;
+#endif
+    if (na > nb * ratio || nb > na * ratio) {
+        slice_sorted_intersect_gallop_u64(a, b, out);
+        return;
+    }
+    __sorted_prepare(a, b, out, sizeof(uint64_t), na < nb ? na : nb);
+    uint64_t* dst = (uint64_t*)out->__data + out->__len;
+#ifdef UTILS_X86
+    if (avx2) {
+        out->__len += __sorted_intersect_avx2_u64(a->__data, na, b->__data, nb, dst);
+        return;
+    }
+#endif
+    out->__len += __sorted_intersect_scalar_u64(a->__data, na, b->__data, nb, dst);
+}
+
+void slice_sorted_intersect_gallop_u32(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    __sorted_prepare(a, b, out, sizeof(uint32_t), na < nb ? na : nb);
+    uint32_t* dst = (uint32_t*)out->__data + out->__len;
+    if (na <= nb)
+        out->__len += __sorted_gallop_u32(a->__data, na, b->__data, nb, dst);
+    else
+        out->__len += __sorted_gallop_u32(b->__data, nb, a->__data, na, dst);
+}
+
+void slice_sorted_intersect_gallop_u64(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    __sorted_prepare(a, b, out, sizeof(uint64_t), na < nb ? na : nb);
+    uint64_t* dst = (uint64_t*)out->__data + out->__len;
+    if (na <= nb)
+        out->__len += __sorted_gallop_u64(a->__data, na, b->__data, nb, dst);
+    else
+        out->__len += __sorted_gallop_u64(b->__data, nb, a->__data, na, dst);
+}
+
+void slice_sorted_union_u32(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    __sorted_prepare(a, b, out, sizeof(uint32_t), na + nb);
+    uint32_t* dst = (uint32_t*)out->__data + out->__len;
+    if (na > nb * __SORTED_GALLOP_RATIO)
+        out->__len += __sorted_union_gallop_u32(b->__data, nb, a->__data, na, dst);
+    else if (nb > na * __SORTED_GALLOP_RATIO)
+        out->__len += __sorted_union_gallop_u32(a->__data, na, b->__data, nb, dst);
+    else
+        out->__len += __sorted_union_u32(a->__data, na, b->__data, nb, dst);
+}
+
+void slice_sorted_union_u64(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    __sorted_prepare(a, b, out, sizeof(uint64_t), na + nb);
+    uint64_t* dst = (uint64_t*)out->__data + out->__len;
+    if (na > nb * __SORTED_GALLOP_RATIO)
+        out->__len += __sorted_union_gallop_u64(b->__data, nb, a->__data, na, dst);
+    else if (nb > na * __SORTED_GALLOP_RATIO)
+        out->__len += __sorted_union_gallop_u64(a->__data, na, b->__data, nb, dst);
+    else
+        out->__len += __sorted_union_u64(a->__data, na, b->__data, nb, dst);
+}
+
+void slice_sorted_difference_u32(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    size_t ratio = __SORTED_GALLOP_RATIO;
+#ifdef UTILS_X86
+    uint8_t avx2 = __sorted_use_avx2();
+    if (avx2)
+        ratio = __SORTED_GALLOP_RATIO_AVX2;
+#endif
+    __sorted_prepare(a, b, out, sizeof(uint32_t), na);
+    uint32_t* dst = (uint32_t*)out->__data + out->__len;
+    if (na > nb * ratio || nb > na * ratio) {
+        out->__len += __sorted_difference_gallop_u32(a->__data, na, b->__data, nb, dst);
+        return;
+    }
+#ifdef UTILS_X86
+    if (avx2) {
+        out->__len += __sorted_difference_avx2_u32(a->__data, na, b->__data, nb, dst);
+        return;
+    }
+#endif
+    out->__len += __sorted_difference_scalar_u32(a->__data, na, b->__data, nb, dst);
+}
+
+void slice_sorted_difference_u64(Slice* a, Slice* b, Vec* out) {
+    size_t na = a->__len, nb = b->__len;
+    size_t ratio = __SORTED_GALLOP_RATIO;
+#ifdef UTILS_X86
+    uint8_t avx2 = __sorted_use_avx2();
+    if (avx2)
+        ratio = __SORTED_GALLOP_RATIO_AVX2;
+#endif
+    __sorted_prepare(a, b, out, sizeof(uint64_t), na);
+    uint64_t* dst = (uint64_t*)out->__data + out->__len;
+    if (na > nb * ratio || nb > na * ratio) {
+        out->__len += __sorted_difference_gallop_u64(a->__data, na, b->__data, nb, dst);
+        return;
+    }
+#ifdef UTILS_X86
+    if (avx2) {
+        out->__len += __sorted_difference_avx2_u64(a->__data, na, b->__data, nb, dst);
+        return;
+    }
+#endif
+    out->__len += __sorted_difference_scalar_u64(a->__data, na, b->__data, nb, dst);
+}
+
+
+/* ----------- VecDeque ------------- */
+
+VecDeque vec_deque_new(size_t item_size) {
+    VecDeque dq = { .__data=NULL, .__item_size=item_size, .__head=0, .__len=0, .__cap=0 };
+    return dq;
+}
+
+VecDeque vec_deque_with_capacity(size_t item_size, size_t cap) {
+    VecDeque dq = vec_deque_new(item_size);
+    if (cap > 0)
+        vec_deque_reserve(&dq, cap);
+    return dq;
+}
+
+size_t vec_deque_len(VecDeque* dq) {
+    return dq->__len;
+}
+
+size_t vec_deque_cap(VecDeque* dq) {
+    return dq->__cap;
+}
+
+/* Pointer to the slot `ind` places after the head, wrapping around the buffer */
+char* __vec_deque_slot(VecDeque* dq, size_t ind) {
+    return (char*)dq->__data + ((dq->__head + ind) & (dq->__cap - 1)) * dq->__item_size;
+}
+
+void vec_deque_reserve(VecDeque* dq, size_t additional) {
+    if (dq->__len + additional <= dq->__cap)
+        return;
+    size_t new_cap = dq->__cap == 0 ? 16 : dq->__cap * 2;
+    while (new_cap < dq->__len + additional)
+        new_cap *= 2;
+
+    size_t size = dq->__item_size;
+    size_t old_cap = dq->__cap;
+    char* data = __buf_realloc(dq->__data, old_cap * size, new_cap * size);
+    if (data == NULL) {
+        fprintf(stderr, "VecDeque resize failure\n");
+        abort();
+    }
+    /* elements that wrapped around to the front of the old buffer
+     * now continue past its end instead */
+    if (dq->__head + dq->__len > old_cap) {
+        size_t wrapped = dq->__head + dq->__len - old_cap;
+        memcpy(data + old_cap * size, data, wrapped * size);
+    }
+    dq->__data = data;
+    dq->__cap = new_cap;
+}
+
+void vec_deque_push_back(VecDeque* dq, void* obj) {
+    if (dq->__len == dq->__cap)
+        vec_deque_reserve(dq, 1);
+    memcpy(__vec_deque_slot(dq, dq->__len), obj, dq->__item_size);
+    dq->__len++;
+}
+
+void vec_deque_push_front(VecDeque* dq, void* obj) {
+    if (dq->__len == dq->__cap)
+        vec_deque_reserve(dq, 1);
+    dq->__head = (dq->__head - 1) & (dq->__cap - 1);
+    memcpy((char*)dq->__data + dq->__head * dq->__item_size, obj, dq->__item_size);
+    dq->__len++;
+}
+
+uint8_t vec_deque_pop_front(VecDeque* dq, void* out) {
+    if (dq->__len == 0)
+        return 0;
+    if (out != NULL)
+        memcpy(out, (char*)dq->__data + dq->__head * dq->__item_size, dq->__item_size);
+    dq->__head = (dq->__head + 1) & (dq->__cap - 1);
+    dq->__len--;
+    return 1;
+}
+
+uint8_t vec_deque_pop_back(VecDeque* dq, void* out) {
+    if (dq->__len == 0)
+        return 0;
+    dq->__len--;
+    if (out != NULL)
+        memcpy(out, __vec_deque_slot(dq, dq->__len), dq->__item_size);
+    return 1;
+}
+
+void* vec_deque_index_ref(VecDeque* dq, size_t ind) {
+    if (ind >= dq->__len) {
+        fprintf(stderr, "Out of bounds: dequelen: %lu, index: %lu\n", dq->__len, ind);
+        abort();
+    }
+    return __vec_deque_slot(dq, ind);
+}
+
+void* vec_deque_front_ref(VecDeque* dq) {
+    return dq->__len == 0 ? NULL : __vec_deque_slot(dq, 0);
+}
+
+void* vec_deque_back_ref(VecDeque* dq) {
+    return dq->__len == 0 ? NULL : __vec_deque_slot(dq, dq->__len - 1);
+}
+
+void vec_deque_as_slices(VecDeque* dq, Slice* first, Slice* second) {
+    size_t size = dq->__item_size;
+    size_t first_len = dq->__len;
+    if (dq->__head + dq->__len > dq->__cap)
+        first_len = dq->__cap - dq->__head;
+    char* head = dq->__data == NULL ? NULL : (char*)dq->__data + dq->__head * size;
+    *first = slice_from_ptr_len(size, head, first_len);
+    *second = slice_from_ptr_len(size, dq->__data, dq->__len - first_len);
+}
+
+void vec_deque_clear(VecDeque* dq, mapFn drop) {
+    if (drop != NULL) {
+        for (size_t i = 0; i < dq->__len; i++)
+            drop(__vec_deque_slot(dq, i));
+    }
+    dq->__head = 0;
+    dq->__len = 0;
+}
+
+void vec_deque_drop_with(VecDeque* dq, mapFn drop) {
+    vec_deque_clear(dq, drop);
+    __buf_free(dq->__data, dq->__cap * dq->__item_size);
+    dq->__data = NULL;
+    dq->__cap = 0;
+}
+
+void vec_deque_drop(void* dq_ptr) {
+    vec_deque_drop_with((VecDeque*)dq_ptr, NULL);
+}
+
+
+/* ----------- BitVec ------------- */
+
+BitVec bit_vec_new() {
+    BitVec bv = { .__words=NULL, .__len=0, .__cap=0 };
+    return bv;
+}
+
+/* Number of 64 bit words holding `bits` bits */
+size_t __bit_words(size_t bits) {
+    return (bits + 63) / 64;
+}
+
+void __bit_vec_reserve_words(BitVec* bv, size_t words) {
+    if (words <= bv->__cap)
         return;
-    vec_iter_ref(v, drop);
-    free(v->__data);
-    v->__len = 0;
-    v->__cap = 0;
+    size_t new_cap = __inc_cap(bv->__cap);
+    if (new_cap < words)
+        new_cap = words;
+    uint64_t* data = __buf_realloc(bv->__words, bv->__cap * sizeof(uint64_t), new_cap * sizeof(uint64_t));
+    if (data == NULL) {
+        fprintf(stderr, "BitVec resize failure\n");
+        abort();
+    }
+    bv->__words = data;
+    bv->__cap = new_cap;
 }
 
-Slice vec_as_slice(Vec* v) {
-    Slice sl = {
-        .__data=v->__data,
-        .__item_size=v->__item_size,
-        .__len=v->__len,
-    };
-    return sl;
+BitVec bit_vec_with_capacity(size_t bits) {
+    BitVec bv = bit_vec_new();
+    __bit_vec_reserve_words(&bv, __bit_words(bits));
+    return bv;
 }
 
-SliceIter vec_iter(Vec* v) {
-    SliceIter iter = {
-        .__data=v->__data,
-        .__item_size=v->__item_size,
-        .__len=v->__len,
-        .__ind=0,
+BitVec bit_vec_zeros(size_t len) {
+    BitVec bv = bit_vec_with_capacity(len);
+    if (len > 0)
+        memset(bv.__words, 0, __bit_words(len) * sizeof(uint64_t));
+    bv.__len = len;
+    return bv;
+}
+
+size_t bit_vec_len(BitVec* bv) {
+    return bv->__len;
+}
+
+void bit_vec_push(BitVec* bv, uint8_t bit) {
+    size_t word = bv->__len / 64;
+    if (bv->__len % 64 == 0) {
+        __bit_vec_reserve_words(bv, word + 1);
+        bv->__words[word] = 0;
+    }
+    bv->__words[word] |= (uint64_t)(bit != 0) << (bv->__len % 64);
+    bv->__len++;
+}
+
+void __bit_vec_check_index(BitVec* bv, size_t ind) {
+    if (ind >= bv->__len) {
+        fprintf(stderr, "Out of bounds: bitveclen: %lu, index: %lu\n", bv->__len, ind);
+        abort();
+    }
+}
+
+uint8_t bit_vec_get(BitVec* bv, size_t ind) {
+    __bit_vec_check_index(bv, ind);
+    return (bv->__words[ind / 64] >> (ind % 64)) & 1;
+}
+
+void bit_vec_set(BitVec* bv, size_t ind) {
+    __bit_vec_check_index(bv, ind);
+    bv->__words[ind / 64] |= (uint64_t)1 << (ind % 64);
+}
+
+void bit_vec_clear(BitVec* bv, size_t ind) {
+    __bit_vec_check_index(bv, ind);
+    bv->__words[ind / 64] &= ~((uint64_t)1 << (ind % 64));
+}
+
+typedef enum { __BIT_AND, __BIT_OR, __BIT_XOR, __BIT_ANDNOT } __BitOp;
+
+uint64_t __bit_op(uint64_t a, uint64_t b, __BitOp op) {
+    switch (op) {
+        case __BIT_AND: return a & b;
+        case __BIT_OR: return a | b;
+        case __BIT_XOR: return a ^ b;
+        default: return a & ~b;
+    }
+}
+
+#ifdef UTILS_X86
+/* Apply `op` to 256 bits at a time, returning the number of words processed */
+UTILS_TARGET("avx2")
+size_t __bit_words_op_avx2(uint64_t* dst, const uint64_t* src, size_t n, __BitOp op) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i r;
+        switch (op) {
+            case __BIT_AND: r = _mm256_and_si256(a, b); break;
+            case __BIT_OR: r = _mm256_or_si256(a, b); break;
+            case __BIT_XOR: r = _mm256_xor_si256(a, b); break;
+            default: r = _mm256_andnot_si256(b, a); break;
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), r);
+    }
+    return i;
+}
+#endif
+
+void __bit_vec_op(BitVec* dst, BitVec* src, __BitOp op) {
+    if (dst->__len != src->__len) {
+        fprintf(stderr, "Mismatched BitVec lengths: %lu, %lu\n", dst->__len, src->__len);
+        abort();
+    }
+    size_t n = __bit_words(dst->__len);
+    size_t i = 0;
+#ifdef UTILS_X86
+    if (n >= 4 && __builtin_cpu_supports("avx2"))
+        i = __bit_words_op_avx2(dst->__words, src->__words, n, op);
+#endif
+    for (; i < n; i++)
+        dst->__words[i] = __bit_op(dst->__words[i], src->__words[i], op);
+}
+
+void bit_vec_and(BitVec* dst, BitVec* src) {
+    __bit_vec_op(dst, src, __BIT_AND);
+}
+
+void bit_vec_or(BitVec* dst, BitVec* src) {
+    __bit_vec_op(dst, src, __BIT_OR);
+}
+
+void bit_vec_xor(BitVec* dst, BitVec* src) {
+    __bit_vec_op(dst, src, __BIT_XOR);
+}
+
+void bit_vec_andnot(BitVec* dst, BitVec* src) {
+    __bit_vec_op(dst, src, __BIT_ANDNOT);
+}
+
+#ifdef UTILS_X86
+/* Count the ones in 256 bits at a time by looking up the count of each nibble,
+ * see https://arxiv.org/abs/1611.07612. Returns the number of words processed.
+ */
+UTILS_TARGET("avx2")
+size_t __popcount_words_avx2(const uint64_t* words, size_t n, uint64_t* count) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+        __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+        /* sum the byte counts of each 64 bit lane */
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    *count += (uint64_t)_mm256_extract_epi64(total, 0) + (uint64_t)_mm256_extract_epi64(total, 1)
+            + (uint64_t)_mm256_extract_epi64(total, 2) + (uint64_t)_mm256_extract_epi64(total, 3);
+    return i;
+}
+
+UTILS_TARGET("popcnt")
+uint64_t __popcount_words_popcnt(const uint64_t* words, size_t n) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        count += (uint64_t)__builtin_popcountll(words[i]);
+    return count;
+}
+#endif
+
+/* Count the ones in `n` words */
+uint64_t __popcount_words(const uint64_t* words, size_t n) {
+    uint64_t count = 0;
+    size_t i = 0;
+#ifdef UTILS_X86
+    if (n >= 16 && __builtin_cpu_supports("avx2"))
+        i = __popcount_words_avx2(words, n, &count);
+    if (__builtin_cpu_supports("popcnt"))
+        return count + __popcount_words_popcnt(words + i, n - i);
+#endif
+    for (; i < n; i++)
+        count += (uint64_t)__popcount64(words[i]);
+    return count;
+}
+
+uint64_t bit_vec_count_ones(BitVec* bv) {
+    return __popcount_words(bv->__words, __bit_words(bv->__len));
+}
+
+BitVecIter bit_vec_iter(BitVec* bv) {
+    BitVecIter iter = {
+        .__words=bv->__words,
+        .__num_words=__bit_words(bv->__len),
+        .__word_ind=0,
+        .__bits=bv->__len > 0 ? bv->__words[0] : 0,
     };
     return iter;
 }
 
+uint8_t bit_vec_iter_done(BitVecIter* iter) {
+    while (iter->__bits == 0) {
+        if (++iter->__word_ind >= iter->__num_words)
+            return 1;
+        iter->__bits = iter->__words[iter->__word_ind];
+    }
+    return 0;
+}
+
+size_t bit_vec_iter_next(BitVecIter* iter) {
+    size_t ind = iter->__word_ind * 64 + (size_t)__ctz64(iter->__bits);
+    iter->__bits &= iter->__bits - 1;
+    return ind;
+}
 
-/* ----------- Slice ------------- */
+void bit_vec_drop(void* bv_ptr) {
+    BitVec* bv = (BitVec*)bv_ptr;
+    __buf_free(bv->__words, bv->__cap * sizeof(uint64_t));
+    bv->__words = NULL;
+    bv->__len = 0;
+    bv->__cap = 0;
+}
 
-void* slice_index_ref(Slice* sl, size_t ind) {
-    if (ind >= sl->__len) {
-        fprintf(stderr, "Out of bounds: len: %lu, index: %lu\n", sl->__len, ind);
+
+/* ----------- RankSelect ------------- */
+
+/* Bits covered by each cumulative count */
+#define __RANK_BLOCK_BITS 512
+#define __RANK_BLOCK_WORDS (__RANK_BLOCK_BITS / 64)
+/* Ones between the select hints, which narrow the search over the blocks */
+#define __SELECT_SAMPLE 1024
+
+RankSelect rank_select_new(BitVec* bv) {
+    size_t num_words = __bit_words(bv->__len);
+    size_t num_blocks = (num_words + __RANK_BLOCK_WORDS - 1) / __RANK_BLOCK_WORDS;
+    RankSelect rs = {
+        .__words=bv->__words,
+        .__len=bv->__len,
+        .__blocks=malloc((num_blocks + 1) * sizeof(uint64_t)),
+        .__num_blocks=num_blocks,
+        .__hints=vec_new(sizeof(size_t)),
+    };
+    if (rs.__blocks == NULL) {
+        fprintf(stderr, "RankSelect alloc failure\n");
         abort();
     }
-    return slice_index_ref_unchecked(sl, ind);
+    uint64_t ones = 0;
+    for (size_t b = 0; b < num_blocks; b++) {
+        rs.__blocks[b] = ones;
+        size_t first = b * __RANK_BLOCK_WORDS;
+        size_t words = num_words - first < __RANK_BLOCK_WORDS ? num_words - first : __RANK_BLOCK_WORDS;
+        uint64_t block_ones = __popcount_words(bv->__words + first, words);
+        /* hint the block holding every `__SELECT_SAMPLE`th one */
+        while (vec_len(&rs.__hints) * __SELECT_SAMPLE < ones + block_ones)
+            vec_push(&rs.__hints, &b);
+        ones += block_ones;
+    }
+    rs.__blocks[num_blocks] = ones;
+    return rs;
 }
 
-inline void* slice_index_ref_unchecked(Slice* sl, size_t ind) {
-    char* offset = (char*)sl->__data + (ind * sl->__item_size);
-    return (void*)offset;
+uint64_t rank_select_count_ones(RankSelect* rs) {
+    return rs->__blocks[rs->__num_blocks];
 }
 
-Slice slice_from_ptr_len(size_t item_size, const void* ptr, size_t len) {
-    Slice sl = { .__data=ptr, .__item_size=item_size, .__len=len };
-    return sl;
+#ifdef UTILS_X86
+UTILS_TARGET("popcnt")
+uint64_t __rank_words_popcnt(const uint64_t* words, size_t first, size_t ind) {
+    uint64_t ones = 0;
+    for (size_t w = first; w < ind / 64; w++)
+        ones += (uint64_t)__builtin_popcountll(words[w]);
+    if (ind % 64 != 0)
+        ones += (uint64_t)__builtin_popcountll(words[ind / 64] << (64 - ind % 64));
+    return ones;
 }
 
-SliceIter slice_iter(Slice* sl) {
-    SliceIter iter = {
-        .__data=(void*)sl->__data,
-        .__item_size=sl->__item_size,
-        .__len=sl->__len,
-        .__ind=0,
+UTILS_TARGET("popcnt")
+size_t __select_word_popcnt(const uint64_t* words, size_t word, uint64_t* k) {
+    for (;;) {
+        uint64_t word_ones = (uint64_t)__builtin_popcountll(words[word]);
+        if (*k < word_ones)
+            return word;
+        *k -= word_ones;
+        word++;
+    }
+}
+#endif
+
+/* Ones before bit `ind` of the words from `first`, which is at or before its word */
+uint64_t __rank_words(const uint64_t* words, size_t first, size_t ind) {
+#ifdef UTILS_X86
+    if (__builtin_cpu_supports("popcnt"))
+        return __rank_words_popcnt(words, first, ind);
+#endif
+    uint64_t ones = 0;
+    for (size_t w = first; w < ind / 64; w++)
+        ones += (uint64_t)__popcount64(words[w]);
+    if (ind % 64 != 0)
+        ones += (uint64_t)__popcount64(words[ind / 64] << (64 - ind % 64));
+    return ones;
+}
+
+/* Index of the word from `word` holding the `k`th one, leaving `k` as the ones before it in that word */
+size_t __select_word(const uint64_t* words, size_t word, uint64_t* k) {
+#ifdef UTILS_X86
+    if (__builtin_cpu_supports("popcnt"))
+        return __select_word_popcnt(words, word, k);
+#endif
+    for (;;) {
+        uint64_t word_ones = (uint64_t)__popcount64(words[word]);
+        if (*k < word_ones)
+            return word;
+        *k -= word_ones;
+        word++;
+    }
+}
+
+uint64_t rank_select_rank(RankSelect* rs, size_t ind) {
+    if (ind > rs->__len) {
+        fprintf(stderr, "Out of bounds: bitveclen: %lu, rank-index: %lu\n", rs->__len, ind);
+        abort();
+    }
+    size_t word = ind / 64;
+    size_t block = word / __RANK_BLOCK_WORDS;
+    if (block == rs->__num_blocks)
+        return rs->__blocks[block];
+    return rs->__blocks[block] + __rank_words(rs->__words, block * __RANK_BLOCK_WORDS, ind);
+}
+
+#ifdef UTILS_X86
+UTILS_TARGET("bmi2")
+int __select64_bmi2(uint64_t w, unsigned k) {
+    return __ctz64(_pdep_u64((uint64_t)1 << k, w));
+}
+#endif
+
+/* Position of the `k`th (from 0) one of `w`, which has more than `k` ones */
+int __select64(uint64_t w, unsigned k) {
+#ifdef UTILS_X86
+    if (__builtin_cpu_supports("bmi2"))
+        return __select64_bmi2(w, k);
+#endif
+    int shift = 0;
+    for (;;) {
+        unsigned byte_ones = (unsigned)__popcount64(w & 0xff);
+        if (k < byte_ones)
+            break;
+        k -= byte_ones;
+        w >>= 8;
+        shift += 8;
+    }
+    while (k-- > 0)
+        w &= w - 1;
+    return shift + __ctz64(w);
+}
+
+size_t rank_select_select(RankSelect* rs, uint64_t k) {
+    if (k >= rank_select_count_ones(rs))
+        return rs->__len;
+    /* the last block starting with at most `k` ones holds the one */
+    size_t lo = *(size_t*)vec_index_ref_unchecked(&rs->__hints, k / __SELECT_SAMPLE);
+    size_t hi = k / __SELECT_SAMPLE + 1 < vec_len(&rs->__hints)
+        ? *(size_t*)vec_index_ref_unchecked(&rs->__hints, k / __SELECT_SAMPLE + 1) + 1
+        : rs->__num_blocks;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rs->__blocks[mid] <= k)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    k -= rs->__blocks[lo];
+    size_t word = __select_word(rs->__words, lo * __RANK_BLOCK_WORDS, &k);
+    return word * 64 + (size_t)__select64(rs->__words[word], (unsigned)k);
+}
+
+void rank_select_drop(void* rs_ptr) {
+    RankSelect* rs = (RankSelect*)rs_ptr;
+    free(rs->__blocks);
+    rs->__blocks = NULL;
+    vec_drop(&rs->__hints);
+}
+
+
+/* ----------- PriorityQueue ------------- */
+
+/* d-ary heap helpers shared by `PriorityQueue` and `slice_top_k`. An element moves
+ * above its parent when it compares as `up` to it: `CMP_GREATER` for a max-heap and
+ * `CMP_LESS` for a min-heap. The moving element waits in `hole` while the elements
+ * it passes are shifted over it, one copy per level instead of a swap.
+ */
+void __heap_sift_up(char* base, size_t size, size_t arity, cmpFn cmp,
+                    CmpOrdering up, size_t ind, void* hole) {
+    __elem_copy(hole, base + ind * size, size);
+    while (ind > 0) {
+        size_t parent = (ind - 1) / arity;
+        if (cmp(hole, base + parent * size) != up)
+            break;
+        __elem_copy(base + ind * size, base + parent * size, size);
+        ind = parent;
+    }
+    __elem_copy(base + ind * size, hole, size);
+}
+
+void __heap_sift_down(char* base, size_t size, size_t len, size_t arity, cmpFn cmp,
+                      CmpOrdering up, size_t ind, void* hole) {
+    __elem_copy(hole, base + ind * size, size);
+    for (;;) {
+        size_t first = ind * arity + 1;
+        if (first >= len)
+            break;
+        size_t last = first + arity < len ? first + arity : len;
+        size_t best = first;
+        for (size_t child = first + 1; child < last; child++) {
+            if (cmp(base + child * size, base + best * size) == up)
+                best = child;
+        }
+        if (cmp(base + best * size, hole) != up)
+            break;
+        __elem_copy(base + ind * size, base + best * size, size);
+        ind = best;
+    }
+    __elem_copy(base + ind * size, hole, size);
+}
+
+/* Floyd's bottom-up construction, sifting down every parent from the last one */
+void __heapify(char* base, size_t size, size_t len, size_t arity, cmpFn cmp,
+               CmpOrdering up, void* hole) {
+    if (len < 2)
+        return;
+    size_t parent = (len - 2) / arity + 1;
+    while (parent-- > 0)
+        __heap_sift_down(base, size, len, arity, cmp, up, parent, hole);
+}
+
+PriorityQueue priority_queue_new(size_t item_size, cmpFn cmp_func) {
+    return priority_queue_with_arity(item_size, cmp_func, 4);
+}
+
+PriorityQueue priority_queue_with_arity(size_t item_size, cmpFn cmp_func, size_t arity) {
+    Vec v = vec_new(item_size);
+    return priority_queue_from_vec(&v, cmp_func, arity);
+}
+
+PriorityQueue priority_queue_from_vec(Vec* v, cmpFn cmp_func, size_t arity) {
+    if (arity < 2) {
+        fprintf(stderr, "PriorityQueue arity must be at least 2, got: %lu\n", arity);
+        abort();
+    }
+    PriorityQueue pq = {
+        .__data=*v,
+        .__cmp=cmp_func,
+        .__arity=arity,
+        .__tmp=malloc(v->__item_size),
     };
-    return iter;
+    if (pq.__tmp == NULL) {
+        fprintf(stderr, "PriorityQueue alloc failure\n");
+        abort();
+    }
+    *v = vec_new(v->__item_size);
+    __heapify(pq.__data.__data, pq.__data.__item_size, pq.__data.__len,
+              arity, cmp_func, CMP_GREATER, pq.__tmp);
+    return pq;
 }
 
-uint8_t slice_iter_done(SliceIter* iter) {
-    return iter->__ind < iter->__len ? 1 : 0;
+size_t priority_queue_len(PriorityQueue* pq) {
+    return pq->__data.__len;
 }
 
-void* slice_iter_next(SliceIter* iter) {
-    char* ref = (char*)iter->__data + iter->__item_size * iter->__ind;
-    iter->__ind++;
-    return (void*)ref;
+void priority_queue_push(PriorityQueue* pq, void* obj) {
+    vec_push(&pq->__data, obj);
+    __heap_sift_up(pq->__data.__data, pq->__data.__item_size, pq->__arity, pq->__cmp,
+                   CMP_GREATER, pq->__data.__len - 1, pq->__tmp);
+}
+
+void* priority_queue_peek(PriorityQueue* pq) {
+    if (pq->__data.__len == 0)
+        return NULL;
+    return pq->__data.__data;
+}
+
+uint8_t priority_queue_pop(PriorityQueue* pq, void* out) {
+    size_t len = pq->__data.__len;
+    if (len == 0)
+        return 0;
+    size_t size = pq->__data.__item_size;
+    char* base = pq->__data.__data;
+    if (out != NULL)
+        memcpy(out, base, size);
+    len--;
+    pq->__data.__len = len;
+    if (len > 0) {
+        __elem_copy(base, base + len * size, size);
+        __heap_sift_down(base, size, len, pq->__arity, pq->__cmp, CMP_GREATER, 0, pq->__tmp);
+    }
+    return 1;
+}
+
+uint8_t priority_queue_replace_top(PriorityQueue* pq, void* obj, void* out) {
+    if (pq->__data.__len == 0) {
+        priority_queue_push(pq, obj);
+        return 0;
+    }
+    size_t size = pq->__data.__item_size;
+    char* base = pq->__data.__data;
+    if (out != NULL)
+        memcpy(out, base, size);
+    memcpy(base, obj, size);
+    __heap_sift_down(base, size, pq->__data.__len, pq->__arity, pq->__cmp, CMP_GREATER, 0, pq->__tmp);
+    return 1;
+}
+
+Vec priority_queue_into_vec(PriorityQueue* pq) {
+    Vec v = pq->__data;
+    pq->__data = vec_new(v.__item_size);
+    free(pq->__tmp);
+    pq->__tmp = NULL;
+    return v;
+}
+
+void priority_queue_drop_with(PriorityQueue* pq, mapFn drop) {
+    vec_drop_with(&pq->__data, drop);
+    free(pq->__tmp);
+    pq->__tmp = NULL;
+}
+
+void priority_queue_drop(void* pq_ptr) {
+    PriorityQueue* pq = (PriorityQueue*)pq_ptr;
+    vec_drop(&pq->__data);
+    free(pq->__tmp);
+    pq->__tmp = NULL;
+}
+
+Vec slice_top_k(Slice* sl, size_t k, cmpFn cmp_func) {
+    size_t size = sl->__item_size;
+    size_t n = sl->__len;
+    if (k > n)
+        k = n;
+    Vec top = vec_with_capacity(size, k);
+    if (k == 0)
+        return top;
+    char* hole = malloc(size);
+    if (hole == NULL) {
+        fprintf(stderr, "Slice top-k alloc failure\n");
+        abort();
+    }
+    /* min-heap of the greatest `k` so far, whose root is the one to beat */
+    const char* data = sl->__data;
+    char* base = top.__data;
+    memcpy(base, data, k * size);
+    top.__len = k;
+    __heapify(base, size, k, 4, cmp_func, CMP_LESS, hole);
+    for (size_t i = k; i < n; i++) {
+        const char* elem = data + i * size;
+        if (cmp_func((void*)elem, base) == CMP_GREATER) {
+            __elem_copy(base, elem, size);
+            __heap_sift_down(base, size, k, 4, cmp_func, CMP_LESS, 0, hole);
+        }
+    }
+    /* repeatedly retire the least remaining element to the back */
+    for (size_t len = k; len > 1; len--) {
+        __elem_swap(base, base + (len - 1) * size, hole, size);
+        __heap_sift_down(base, size, len - 1, 4, cmp_func, CMP_LESS, 0, hole);
+    }
+    free(hole);
+    return top;
+}
+
+
+/* ----------- SoaVec ------------- */
+
+/* Column buffers are aligned to cache lines, and so to any SIMD register width */
+#define __SOA_ALIGN 64
+
+SoaVec soa_vec_new(const size_t* column_sizes, size_t num_columns) {
+    if (num_columns == 0) {
+        fprintf(stderr, "SoaVec requires at least one column\n");
+        abort();
+    }
+    SoaVec sv = {
+        .__buffers=calloc(num_columns, sizeof(char*)),
+        .__columns=calloc(num_columns, sizeof(char*)),
+        .__sizes=malloc(num_columns * sizeof(size_t)),
+        .__num_columns=num_columns,
+        .__row_size=0,
+        .__len=0,
+        .__cap=0,
+    };
+    if (sv.__buffers == NULL || sv.__columns == NULL || sv.__sizes == NULL) {
+        fprintf(stderr, "SoaVec alloc failure\n");
+        abort();
+    }
+    for (size_t col = 0; col < num_columns; col++) {
+        if (column_sizes[col] == 0) {
+            fprintf(stderr, "SoaVec column %lu has zero size\n", col);
+            abort();
+        }
+        sv.__sizes[col] = column_sizes[col];
+        sv.__row_size += column_sizes[col];
+    }
+    return sv;
+}
+
+SoaVec soa_vec_with_capacity(const size_t* column_sizes, size_t num_columns, size_t cap) {
+    SoaVec sv = soa_vec_new(column_sizes, num_columns);
+    if (cap > 0)
+        soa_vec_reserve(&sv, cap);
+    return sv;
+}
+
+size_t soa_vec_len(SoaVec* sv) {
+    return sv->__len;
+}
+
+size_t soa_vec_num_columns(SoaVec* sv) {
+    return sv->__num_columns;
+}
+
+size_t soa_vec_row_size(SoaVec* sv) {
+    return sv->__row_size;
+}
+
+/* Each column starts at the first aligned address of its buffer, which has
+ * `__SOA_ALIGN` spare bytes. Growing with `__buf_realloc` keeps realloc's and
+ * mremap's in place growth, the data is only shifted when the offset changes.
+ */
+char* __soa_align(char* buffer) {
+    return (char*)(((uintptr_t)buffer + __SOA_ALIGN - 1) & ~(uintptr_t)(__SOA_ALIGN - 1));
+}
+
+void soa_vec_reserve(SoaVec* sv, size_t additional) {
+    if (sv->__len + additional <= sv->__cap)
+        return;
+    size_t new_cap = __inc_cap(sv->__cap);
+    if (new_cap < 16)
+        new_cap = 16;
+    if (new_cap < sv->__len + additional)
+        new_cap = sv->__len + additional;
+    for (size_t col = 0; col < sv->__num_columns; col++) {
+        size_t size = sv->__sizes[col];
+        char* old_buffer = sv->__buffers[col];
+        size_t old_bytes = old_buffer == NULL ? 0 : sv->__cap * size + __SOA_ALIGN;
+        size_t old_offset = old_buffer == NULL ? 0 : (size_t)(sv->__columns[col] - old_buffer);
+        size_t new_bytes = new_cap * size + __SOA_ALIGN;
+        /* a buffer switching to a mapping is copied anyway, straight to its aligned start */
+        uint8_t remap = old_buffer != NULL && !__buf_is_mapped(old_bytes) && __buf_is_mapped(new_bytes);
+        char* buffer = remap ? __buf_alloc(new_bytes) : __buf_realloc(old_buffer, old_bytes, new_bytes);
+        if (buffer == NULL) {
+            fprintf(stderr, "SoaVec resize failure\n");
+            abort();
+        }
+        char* column = __soa_align(buffer);
+        if (remap) {
+            memcpy(column, sv->__columns[col], sv->__len * size);
+            __buf_free(old_buffer, old_bytes);
+        } else if ((size_t)(column - buffer) != old_offset) {
+            memmove(column, buffer + old_offset, sv->__len * size);
+        }
+        sv->__buffers[col] = buffer;
+        sv->__columns[col] = column;
+    }
+    sv->__cap = new_cap;
+}
+
+void soa_vec_push_row(SoaVec* sv, const void* row) {
+    if (sv->__len == sv->__cap)
+        soa_vec_reserve(sv, 1);
+    const char* field = row;
+    for (size_t col = 0; col < sv->__num_columns; col++) {
+        size_t size = sv->__sizes[col];
+        __elem_copy(sv->__columns[col] + sv->__len * size, field, size);
+        field += size;
+    }
+    sv->__len++;
+}
+
+void __soa_vec_check_index(SoaVec* sv, size_t col, size_t ind) {
+    if (col >= sv->__num_columns || ind >= sv->__len) {
+        fprintf(stderr, "Out of bounds: soaveclen: %lu, columns: %lu, column: %lu, index: %lu\n",
+                sv->__len, sv->__num_columns, col, ind);
+        abort();
+    }
+}
+
+void soa_vec_get_row(SoaVec* sv, size_t ind, void* out) {
+    __soa_vec_check_index(sv, 0, ind);
+    char* field = out;
+    for (size_t col = 0; col < sv->__num_columns; col++) {
+        size_t size = sv->__sizes[col];
+        __elem_copy(field, sv->__columns[col] + ind * size, size);
+        field += size;
+    }
+}
+
+void* soa_vec_column_ref(SoaVec* sv, size_t col, size_t ind) {
+    __soa_vec_check_index(sv, col, ind);
+    return sv->__columns[col] + ind * sv->__sizes[col];
+}
+
+Slice soa_vec_column(SoaVec* sv, size_t col) {
+    if (col >= sv->__num_columns) {
+        fprintf(stderr, "Out of bounds: columns: %lu, column: %lu\n", sv->__num_columns, col);
+        abort();
+    }
+    Slice sl = {
+        .__data=sv->__columns[col],
+        .__item_size=sv->__sizes[col],
+        .__len=sv->__len,
+    };
+    return sl;
+}
+
+void soa_vec_clear(SoaVec* sv) {
+    sv->__len = 0;
+}
+
+void soa_vec_drop(void* sv_ptr) {
+    SoaVec* sv = (SoaVec*)sv_ptr;
+    if (sv->__buffers != NULL) {
+        for (size_t col = 0; col < sv->__num_columns; col++)
+            __buf_free(sv->__buffers[col], sv->__cap * sv->__sizes[col] + __SOA_ALIGN);
+    }
+    free(sv->__buffers);
+    free(sv->__columns);
+    free(sv->__sizes);
+    sv->__buffers = NULL;
+    sv->__columns = NULL;
+    sv->__sizes = NULL;
+    sv->__len = 0;
+    sv->__cap = 0;
 }
 
 
@@ -4,6 +4,13 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+/* Have the compiler check printf-style format strings */
+#ifdef __GNUC__
+#define UTILS_PRINTF_FMT(fmt_ind, args_ind) __attribute__((format(printf, fmt_ind, args_ind)))
+#else
+#define UTILS_PRINTF_FMT(fmt_ind, args_ind)
+#endif
+
 
 /* String
  *
@@ -24,6 +31,30 @@ typedef struct {
 } Str;
 
 
+/* StrCharIter
+ * Iterator decoding the UTF-8 codepoints of a Str.
+ */
+typedef struct {
+    const char* __data;
+    size_t __len, __ind;
+} StrCharIter;
+
+
+/* HashedStr
+ * Borrowed slice of a string carrying its precomputed hash,
+ * so repeated `HashMap` operations never rehash the contents.
+ */
+typedef struct {
+    Str __str;
+    uint64_t __hash;
+} HashedStr;
+
+
+/* Describe the result of parsing a number from a `Str`
+ */
+typedef enum { PARSE_OK, PARSE_EMPTY, PARSE_INVALID, PARSE_OVERFLOW } ParseStatus;
+
+
 /* Vec
  * Owned array of generic data of `__item_size`
  */
@@ -51,6 +82,176 @@ typedef struct {
 } SliceIter;
 
 
+/* StringBuilder
+ * Append-only string assembled from a list of owned chunks.
+ * Chunks are never reallocated, so appending never recopies
+ * previously pushed data.
+ */
+typedef struct {
+    Vec __chunks;
+    size_t __chunk_size, __len;
+} StringBuilder;
+
+
+/* Symbol
+ * Compact identifier of a string interned in a `StringInterner`.
+ * Two symbols from the same interner are equal iff their strings are equal.
+ */
+typedef uint32_t Symbol;
+
+
+/* StringInterner
+ * Deduplicates strings into a bump arena, assigning each distinct
+ * string a `Symbol`. Interned strings live as long as the interner.
+ */
+typedef struct {
+    Vec __blocks;
+    char* __cursor;
+    size_t __avail;
+    Vec __strs;
+    Vec __hashes;
+    uint32_t* __table;
+    size_t __table_cap;
+} StringInterner;
+
+
+/* MappedFile
+ * Read-only memory mapping of a whole file, unmapped on drop.
+ */
+typedef struct {
+    const char* __data;
+    size_t __len;
+} MappedFile;
+
+
+/* LineReader
+ * Reads lines from a file descriptor through a reusable buffer of
+ * fixed size blocks, so memory stays bounded regardless of file size.
+ */
+typedef struct {
+    int __fd;
+    char* __buf;
+    size_t __cap, __start, __end, __scan;
+    int64_t __offset;
+    uint8_t __eof;
+    int __error;
+} LineReader;
+
+
+/* BufWriter
+ * Buffers small writes to a file descriptor, so output costs
+ * one `writev` per buffer full rather than one call per write.
+ */
+typedef struct {
+    int __fd;
+    char* __buf;
+    size_t __cap, __len;
+    int __error;
+    size_t __syscalls;
+} BufWriter;
+
+
+/* CsvReader
+ * Streaming RFC 4180 reader over a borrowed buffer, yielding each row
+ * as a `Slice` of `Str` fields. The input is classified 64 bytes at a time
+ * into bitmasks of the delimiters and line breaks that fall outside quotes.
+ */
+typedef struct {
+    const char* __data;
+    size_t __len, __pos;
+    size_t __block, __bits_base;
+    uint64_t __bits, __quote_carry;
+    char __delim;
+    Vec __fields;
+    Vec __escaped;
+    String __scratch;
+} CsvReader;
+
+
+/* MultiPattern
+ * Aho-Corasick automaton matching a set of patterns in a single pass,
+ * compiled to a DFA over byte equivalence classes.
+ */
+typedef struct {
+    uint8_t __classes[256];
+    size_t __num_classes, __num_states, __num_patterns;
+    uint32_t* __delta;
+    uint32_t* __own;
+    uint32_t* __dict;
+    uint32_t* __output;
+    size_t* __pattern_lens;
+    uint8_t __start_bytes[3];
+    size_t __num_start_bytes;
+} MultiPattern;
+
+/* PatternMatch
+ * Occurrence of the pattern at index `pattern` spanning bytes `[start, end)`
+ */
+typedef struct {
+    size_t pattern;
+    size_t start, end;
+} PatternMatch;
+
+/* EytzingerIndex
+ * Immutable copy of sorted elements in Eytzinger (breadth-first) order,
+ * so the first levels of every search share the same few cache lines.
+ */
+typedef struct {
+    void* __data;
+    size_t __item_size;
+    size_t __len;
+} EytzingerIndex;
+
+/* VecDeque
+ * Double-ended queue of arbitrary elements in a growable ring buffer,
+ * whose capacity is always a power of two
+ */
+typedef struct {
+    void* __data;
+    size_t __item_size, __head, __len, __cap;
+} VecDeque;
+
+/* BitVec
+ * Growable vector of bits, packed into 64bit words
+ */
+typedef struct {
+    uint64_t* __words;
+    size_t __len, __cap;
+} BitVec;
+
+/* BitVecIter
+ * Iterator over the indices of the set bits of a `BitVec`
+ */
+typedef struct {
+    const uint64_t* __words;
+    size_t __num_words, __word_ind;
+    uint64_t __bits;
+} BitVecIter;
+
+/* RankSelect
+ * Immutable rank/select index over the bits of a `BitVec`, borrowing its words.
+ * Keeps a count of the preceding ones every 512 bits, 1/8 of the bits' memory.
+ */
+typedef struct {
+    const uint64_t* __words;
+    size_t __len;
+    uint64_t* __blocks;
+    size_t __num_blocks;
+    Vec __hints;
+} RankSelect;
+
+/* SoaVec
+ * Structure-of-arrays container of rows, storing each of `__num_columns` columns,
+ * of `__sizes[i]` bytes per element, in its own 64-byte aligned buffer
+ */
+typedef struct {
+    char** __buffers;
+    char** __columns;
+    size_t* __sizes;
+    size_t __num_columns, __row_size, __len, __cap;
+} SoaVec;
+
+
 /* Function used to modify elements in a container
  * Used by containers, like `Vec`, as a "drop function" to allow
  * cleaning up elements, which may be or contain owned pointers
@@ -86,6 +287,35 @@ typedef CmpOrdering (*cmpFn)(void*, void*);
  */
 typedef uint64_t (*hashFn)(void*);
 
+/* Functions extracting the sort key of an element, used by the
+ * `vec_radix_sort_by_*` functions.
+ */
+typedef uint32_t (*keyU32Fn)(void*);
+typedef uint64_t (*keyU64Fn)(void*);
+typedef int64_t (*keyI64Fn)(void*);
+typedef double (*keyF64Fn)(void*);
+
+/* Function applied to each line by `parallel_for_lines`,
+ * along with the context of the thread processing the line.
+ */
+typedef void (*lineFn)(Str*, void*);
+
+/* Function merging the second context into the first,
+ * used to combine per-thread results.
+ */
+typedef void (*mergeFn)(void*, void*);
+
+/* PriorityQueue
+ * Heap of arbitrary elements with `__arity` children per node, ordered by
+ * a `cmpFn` so that the greatest element is always on top
+ */
+typedef struct {
+    Vec __data;
+    cmpFn __cmp;
+    size_t __arity;
+    void* __tmp;
+} PriorityQueue;
+
 /* HashMap
  * Generic hashmap container
  * Requires user to provide `hashFn` (hash-key),
@@ -131,6 +361,9 @@ void utils_noop();
 /* Apply the fnv-1 64bit hash function to an arbitrary set of bytes */
 uint64_t fnv_64(void* ptr, size_t num_bytes);
 
+/* Return the number of cpus this process can run on, at least 1 */
+size_t utils_num_cpus();
+
 
 /* -------------------------- */
 /* ---- String functions ---- */
@@ -155,6 +388,16 @@ String string_copy_from_cstr(const char* cstr);
  */
 String read_file(const char* path);
 
+/* Read the contents of the `n` files at `paths` into `out[0..n]`, returning the number
+ * of files that couldn't be read. Unlike `read_file`, failures don't abort: the
+ * failed `out` entry is set to an empty `String` and, when `errors` is non-NULL,
+ * `errors[i]` is set to the `errno` of the failure (0 on success).
+ * On Linux the opens, stats and reads of many files are kept in flight at once
+ * through io_uring, otherwise (or if io_uring is unavailable) files are read
+ * by a pool of threads, so disk latency overlaps across files.
+ */
+size_t read_files_batch(const char** paths, size_t n, String* out, int* errors);
+
 /* Return current `String` length */
 size_t string_len(String* s);
 
@@ -174,13 +417,31 @@ void string_push_char(String* s, char c);
 void string_push_str(String* s, Str* str);
 
 /* Push at most `str_len` bytes copied from a `char*` onto the end of the String, resizing if necessary.
- * `str_len` bytes is expected to be the size of the cstr not including the trailing null byte.
+ * Copying stops early at a null byte, so `str_len` may be the size of the buffer holding the cstr.
  */
 void string_push_cstr_bound(String* s, const char* cstr, size_t str_len);
 
 /* Same as `string_push_cstr_bound` except all of the char* up to the null byte will be pushed */
 void string_push_cstr(String* s, const char* cstr);
 
+/* Push the base 10 representation of a `uint64_t`, written directly into the String's capacity */
+void string_push_u64(String* s, uint64_t v);
+
+/* Push the base 10 representation of an `int64_t`, written directly into the String's capacity */
+void string_push_i64(String* s, int64_t v);
+
+/* Push the shortest representation of a `double` that parses back to the same value
+ * (computed with the Ryu algorithm), written directly into the String's capacity.
+ * Formatting follows JavaScript's number to string rules, except that exponents
+ * don't have a `+`: `0.1`, `-42`, `1e21`, `1.5e-7`, `nan`, `inf`, `-inf`.
+ */
+void string_push_f64(String* s, double v);
+
+/* Push printf-style formatted output, written directly into the String's spare capacity.
+ * The String is resized (once) only if the output doesn't fit.
+ */
+void string_push_fmt(String* s, const char* fmt, ...) UTILS_PRINTF_FMT(2, 3);
+
 /* Index into a String */
 char string_index(String* s, size_t ind);
 
@@ -194,9 +455,30 @@ char* string_index_ref(String* s, size_t ind);
  */
 uint8_t string_eq(void* s1, void* s2);
 
+/* Compare two `String`s lexicographically by their bytes (as unsigned chars),
+ * a shorter `String` that is a prefix of the other orders first.
+ */
+CmpOrdering string_cmp(void* s1, void* s2);
+
 /* Calculate the hash of a `String` and its contents */
 uint64_t string_hash(void* s);
 
+/* Compare two `String`s for equality ignoring ASCII case, returning a non-zero value
+ * when `String`s are unequal. Bytes outside `A-Z`/`a-z` must match exactly.
+ */
+uint8_t string_eq_ignore_ascii_case(void* s1, void* s2);
+
+/* Calculate a hash of a `String` that ignores ASCII case, consistent with
+ * `string_eq_ignore_ascii_case`. Equal to the `string_hash` of the lowercased `String`.
+ */
+uint64_t string_hash_ignore_ascii_case(void* s);
+
+/* Convert `A-Z` to `a-z` in place, leaving all other bytes untouched */
+void string_make_ascii_lowercase(String* s);
+
+/* Convert `a-z` to `A-Z` in place, leaving all other bytes untouched */
+void string_make_ascii_uppercase(String* s);
+
 /* Convert String to a Str */
 Str string_as_str(String* s);
 
@@ -232,6 +514,58 @@ void string_clear(String* s);
 void string_drop(void* string_ptr);
 
 
+/* -------------------------- */
+/* -- StringBuilder functions */
+/* -------------------------- */
+/* Default size of the chunks allocated by a `StringBuilder` */
+#define STRING_BUILDER_CHUNK_SIZE 65536
+
+/* Construct a new empty `StringBuilder` using `STRING_BUILDER_CHUNK_SIZE` chunks */
+StringBuilder string_builder_new();
+
+/* Construct a new empty `StringBuilder` that allocates chunks of `chunk_size` bytes.
+ * Fragments larger than `chunk_size` are stored in a dedicated chunk of their own size.
+ */
+StringBuilder string_builder_with_chunk_size(size_t chunk_size);
+
+/* Return the total number of bytes pushed onto the `StringBuilder` */
+size_t string_builder_len(StringBuilder* sb);
+
+/* Push a char on the end of the `StringBuilder` */
+void string_builder_push_char(StringBuilder* sb, char c);
+
+/* Push bytes copied from a `Str` onto the end of the `StringBuilder` */
+void string_builder_push_str(StringBuilder* sb, Str* str);
+
+/* Push a `String`'s bytes onto the end of the `StringBuilder` */
+void string_builder_push_string(StringBuilder* sb, String* s);
+
+/* Push exactly `len` bytes copied from `cstr` onto the end of the `StringBuilder` */
+void string_builder_push_cstr_bound(StringBuilder* sb, const char* cstr, size_t len);
+
+/* Same as `string_builder_push_cstr_bound` except all of the char* up to the null byte will be pushed */
+void string_builder_push_cstr(StringBuilder* sb, const char* cstr);
+
+/* Flatten the `StringBuilder` into a single `String`, consuming the builder.
+ * The contents are copied exactly once, unless everything fits in a single chunk,
+ * in which case that chunk is handed over without copying.
+ */
+String string_builder_into_string(StringBuilder* sb);
+
+/* Write the contents of the `StringBuilder` to the file descriptor `fd`
+ * with `writev`, without flattening the chunks. Partial writes and
+ * interrupts are retried. Returns 0 on success and -1 on error, with
+ * `errno` set by the failing `writev`.
+ */
+int string_builder_write_fd(StringBuilder* sb, int fd);
+
+/* Drop all chunks and set the length of the `StringBuilder` to zero */
+void string_builder_clear(StringBuilder* sb);
+
+/* Free the chunks held by a `StringBuilder` */
+void string_builder_drop(void* sb_ptr);
+
+
 /* -------------------------- */
 /* ----- Str functions ------ */
 /* -------------------------- */
@@ -295,9 +629,374 @@ const char* str_index_ref(Str* s, size_t ind);
  */
 uint8_t str_eq(void* str1, void* str2);
 
+/* Compare two `Str`s lexicographically by their bytes (as unsigned chars),
+ * a shorter `Str` that is a prefix of the other orders first.
+ */
+CmpOrdering str_cmp(void* str1, void* str2);
+
 /* Calculate the hash of a `Str` and its contents */
 uint64_t str_hash(void* str);
 
+/* Compare two `Str`s for equality ignoring ASCII case, returning a non-zero value
+ * when `Str`s are unequal. Usable as a `HashMap` `cmpEq` for case-insensitive keys.
+ */
+uint8_t str_eq_ignore_ascii_case(void* str1, void* str2);
+
+/* Calculate a hash of a `Str` that ignores ASCII case, consistent with `str_eq_ignore_ascii_case`.
+ * Equal to the `str_hash` of the lowercased contents. Usable as a `HashMap` `hashFn`.
+ */
+uint64_t str_hash_ignore_ascii_case(void* str);
+
+
+/* -------------------------- */
+/* ----- UTF-8 functions ---- */
+/* -------------------------- */
+/* Codepoint produced by `str_char_iter_next` for invalid UTF-8 sequences */
+#define UTF8_REPLACEMENT_CHAR 0xFFFD
+
+/* Check that a `Str` holds well-formed UTF-8, returning 1 for valid and 0 for invalid.
+ * Rejects overlong encodings, surrogates, codepoints above U+10FFFF, and
+ * truncated sequences. Uses a vectorized lookup-table kernel when the
+ * cpu supports it, with an ASCII fast path that skips 16 bytes at a time.
+ */
+uint8_t str_validate_utf8(Str* s);
+
+/* Construct a `StrCharIter` over the codepoints of a `Str` */
+StrCharIter str_char_iter(Str* s);
+
+/* Check if the current `StrCharIter` is complete.
+ * Returning 1 for complete, and 0 for incomplete.
+ */
+uint8_t str_char_iter_done(StrCharIter* iter);
+
+/* Decode and return the next codepoint.
+ * Invalid sequences produce `UTF8_REPLACEMENT_CHAR` and skip a single byte.
+ */
+uint32_t str_char_iter_next(StrCharIter* iter);
+
+/* Return the byte offset of the next codepoint to be decoded */
+size_t str_char_iter_offset(StrCharIter* iter);
+
+/* Return the number of codepoints in a `Str`, assuming it holds valid UTF-8 */
+size_t str_char_count(Str* s);
+
+/* Convert a byte offset into a `Str` into the index of the codepoint starting there,
+ * i.e. the number of codepoints in the first `byte_offset` bytes.
+ * Assumes the `Str` holds valid UTF-8.
+ */
+size_t str_char_index(Str* s, size_t byte_offset);
+
+
+/* -------------------------- */
+/* --- Str number parsing --- */
+/* -------------------------- */
+/* Parse the whole `Str` as a base 10 `uint64_t`, an optional leading `+` is accepted.
+ * No allocations are made and surrounding whitespace is not skipped.
+ * Returns `PARSE_EMPTY` for an empty `Str`, `PARSE_INVALID` if any byte isn't part
+ * of the number, and `PARSE_OVERFLOW` if the value doesn't fit. `out` is only
+ * written on `PARSE_OK`.
+ */
+ParseStatus str_parse_u64(Str* s, uint64_t* out);
+
+/* Same as `str_parse_u64` for an `int64_t` with an optional leading `+` or `-` */
+ParseStatus str_parse_i64(Str* s, int64_t* out);
+
+/* Parse the whole `Str` as a decimal floating point number, correctly rounded
+ * to the nearest `double`. Accepts `[+-]digits[.digits][(e|E)[+-]digits]` as well as
+ * `inf`, `infinity` and `nan` (case-insensitive).
+ * Most inputs are converted exactly with the Clinger and Eisel-Lemire algorithms.
+ * Inputs with more than 19 significant digits fall back to `strtod_l` in the "C" locale,
+ * on a null-terminated copy, which is only heap allocated for inputs of 128 bytes or more.
+ * Returns `PARSE_OVERFLOW`, writing a signed infinity to `out`, when the value is
+ * too large for a `double`. Otherwise statuses match `str_parse_u64`.
+ */
+ParseStatus str_parse_f64(Str* s, double* out);
+
+
+/* -------------------------- */
+/* --- HashedStr functions -- */
+/* -------------------------- */
+/* Construct a new `HashedStr` borrowing the data of `str` and hashing it once.
+ * The stored hash is equal to `str_hash(str)`.
+ */
+HashedStr hashed_str_new(Str* str);
+
+/* Construct a new `HashedStr` from a char* without copying any data */
+HashedStr hashed_str_from_cstr(const char* cstr);
+
+/* Return the borrowed `Str` behind a `HashedStr` */
+Str hashed_str_as_str(HashedStr* hs);
+
+/* Compare two `HashedStr`s for equality, returning a non-zero value
+ * when they are unequal. The cached hashes are compared before the contents.
+ */
+uint8_t hashed_str_eq(void* hs1, void* hs2);
+
+/* Return the cached hash of a `HashedStr` */
+uint64_t hashed_str_hash(void* hs);
+
+
+/* -------------------------- */
+/* -- MappedFile functions -- */
+/* -------------------------- */
+/* Flags accepted by `map_file_with_flags` */
+/* Pre-fault the whole mapping up front instead of on first access (Linux only) */
+#define MAP_FILE_POPULATE 1
+/* Ask for the mapping to be backed by transparent huge pages where the kernel supports it */
+#define MAP_FILE_HUGE_PAGES 2
+
+/* Map the file at `path` read-only into memory without copying it, advising
+ * the kernel that it will be read sequentially. Aborts if the file can't be
+ * opened or mapped, like `read_file`.
+ */
+MappedFile map_file(const char* path);
+
+/* Same as `map_file` with a bitwise or of `MAP_FILE_*` flags.
+ * Flags are hints and are silently ignored where unsupported.
+ */
+MappedFile map_file_with_flags(const char* path, int flags);
+
+/* Return the size of the mapped file in bytes */
+size_t mapped_file_len(MappedFile* mf);
+
+/* Return a borrowed `Str` view of the whole file, valid until the `MappedFile` is dropped.
+ * Note, the view is not null-terminated.
+ */
+Str mapped_file_as_str(MappedFile* mf);
+
+/* Unmap the file held by a `MappedFile` */
+void mapped_file_drop(void* mf_ptr);
+
+
+/* -------------------------- */
+/* -- LineReader functions -- */
+/* -------------------------- */
+/* Default size of the blocks read by a `LineReader` */
+#define LINE_READER_BLOCK_SIZE (1 << 20)
+
+/* Construct a new `LineReader` over `fd`, reading `LINE_READER_BLOCK_SIZE` blocks.
+ * The descriptor is borrowed and is not closed on drop.
+ */
+LineReader line_reader_new(int fd);
+
+/* Construct a new `LineReader` over `fd` reading blocks of `block_size` bytes.
+ * The buffer only grows past `block_size` to hold a single line longer than that.
+ * When `fd` is a regular file the kernel is advised that it will be read
+ * sequentially, and asked to start reading each next block ahead of time,
+ * so disk reads overlap with processing the current block.
+ */
+LineReader line_reader_with_block_size(int fd, size_t block_size);
+
+/* Check if every line has been read, reading the next block if necessary.
+ * Returning 1 for complete, and 0 for incomplete.
+ */
+uint8_t line_reader_done(LineReader* lr);
+
+/* Return the next line, without its trailing `\n`, as a `Str` view into the reader's buffer.
+ * The view is only valid until the next call to `line_reader_done` or `line_reader_next`.
+ * A final line without a trailing `\n` is returned as is, and a trailing `\n` at the
+ * end of the file doesn't produce an extra empty line.
+ */
+Str line_reader_next(LineReader* lr);
+
+/* Return the `errno` of a failed read, which ends the lines early, or 0 */
+int line_reader_error(LineReader* lr);
+
+/* Free the buffer held by a `LineReader` */
+void line_reader_drop(void* lr_ptr);
+
+
+/* -------------------------- */
+/* --- BufWriter functions -- */
+/* -------------------------- */
+/* Default buffer capacity of a `BufWriter` */
+#define BUF_WRITER_CAPACITY 65536
+
+/* Construct a new `BufWriter` over `fd` with a `BUF_WRITER_CAPACITY` buffer.
+ * The descriptor is borrowed and is not closed on drop.
+ */
+BufWriter buf_writer_new(int fd);
+
+/* Construct a new `BufWriter` over `fd` with a buffer of `cap` bytes */
+BufWriter buf_writer_with_capacity(int fd, size_t cap);
+
+/* Write `len` bytes. Small writes are copied into the buffer. Writes of at least half
+ * the buffer capacity are written directly, whether or not they'd fit, together with
+ * the buffered data in a single `writev`, without being copied.
+ * After an error all writes are discarded, see `buf_writer_error`.
+ */
+void buf_writer_write(BufWriter* w, const char* bytes, size_t len);
+
+/* Write a char, see `buf_writer_write` */
+void buf_writer_write_char(BufWriter* w, char c);
+
+/* Write the contents of a `Str`, see `buf_writer_write` */
+void buf_writer_write_str(BufWriter* w, Str* str);
+
+/* Write the contents of a `String`, see `buf_writer_write` */
+void buf_writer_write_string(BufWriter* w, String* s);
+
+/* Write a null-terminated `char*`, not including the null byte, see `buf_writer_write` */
+void buf_writer_write_cstr(BufWriter* w, const char* cstr);
+
+/* Write the base 10 representation of a `uint64_t`, formatted directly into the buffer */
+void buf_writer_write_u64(BufWriter* w, uint64_t v);
+
+/* Write the base 10 representation of an `int64_t`, formatted directly into the buffer */
+void buf_writer_write_i64(BufWriter* w, int64_t v);
+
+/* Write the shortest round-trip representation of a `double`, formatted directly
+ * into the buffer. Formatting matches `string_push_f64`.
+ */
+void buf_writer_write_f64(BufWriter* w, double v);
+
+/* Write out all buffered data. Returns 0 on success and -1 if this or any
+ * earlier write failed, with `errno` set to `buf_writer_error`.
+ */
+int buf_writer_flush(BufWriter* w);
+
+/* Return the `errno` of the first failed write, or 0. Errors are sticky:
+ * once a write has failed, later writes are discarded.
+ */
+int buf_writer_error(BufWriter* w);
+
+/* Return the number of write syscalls made so far */
+size_t buf_writer_syscalls(BufWriter* w);
+
+/* Flush any buffered data and free the buffer held by a `BufWriter`.
+ * Errors from the final flush are dropped, call `buf_writer_flush` first to check them.
+ */
+void buf_writer_drop(void* w_ptr);
+
+
+/* -------------------------- */
+/* --- Parallel functions --- */
+/* -------------------------- */
+/* Apply `func` to every line of `s` on `nthreads` threads (the calling thread included).
+ * `s` is split into `nthreads` roughly equal byte ranges, each extended to the
+ * end of its last line, so every line is seen exactly once by a single thread.
+ * Lines are passed without their trailing `\n`, and a trailing `\n` at the
+ * end of `s` doesn't produce an extra empty line.
+ *
+ * `ctxs` is an array of `nthreads` contexts of `ctx_size` bytes each, and thread `i`
+ * passes `ctxs + i * ctx_size` to `func`. Once every thread is done, when `merge` is
+ * non-NULL, contexts 1 to `nthreads - 1` are merged in order into the first one.
+ * A `nthreads` of 0 is treated as 1, `utils_num_cpus` is a good default.
+ * Ranges left empty, as when there are more threads than lines, don't start a thread.
+ */
+void parallel_for_lines(Str* s, size_t nthreads, lineFn func, void* ctxs, size_t ctx_size, mergeFn merge);
+
+/* Same as `parallel_for_lines` over the lines of the file at `path`, which is
+ * memory mapped rather than read. Aborts if the file can't be mapped, like `map_file`.
+ */
+void parallel_for_lines_in_file(const char* path, size_t nthreads, lineFn func,
+                                void* ctxs, size_t ctx_size, mergeFn merge);
+
+
+/* -------------------------- */
+/* - StringInterner functions */
+/* -------------------------- */
+/* Minimum size of the arena blocks allocated by a `StringInterner` */
+#define STRING_INTERNER_BLOCK_SIZE 16384
+
+/* Construct a new empty `StringInterner` */
+StringInterner string_interner_new();
+
+/* Return the number of distinct strings interned */
+size_t string_interner_len(StringInterner* si);
+
+/* Intern the contents of `str`, returning its `Symbol`.
+ * The bytes are copied into the interner's arena the first time they're seen,
+ * subsequent calls with equal contents return the same `Symbol` without copying.
+ */
+Symbol string_interner_intern(StringInterner* si, Str* str);
+
+/* Same as `string_interner_intern` for a null-terminated `char*` */
+Symbol string_interner_intern_cstr(StringInterner* si, const char* cstr);
+
+/* Look up the `Symbol` of `str` without interning it.
+ * Returns 1 and sets `sym` if `str` has been interned, otherwise returns 0.
+ */
+uint8_t string_interner_get(StringInterner* si, Str* str, Symbol* sym);
+
+/* Return a borrowed `Str` of the string behind `sym`.
+ * The view stays valid for the lifetime of the interner and is followed
+ * by a null byte, so `str_as_ptr` of the result is a valid c-string.
+ */
+Str string_interner_resolve(StringInterner* si, Symbol sym);
+
+/* Free the arena and lookup tables held by a `StringInterner` */
+void string_interner_drop(void* interner_ptr);
+
+/* Compare two `Symbol*`s for equality, returning a non-zero value
+ * when `Symbol`s are unequal. Usable as a `HashMap` `cmpEq`.
+ */
+uint8_t symbol_eq(void* sym1, void* sym2);
+
+/* Calculate the hash of a `Symbol*`. Usable as a `HashMap` `hashFn`. */
+uint64_t symbol_hash(void* sym);
+
+
+/* -------------------------- */
+/* --- CsvReader functions -- */
+/* -------------------------- */
+/* Construct a new `CsvReader` over the contents of `input`, with fields separated
+ * by `delim` (e.g. `,` for CSV or `\t` for TSV). The input is borrowed and must
+ * outlive the reader and any rows it produces.
+ */
+CsvReader csv_reader_new(Str* input, char delim);
+
+/* Check if every row of the input has been read.
+ * Returning 1 for complete, and 0 for incomplete.
+ */
+uint8_t csv_reader_done(CsvReader* r);
+
+/* Read the next row, returning a `Slice` of `Str` fields.
+ * Rows end at `\n` or `\r\n` outside of quotes. Quoted fields have their
+ * surrounding quotes removed and may contain delimiters and line breaks.
+ * Fields are views into the input, except quoted fields containing escaped
+ * `""` quotes, which are unescaped into a buffer owned by the reader.
+ * The row `Slice` and its fields are only valid until the next call,
+ * since the reader reuses the same storage for every row.
+ */
+Slice csv_reader_next_row(CsvReader* r);
+
+/* Free the row storage held by a `CsvReader` */
+void csv_reader_drop(void* r_ptr);
+
+
+/* -------------------------- */
+/* - MultiPattern functions - */
+/* -------------------------- */
+/* Construct a new `MultiPattern` matching any of the `Str`s in `patterns` (a `Vec` of `Str`).
+ * Pattern bytes are not retained, matches refer to patterns by their index in `patterns`.
+ * Empty patterns never match, and duplicate patterns are reported under their first index.
+ */
+MultiPattern multi_pattern_new(Vec* patterns);
+
+/* Return the number of patterns the `MultiPattern` was built from */
+size_t multi_pattern_len(MultiPattern* mp);
+
+/* Check if any pattern occurs in `haystack`, returning 1 on the first match and 0 otherwise */
+uint8_t multi_pattern_is_match(MultiPattern* mp, Str* haystack);
+
+/* Find the match that ends first in `haystack`, preferring the longest pattern
+ * when several end at the same byte. Returns 1 and sets `m` if a match
+ * was found, otherwise returns 0.
+ */
+uint8_t multi_pattern_find_first(MultiPattern* mp, Str* haystack, PatternMatch* m);
+
+/* Find every, possibly overlapping, occurrence of every pattern in `haystack`,
+ * returning a `Vec` of `PatternMatch` ordered by end offset, then longest first.
+ */
+Vec multi_pattern_find_all(MultiPattern* mp, Str* haystack);
+
+/* Return the number of bytes allocated for the automaton */
+size_t multi_pattern_memory_usage(MultiPattern* mp);
+
+/* Free the automaton held by a `MultiPattern` */
+void multi_pattern_drop(void* mp_ptr);
+
 
 /* -------------------------- */
 /* ----- Vec functions ------ */
@@ -328,6 +1027,10 @@ uint64_t vec_hash_with(void* v, hashFn hash_func);
  * If the new capacity is smaller, trailing data will be dropped
  * which may result in leaked memory if dropped elements are/hold
  * pointers that need to be cleaned up.
+ * Buffers of `UTILS_BUF_MMAP_THRESHOLD` bytes (32 MiB unless defined when building
+ * utils.c) or more are mapped directly on Linux, advised to use transparent huge pages,
+ * and resized with mremap, which moves pages rather than copying them. The same
+ * applies to `String`s. Don't `free` the inner data of a `Vec` or `String` directly.
  */
 void vec_resize(Vec* v, size_t new_cap);
 
@@ -338,6 +1041,16 @@ void vec_resize(Vec* v, size_t new_cap);
  */
 void vec_push(Vec* v, void* obj);
 
+/* Make room for at least `additional` more elements, growing the capacity
+ * geometrically like `vec_push` so repeated calls stay amortized O(1) per element.
+ */
+void vec_reserve(Vec* v, size_t additional);
+
+/* Append every element of `sl`, a `Slice` of the same item size, with a single `memcpy`
+ * after at most one resize. The `Slice` may view the `Vec` itself.
+ */
+void vec_extend_from_slice(Vec* v, Slice* sl);
+
 /* Insert an object of size `Vec->__item_size` into the given `Vec`, resizing if necessary.
  * Note, the provided `obj` pointer is expected to point to something that is
  * the same size as `Vec->__item_size`. The bytes behind the `obj` pointer will
@@ -357,6 +1070,26 @@ void vec_remove(Vec* v, size_t index);
  */
 void vec_remove_with(Vec* v, size_t index, mapFn drop);
 
+/* Remove an object of size `Vec->__item_size` from the given `Vec` in O(1)
+ * by moving the last element into its place, which doesn't preserve ordering.
+ * As elements are removed the `Vec` capacity will remain unchanged.
+ */
+void vec_swap_remove(Vec* v, size_t index);
+
+/* Same as `vec_swap_remove` after applying the `drop` function to the element's pointer. */
+void vec_swap_remove_with(Vec* v, size_t index, mapFn drop);
+
+/* Shorten the `Vec` to `len` elements, doing nothing if it's already shorter.
+ * The capacity will remain unchanged.
+ */
+void vec_truncate(Vec* v, size_t len);
+
+/* Same as `vec_truncate` after applying the `drop` function to each removed element */
+void vec_truncate_with(Vec* v, size_t len, mapFn drop);
+
+/* Shrink the capacity of the `Vec` to its length, freeing the inner data of an empty `Vec` */
+void vec_shrink_to_fit(Vec* v);
+
 /* Return a pointer to an item at the given index
  * Note, references may be invalidated when the container is resized.
  *
@@ -408,6 +1141,180 @@ Slice vec_as_slice(Vec* v);
 /* Construct a `SliceIter` over element of a `Vec` */
 SliceIter vec_iter(Vec* v);
 
+/* Sort the `Vec` in place using `cmp_func`, with pattern-defeating quicksort.
+ * Runs in O(n log n) time, worst case included, and is fast on already sorted,
+ * reversed, and many-duplicate inputs. The sort is not stable: equal elements
+ * may be reordered. Use `vec_sort_stable_by` to keep their order.
+ */
+void vec_sort_by(Vec* v, cmpFn cmp_func);
+
+/* Sort the `Vec` in place using `cmp_func`, keeping equal elements in their
+ * original order. A merge sort allocating scratch space for half the elements.
+ */
+void vec_sort_stable_by(Vec* v, cmpFn cmp_func);
+
+/* Stable LSD radix sort of the `Vec` by the key `key_func` extracts from each element.
+ * Keys are extracted once up front, and only the 11 bit key digits that
+ * differ between elements cost a pass over the data. Allocates scratch space for
+ * the keys and a copy of the elements.
+ */
+void vec_radix_sort_by_u32(Vec* v, keyU32Fn key_func);
+
+/* Same as `vec_radix_sort_by_u32` with `uint64_t` keys */
+void vec_radix_sort_by_u64(Vec* v, keyU64Fn key_func);
+
+/* Same as `vec_radix_sort_by_u32` with `int64_t` keys */
+void vec_radix_sort_by_i64(Vec* v, keyI64Fn key_func);
+
+/* Same as `vec_radix_sort_by_u32` with `double` keys. Orders -0.0 before 0.0,
+ * and NaNs by their sign bit: before -inf when set and after inf otherwise.
+ */
+void vec_radix_sort_by_f64(Vec* v, keyF64Fn key_func);
+
+/* Sort the `Vec` in place using `cmp_func` on `nthreads` threads (the calling thread included).
+ * A sample sort: each thread sorts an equal share of the elements with `vec_sort_by`,
+ * splitters sampled from the sorted runs cut every run into one partition per thread,
+ * and each thread merges its partition of every run into place.
+ * Allocates a second buffer the size of the `Vec`, which replaces the first.
+ * Not stable. Inputs with fewer than 16384 elements per thread use fewer threads,
+ * and many copies of a single value can leave one thread with most of the merging.
+ * A `nthreads` of 0 is treated as 1, `utils_num_cpus` is a good default.
+ */
+void vec_par_sort_by(Vec* v, cmpFn cmp_func, size_t nthreads);
+
+/* Return the index of the first element of the sorted `Vec` that is not less than
+ * `key`, or the length of the `Vec` if there is none, comparing elements against
+ * `key` with `cmp_func(element, key)`. Branchless, without bounds checks per probe,
+ * and prefetches the next probes. Searching for elements of a larger `Vec`
+ * many times? See `EytzingerIndex`.
+ */
+size_t vec_lower_bound_by(Vec* v, void* key, cmpFn cmp_func);
+
+/* Search the sorted `Vec` for an element equal to `key`, see `vec_lower_bound_by`.
+ * Returns 1 and sets `index` to the first equal element when found.
+ * Otherwise returns 0 and sets `index` to where `key` would be inserted.
+ */
+uint8_t vec_binary_search_by(Vec* v, void* key, cmpFn cmp_func, size_t* index);
+
+
+/* -------------------------- */
+/* ---- Typed Vec macros ---- */
+/* -------------------------- */
+/* Define `Vec_<name>`, a `Vec` of `T` whose functions are `static inline` and know
+ * the element size at compile time, so element access compiles to plain loads
+ * and stores, and loops over `vec_<name>_data` can be vectorized.
+ * A `Vec_<name>` wraps a regular `Vec` of `sizeof(T)` items, which `vec_<name>_as_vec`
+ * exposes to all of the `vec_*` functions, and `vec_<name>_from_vec` takes ownership of.
+ *
+ * Example:
+ * ```
+ * VEC_DEFINE(point, Point)
+ * Vec_point points = vec_point_new();
+ * vec_point_push(&points, p);
+ * Point first = vec_point_get(&points, 0);
+ * vec_point_drop(&points);
+ * ```
+ */
+#define VEC_DEFINE(name, T) \
+typedef struct { \
+    Vec __vec; \
+} Vec_##name; \
+\
+/* Iterator over references to the elements of a `Vec_##name` */ \
+typedef struct { \
+    T* __ptr; \
+    T* __end; \
+} VecIter_##name; \
+\
+static inline Vec_##name vec_##name##_new(void) { \
+    Vec_##name v = { vec_new(sizeof(T)) }; \
+    return v; \
+} \
+\
+static inline Vec_##name vec_##name##_with_capacity(size_t cap) { \
+    Vec_##name v = { vec_with_capacity(sizeof(T), cap) }; \
+    return v; \
+} \
+\
+/* Take ownership of a `Vec`, which must hold items of `sizeof(T)` */ \
+static inline Vec_##name vec_##name##_from_vec(Vec v) { \
+    Vec_##name typed = { v }; \
+    return typed; \
+} \
+\
+static inline Vec* vec_##name##_as_vec(Vec_##name* v) { \
+    return &v->__vec; \
+} \
+\
+static inline Slice vec_##name##_as_slice(Vec_##name* v) { \
+    return vec_as_slice(&v->__vec); \
+} \
+\
+static inline size_t vec_##name##_len(Vec_##name* v) { \
+    return v->__vec.__len; \
+} \
+\
+static inline size_t vec_##name##_cap(Vec_##name* v) { \
+    return v->__vec.__cap; \
+} \
+\
+/* Pointer to the first element, invalidated when the `Vec` is resized */ \
+static inline T* vec_##name##_data(Vec_##name* v) { \
+    return (T*)v->__vec.__data; \
+} \
+\
+static inline void vec_##name##_push(Vec_##name* v, T item) { \
+    if (v->__vec.__len == v->__vec.__cap) { \
+        vec_push(&v->__vec, &item);  /* grows like any other `Vec` */ \
+        return; \
+    } \
+    ((T*)v->__vec.__data)[v->__vec.__len++] = item; \
+} \
+\
+static inline T* vec_##name##_index_ref(Vec_##name* v, size_t ind) { \
+    if (ind >= v->__vec.__len) \
+        vec_index_ref(&v->__vec, ind);  /* reports the out of bounds index and aborts */ \
+    return (T*)v->__vec.__data + ind; \
+} \
+\
+static inline T vec_##name##_get(Vec_##name* v, size_t ind) { \
+    return *vec_##name##_index_ref(v, ind); \
+} \
+\
+static inline T vec_##name##_get_unchecked(Vec_##name* v, size_t ind) { \
+    return ((T*)v->__vec.__data)[ind]; \
+} \
+\
+static inline void vec_##name##_set(Vec_##name* v, size_t ind, T item) { \
+    *vec_##name##_index_ref(v, ind) = item; \
+} \
+\
+static inline VecIter_##name vec_##name##_iter(Vec_##name* v) { \
+    VecIter_##name iter = { (T*)v->__vec.__data, (T*)v->__vec.__data + v->__vec.__len }; \
+    return iter; \
+} \
+\
+static inline uint8_t vec_##name##_iter_done(VecIter_##name* iter) { \
+    return iter->__ptr == iter->__end; \
+} \
+\
+static inline T* vec_##name##_iter_next(VecIter_##name* iter) { \
+    return iter->__ptr++; \
+} \
+\
+static inline void vec_##name##_clear(Vec_##name* v) { \
+    v->__vec.__len = 0; \
+} \
+\
+static inline void vec_##name##_drop(void* v_ptr) { \
+    vec_drop(&((Vec_##name*)v_ptr)->__vec); \
+}
+
+/* Typed `Vec`s of the common number types */
+VEC_DEFINE(u32, uint32_t)
+VEC_DEFINE(u64, uint64_t)
+VEC_DEFINE(i64, int64_t)
+VEC_DEFINE(f64, double)
 
 /* -------------------------- */
 /* --- Slice functions ---- */
@@ -433,6 +1340,326 @@ uint8_t slice_iter_done(SliceIter* iter);
 void* slice_iter_next(SliceIter* iter);
 
 
+/* -------------------------- */
+/* - EytzingerIndex functions */
+/* -------------------------- */
+/* Construct a new `EytzingerIndex`, copying the elements of the sorted `Slice`.
+ * Searches touch fewer cache lines than a binary search over the sorted elements,
+ * which pays off once they no longer fit in cache.
+ */
+EytzingerIndex eytzinger_index_new(Slice* sorted);
+
+/* Return the number of elements in the index */
+size_t eytzinger_index_len(EytzingerIndex* ei);
+
+/* Return a pointer to the first element, in sorted order, that is not less than `key`,
+ * or NULL if there is none. Elements are compared with `cmp_func(element, key)`.
+ * The pointer refers to the index's own copy of the element.
+ */
+void* eytzinger_index_lower_bound(EytzingerIndex* ei, void* key, cmpFn cmp_func);
+
+/* Return a pointer to an element equal to `key`, or NULL if there is none.
+ * See `eytzinger_index_lower_bound`.
+ */
+void* eytzinger_index_find(EytzingerIndex* ei, void* key, cmpFn cmp_func);
+
+/* Free the elements held by an `EytzingerIndex` */
+void eytzinger_index_drop(void* ei_ptr);
+
+
+/* -------------------------- */
+/* - Sorted set functions --- */
+/* -------------------------- */
+/* Append the elements present in both `a` and `b`, strictly increasing `Slice`s
+ * of uint32_t, to `out`, a `Vec` of uint32_t. Compares blocks of 8 elements at a
+ * time with AVX2, and gallops through the larger side when the sizes are skewed.
+ */
+void slice_sorted_intersect_u32(Slice* a, Slice* b, Vec* out);
+
+/* Same as `slice_sorted_intersect_u32` for uint64_t, in blocks of 4 elements */
+void slice_sorted_intersect_u64(Slice* a, Slice* b, Vec* out);
+
+/* Same as `slice_sorted_intersect_u32`, always searching the larger side for each
+ * element of the smaller one with doubling steps, in O(small * log(large / small))
+ */
+void slice_sorted_intersect_gallop_u32(Slice* a, Slice* b, Vec* out);
+
+/* Same as `slice_sorted_intersect_gallop_u32` for uint64_t */
+void slice_sorted_intersect_gallop_u64(Slice* a, Slice* b, Vec* out);
+
+/* Append the elements present in `a`, `b`, or both, strictly increasing `Slice`s
+ * of uint32_t, to `out`, a `Vec` of uint32_t, in increasing order
+ */
+void slice_sorted_union_u32(Slice* a, Slice* b, Vec* out);
+
+/* Same as `slice_sorted_union_u32` for uint64_t */
+void slice_sorted_union_u64(Slice* a, Slice* b, Vec* out);
+
+/* Append the elements of `a` not present in `b`, strictly increasing `Slice`s
+ * of uint32_t, to `out`, a `Vec` of uint32_t. Compares blocks with AVX2 like
+ * `slice_sorted_intersect_u32`.
+ */
+void slice_sorted_difference_u32(Slice* a, Slice* b, Vec* out);
+
+/* Same as `slice_sorted_difference_u32` for uint64_t */
+void slice_sorted_difference_u64(Slice* a, Slice* b, Vec* out);
+
+
+/* -------------------------- */
+/* --- VecDeque functions --- */
+/* -------------------------- */
+/* Construct a new empty `VecDeque` */
+VecDeque vec_deque_new(size_t item_size);
+
+/* Construct a new empty `VecDeque` able to hold at least `cap` elements */
+VecDeque vec_deque_with_capacity(size_t item_size, size_t cap);
+
+/* Return current `VecDeque` length */
+size_t vec_deque_len(VecDeque* dq);
+
+/* Return current `VecDeque` capacity */
+size_t vec_deque_cap(VecDeque* dq);
+
+/* Make room for at least `additional` more elements, doubling the capacity as needed */
+void vec_deque_reserve(VecDeque* dq, size_t additional);
+
+/* Push an object of size `VecDeque->__item_size` onto the back, resizing if necessary.
+ * The bytes behind the `obj` pointer will be `memcpy`d into the `VecDeque`.
+ */
+void vec_deque_push_back(VecDeque* dq, void* obj);
+
+/* Same as `vec_deque_push_back`, pushing onto the front */
+void vec_deque_push_front(VecDeque* dq, void* obj);
+
+/* Remove the front element in O(1), copying it into `out` unless `out` is NULL.
+ * Returns 1 if an element was removed, or 0 if the `VecDeque` is empty.
+ */
+uint8_t vec_deque_pop_front(VecDeque* dq, void* out);
+
+/* Same as `vec_deque_pop_front`, removing the back element */
+uint8_t vec_deque_pop_back(VecDeque* dq, void* out);
+
+/* Return a pointer to the element `ind` places from the front.
+ * Note, references may be invalidated when the container is resized.
+ */
+void* vec_deque_index_ref(VecDeque* dq, size_t ind);
+
+/* Return a pointer to the front element, or NULL if the `VecDeque` is empty */
+void* vec_deque_front_ref(VecDeque* dq);
+
+/* Return a pointer to the back element, or NULL if the `VecDeque` is empty */
+void* vec_deque_back_ref(VecDeque* dq);
+
+/* View the elements, in order, as two contiguous `Slice`s: `first` from the front up to
+ * the end of the buffer, and `second` with any elements wrapped around to its start.
+ */
+void vec_deque_as_slices(VecDeque* dq, Slice* first, Slice* second);
+
+/* Apply the `drop` function, unless NULL, to each element and set the length to zero.
+ * This will not affect the current capacity of the `VecDeque`.
+ */
+void vec_deque_clear(VecDeque* dq, mapFn drop);
+
+/* Free the inner data held by a `VecDeque` after applying
+ * the given `drop` function to each element
+ */
+void vec_deque_drop_with(VecDeque* dq, mapFn drop);
+
+/* Free the inner data held by a `VecDeque` */
+void vec_deque_drop(void* dq_ptr);
+
+
+/* -------------------------- */
+/* ---- BitVec functions ---- */
+/* -------------------------- */
+/* Construct a new empty `BitVec` */
+BitVec bit_vec_new();
+
+/* Construct a new empty `BitVec` able to hold `bits` bits without resizing */
+BitVec bit_vec_with_capacity(size_t bits);
+
+/* Construct a new `BitVec` of `len` bits, all cleared */
+BitVec bit_vec_zeros(size_t len);
+
+/* Return the number of bits in the `BitVec` */
+size_t bit_vec_len(BitVec* bv);
+
+/* Push a bit, set when `bit` is non-zero, onto the back of the `BitVec` */
+void bit_vec_push(BitVec* bv, uint8_t bit);
+
+/* Return the bit at `ind` as 1 or 0 */
+uint8_t bit_vec_get(BitVec* bv, size_t ind);
+
+/* Set the bit at `ind` to 1 */
+void bit_vec_set(BitVec* bv, size_t ind);
+
+/* Clear the bit at `ind` to 0 */
+void bit_vec_clear(BitVec* bv, size_t ind);
+
+/* Bitwise `dst &= src` over whole `BitVec`s of the same length, 256 bits at a time with AVX2 */
+void bit_vec_and(BitVec* dst, BitVec* src);
+
+/* Bitwise `dst |= src`, see `bit_vec_and` */
+void bit_vec_or(BitVec* dst, BitVec* src);
+
+/* Bitwise `dst ^= src`, see `bit_vec_and` */
+void bit_vec_xor(BitVec* dst, BitVec* src);
+
+/* Bitwise `dst &= ~src`, see `bit_vec_and` */
+void bit_vec_andnot(BitVec* dst, BitVec* src);
+
+/* Return the number of set bits, counted with AVX2 nibble lookups or `popcnt` */
+uint64_t bit_vec_count_ones(BitVec* bv);
+
+/* Construct a `BitVecIter` over the indices of the set bits, in increasing order.
+ * Skips a word of clear bits at a time.
+ */
+BitVecIter bit_vec_iter(BitVec* bv);
+
+/* Check if every set bit has been visited.
+ * Returning 1 for complete, and 0 for incomplete.
+ */
+uint8_t bit_vec_iter_done(BitVecIter* iter);
+
+/* Return the index of the next set bit */
+size_t bit_vec_iter_next(BitVecIter* iter);
+
+/* Free the words held by a `BitVec` */
+void bit_vec_drop(void* bv_ptr);
+
+
+/* -------------------------- */
+/* --- RankSelect functions - */
+/* -------------------------- */
+/* Construct a new `RankSelect` over the current bits of `bv`.
+ * Rebuild it after modifying or resizing the `BitVec`.
+ */
+RankSelect rank_select_new(BitVec* bv);
+
+/* Return the number of set bits */
+uint64_t rank_select_count_ones(RankSelect* rs);
+
+/* Return the number of set bits before index `ind`, which may equal the length */
+uint64_t rank_select_rank(RankSelect* rs, size_t ind);
+
+/* Return the index of the `k`th set bit, counting from 0,
+ * or the length of the `BitVec` if there are no more than `k` set bits.
+ */
+size_t rank_select_select(RankSelect* rs, uint64_t k);
+
+/* Free the counts held by a `RankSelect` */
+void rank_select_drop(void* rs_ptr);
+
+
+/* -------------------------- */
+/* -- PriorityQueue functions */
+/* -------------------------- */
+/* Construct a new empty 4-ary `PriorityQueue`, keeping the greatest element,
+ * according to `cmp_func`, on top. Reverse the comparison for a min-queue.
+ */
+PriorityQueue priority_queue_new(size_t item_size, cmpFn cmp_func);
+
+/* Same as `priority_queue_new` with `arity` (at least 2) children per node.
+ * Wider nodes make the heap shallower and scan siblings sharing cache lines.
+ */
+PriorityQueue priority_queue_with_arity(size_t item_size, cmpFn cmp_func, size_t arity);
+
+/* Construct a `PriorityQueue` from the elements of `v` in O(n), consuming the `Vec`,
+ * which is left empty
+ */
+PriorityQueue priority_queue_from_vec(Vec* v, cmpFn cmp_func, size_t arity);
+
+/* Return the number of queued elements */
+size_t priority_queue_len(PriorityQueue* pq);
+
+/* Push an object of size `item_size` onto the queue in O(log n).
+ * The bytes behind the `obj` pointer will be `memcpy`d into the `PriorityQueue`.
+ */
+void priority_queue_push(PriorityQueue* pq, void* obj);
+
+/* Return a pointer to the greatest element, or NULL if the `PriorityQueue` is empty.
+ * Note, references are invalidated by any modification of the queue.
+ */
+void* priority_queue_peek(PriorityQueue* pq);
+
+/* Remove the greatest element, copying it into `out` unless `out` is NULL.
+ * Returns 1 if an element was removed, or 0 if the `PriorityQueue` is empty.
+ */
+uint8_t priority_queue_pop(PriorityQueue* pq, void* out);
+
+/* Replace the greatest element with `obj`, copying the old one into `out` unless
+ * `out` is NULL. Cheaper than a pop followed by a push, with a single sift.
+ * Returns 1 if an element was replaced, or 0 if the queue was empty and `obj` was pushed.
+ */
+uint8_t priority_queue_replace_top(PriorityQueue* pq, void* obj, void* out);
+
+/* Return the elements, in heap order, as a `Vec`, consuming the `PriorityQueue` */
+Vec priority_queue_into_vec(PriorityQueue* pq);
+
+/* Free the inner data held by a `PriorityQueue` after applying
+ * the given `drop` function to each element
+ */
+void priority_queue_drop_with(PriorityQueue* pq, mapFn drop);
+
+/* Free the inner data held by a `PriorityQueue` */
+void priority_queue_drop(void* pq_ptr);
+
+/* Return copies of the `k` greatest elements of `sl`, according to `cmp_func`,
+ * in descending order. Keeps a heap of only `k` elements, so the input is scanned
+ * once in O(n log k) instead of being sorted.
+ */
+Vec slice_top_k(Slice* sl, size_t k, cmpFn cmp_func);
+
+
+/* -------------------------- */
+/* ---- SoaVec functions ---- */
+/* -------------------------- */
+/* Construct a new empty `SoaVec` with `num_columns` columns of the given sizes.
+ * A row is laid out as the values of its columns back to back, in column order,
+ * with no padding in between.
+ */
+SoaVec soa_vec_new(const size_t* column_sizes, size_t num_columns);
+
+/* Construct a new empty `SoaVec` able to hold at least `cap` rows without resizing */
+SoaVec soa_vec_with_capacity(const size_t* column_sizes, size_t num_columns, size_t cap);
+
+/* Return the number of rows */
+size_t soa_vec_len(SoaVec* sv);
+
+/* Return the number of columns */
+size_t soa_vec_num_columns(SoaVec* sv);
+
+/* Return the size in bytes of a packed row, the sum of the column sizes */
+size_t soa_vec_row_size(SoaVec* sv);
+
+/* Make room for at least `additional` more rows in every column */
+void soa_vec_reserve(SoaVec* sv, size_t additional);
+
+/* Push a row, scattering the values of its columns into their buffers.
+ * The `soa_vec_row_size` bytes behind the `row` pointer will be `memcpy`d into the `SoaVec`.
+ */
+void soa_vec_push_row(SoaVec* sv, const void* row);
+
+/* Gather the columns of row `ind` into the `soa_vec_row_size` bytes at `out` */
+void soa_vec_get_row(SoaVec* sv, size_t ind, void* out);
+
+/* Return a pointer to the value of column `col` in row `ind`.
+ * Note, references may be invalidated when the container is resized.
+ */
+void* soa_vec_column_ref(SoaVec* sv, size_t col, size_t ind);
+
+/* View column `col` as a contiguous `Slice`, so scans only stream the bytes of that field.
+ * Note, the `Slice` is invalidated when the container is resized.
+ */
+Slice soa_vec_column(SoaVec* sv, size_t col);
+
+/* Remove every row, keeping the current capacity */
+void soa_vec_clear(SoaVec* sv);
+
+/* Free the column buffers held by a `SoaVec` */
+void soa_vec_drop(void* sv_ptr);
+
+
 /* -------------------------- */
 /* --- HashMap functions ---- */
 /* -------------------------- */